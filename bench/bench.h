@@ -0,0 +1,41 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+#include <neo.h>
+
+/*
+ * Every benchmark is a function that prints its results to stdout.
+ * Add new ones to the table in main.c.
+ */
+
+void chashtab_bench(void);
+void error_bench(void);
+void narena_bench(void);
+void nchrat_bench(void);
+void nhash_bench(void);
+void npool_bench(void);
+void nref_bench(void);
+void utf8_bench(void);
+
+/** Get a monotonic timestamp in seconds. */
+f64 bench_now(void);
+
+/**
+ * Feed a value to this in order to prevent the compiler from optimizing away
+ * the computation that produced it.
+ */
+void bench_sink(u64 val);
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,209 @@
+/*
+ * Measure how lookups scale with the number of threads for a hash table that
+ * is shared between all of them, with 90% reads and 10% writes.  The regular
+ * hashtab_t is protected by a mutex and a read/write lock respectively, and
+ * compared against chashtab_t which doesn't need any external locking.
+ * See the end of this file for copyright and license terms.
+ */
+
+/* sysconf, pthread_rwlock_t */
+#define _POSIX_C_SOURCE 200809L
+
+#include <neo.h>
+#include <neo/chashtab.h>
+#include <neo/hashtab.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define KEYS		(1 << 16)
+#define OPS_PER_THREAD	(1 << 20)
+/* out of 256 */
+#define WRITE_RATIO	26
+
+struct bench_val {
+	NREF_FIELD;
+	u32 number;
+};
+
+enum variant {
+	VARIANT_MUTEX,
+	VARIANT_RWLOCK,
+	VARIANT_CHASHTAB,
+};
+
+static const char *const variant_names[] = {
+	[VARIANT_MUTEX] = "hashtab + mutex",
+	[VARIANT_RWLOCK] = "hashtab + rwlock",
+	[VARIANT_CHASHTAB] = "chashtab",
+};
+
+static nbuf_t *keys[KEYS];
+static struct bench_val *vals[KEYS];
+
+static enum variant variant;
+static hashtab_t *table;
+static chashtab_t *ctable;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_rwlock_t rwlock = PTHREAD_RWLOCK_INITIALIZER;
+
+static void bench_val_destroy(struct bench_val *val)
+{
+	nfree(val);
+}
+
+static struct bench_val *bench_val_create(u32 number)
+{
+	struct bench_val *val = nalloc(sizeof(*val), nil);
+	val->number = number;
+	nref_init(val, bench_val_destroy);
+	return val;
+}
+
+static inline u32 xorshift32(u32 *state)
+{
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static void *worker(void *arg)
+{
+	u32 rng = (u32)(usize)arg * 0x9e3779b9u + 1;
+	u64 acc = 0;
+
+	for (u32 op = 0; op < OPS_PER_THREAD; op++) {
+		u32 r = xorshift32(&rng);
+		u32 i = (r >> 8) % KEYS;
+		bool write = (r & 0xff) < WRITE_RATIO;
+
+		switch (variant) {
+		case VARIANT_MUTEX:
+		case VARIANT_RWLOCK:
+			if (variant == VARIANT_MUTEX)
+				pthread_mutex_lock(&mutex);
+			else if (write)
+				pthread_rwlock_wrlock(&rwlock);
+			else
+				pthread_rwlock_rdlock(&rwlock);
+
+			if (write) {
+				void *val = hashtab_del(table, keys[i], nil);
+				if (val != nil)
+					hashtab_put(table, keys[i], val, nil);
+			} else {
+				struct bench_val *val = hashtab_get(table, keys[i], nil);
+				if (val != nil)
+					acc += val->number;
+			}
+
+			if (variant == VARIANT_MUTEX)
+				pthread_mutex_unlock(&mutex);
+			else
+				pthread_rwlock_unlock(&rwlock);
+			break;
+		case VARIANT_CHASHTAB:
+			if (write) {
+				struct bench_val *val = chashtab_del(ctable, keys[i], nil);
+				if (val != nil) {
+					chashtab_put(ctable, keys[i], val, nil);
+					nput(val);
+				}
+			} else {
+				struct bench_val *val = chashtab_get(ctable, keys[i], nil);
+				if (val != nil) {
+					acc += val->number;
+					nput(val);
+				}
+			}
+			break;
+		}
+	}
+
+	bench_sink(acc);
+	return nil;
+}
+
+static void run(u32 threads)
+{
+	pthread_t tids[threads];
+
+	f64 start = bench_now();
+	for (u32 t = 0; t < threads; t++)
+		pthread_create(&tids[t], nil, worker, (void *)(usize)t);
+	for (u32 t = 0; t < threads; t++)
+		pthread_join(tids[t], nil);
+	f64 elapsed = bench_now() - start;
+
+	printf(" %8.2f", (f64)threads * OPS_PER_THREAD / elapsed / 1e6);
+	fflush(stdout);
+}
+
+/** Powers of two up to the number of CPUs, and the number of CPUs itself */
+static u32 thread_counts(u32 *counts, u32 max)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	u32 n = 0;
+
+	for (u32 threads = 1; threads < cpus && n < max - 1; threads *= 2)
+		counts[n++] = threads;
+	counts[n++] = cpus < 1 ? 1 : (u32)cpus;
+
+	return n;
+}
+
+void chashtab_bench(void)
+{
+	u32 counts[32];
+	u32 counts_len = thread_counts(counts, 32);
+
+	table = hashtab_create(KEYS, nil);
+	ctable = chashtab_create(KEYS, nil);
+	for (u32 i = 0; i < KEYS; i++) {
+		nstr_t *s = u2nstr(i, 16, nil);
+		keys[i] = nbuf_from_nstr(s, nil);
+		nput(s);
+		vals[i] = bench_val_create(i);
+		hashtab_put(table, keys[i], vals[i], nil);
+		chashtab_put(ctable, keys[i], vals[i], nil);
+	}
+
+	printf("throughput in million operations per second (%d%% writes) for\n",
+	       WRITE_RATIO * 100 / 256);
+	printf("%-18s", "threads:");
+	for (u32 i = 0; i < counts_len; i++)
+		printf(" %8u", counts[i]);
+	printf("\n");
+
+	for (variant = VARIANT_MUTEX; variant <= VARIANT_CHASHTAB; variant++) {
+		printf("%-18s", variant_names[variant]);
+		for (u32 i = 0; i < counts_len; i++)
+			run(counts[i]);
+		printf("\n");
+	}
+
+	for (u32 i = 0; i < KEYS; i++) {
+		nput(vals[i]);
+		nput(keys[i]);
+	}
+	nput(table);
+	nput(ctable);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
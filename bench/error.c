@@ -0,0 +1,87 @@
+/*
+ * Measure the cost of raising and catching errors, which happens in hot loops
+ * for expected failures like invalid input, and of formatting their message.
+ * See the end of this file for copyright and license terms.
+ */
+
+#include <errno.h>
+#include <neo.h>
+#include <neo/utf.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+#define ITERATIONS (1 << 20)
+
+NSTR_STATIC(static_message, "Key not found");
+
+enum variant {
+	VARIANT_PLAIN,
+	VARIANT_ARGS,
+	VARIANT_NSTR,
+	VARIANT_ERRMSG,
+};
+
+static const char *const variant_names[] = {
+	[VARIANT_PLAIN] = "yeet(), no arguments",
+	[VARIANT_ARGS] = "utf8_to_nchr() failure",
+	[VARIANT_NSTR] = "yeet_nstr()",
+	[VARIANT_ERRMSG] = "yeet() + errmsg()",
+};
+
+static void run(enum variant variant)
+{
+	u64 acc = 0;
+
+	f64 start = bench_now();
+	for (u32 i = 0; i < ITERATIONS; i++) {
+		error err;
+		nchar c;
+
+		switch (variant) {
+		case VARIANT_PLAIN:
+			yeet(&err, ENOENT, "Key not found");
+			break;
+		case VARIANT_ARGS:
+			utf8_to_nchr(&c, "\xc3\x28", &err);
+			break;
+		case VARIANT_NSTR:
+			yeet_nstr(&err, ENOENT, static_message);
+			break;
+		case VARIANT_ERRMSG:
+			utf8_to_nchr(&c, "\xc3\x28", &err);
+			acc += nlen(errmsg(&err));
+			break;
+		}
+
+		catch(&err) {
+			acc += errnum(&err);
+			errput(&err);
+		}
+	}
+	f64 elapsed = bench_now() - start;
+	bench_sink(acc);
+
+	printf("  %-26s %8.2f M errors/s\n", variant_names[variant],
+	       ITERATIONS / elapsed / 1e6);
+}
+
+void error_bench(void)
+{
+	printf("raising and catching an error:\n");
+	for (enum variant variant = VARIANT_PLAIN; variant <= VARIANT_ERRMSG; variant++)
+		run(variant);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,72 @@
+/*
+ * Micro benchmarks for various parts of libneo.  Run without arguments to
+ * execute all of them, or pass the names of the ones you are interested in.
+ * See the end of this file for copyright and license terms.
+ */
+
+/* clock_gettime */
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+static const struct {
+	const char *name;
+	void (*fn)(void);
+} benchmarks[] = {
+	{ "chashtab", chashtab_bench },
+	{ "error", error_bench },
+	{ "narena", narena_bench },
+	{ "nchrat", nchrat_bench },
+	{ "nhash", nhash_bench },
+	{ "npool", npool_bench },
+	{ "nref", nref_bench },
+	{ "utf8", utf8_bench },
+};
+
+f64 bench_now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+static volatile u64 sink;
+
+void bench_sink(u64 val)
+{
+	sink ^= val;
+}
+
+int main(int argc, char **argv)
+{
+	for (usize i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++) {
+		bool run = argc < 2;
+		for (int arg = 1; arg < argc; arg++)
+			run |= strcmp(argv[arg], benchmarks[i].name) == 0;
+		if (!run)
+			continue;
+
+		printf("==== running %s benchmark ====\n", benchmarks[i].name);
+		benchmarks[i].fn();
+		printf("==== end of %s benchmark ====\n\n", benchmarks[i].name);
+	}
+
+	return 0;
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,74 @@
+/*
+ * Compare creating lots of short-lived strings and buffers in an arena and
+ * resetting it afterwards against creating and releasing them one by one.
+ * See the end of this file for copyright and license terms.
+ */
+
+#include <neo.h>
+#include <neo/narena.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+#define ROUNDS		(1 << 12)
+/* objects per round, think of a round as handling one request */
+#define BATCH		256
+
+static nstr_t *strs[BATCH];
+static nbuf_t *bufs[BATCH];
+
+static void arena_bench(u32 flags)
+{
+	narena_t *arena = narena_create(0, flags, nil);
+
+	f64 start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++) {
+		for (u32 i = 0; i < BATCH; i++) {
+			strs[i] = nstr_in(arena, "owo what's this", nil);
+			bufs[i] = nbuf_from_in(arena, "uwu", 4, nil);
+		}
+		narena_reset(arena);
+	}
+	f64 time = bench_now() - start;
+
+	printf("  arena%s + reset: %7.2f M objects/s\n",
+	       (flags & NARENA_MMAP) ? " (mmap)" : "       ",
+	       2.0 * ROUNDS * BATCH / time / 1e6);
+	nput(arena);
+}
+
+void narena_bench(void)
+{
+	printf("creating and releasing %d strings and buffers at a time:\n", BATCH);
+
+	f64 start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++) {
+		for (u32 i = 0; i < BATCH; i++) {
+			strs[i] = nstr("owo what's this", nil);
+			bufs[i] = nbuf_from("uwu", 4, nil);
+		}
+		for (u32 i = 0; i < BATCH; i++) {
+			nput(strs[i]);
+			nput(bufs[i]);
+		}
+	}
+	f64 time = bench_now() - start;
+	printf("  nalloc       + nput:  %7.2f M objects/s\n",
+	       2.0 * ROUNDS * BATCH / time / 1e6);
+
+	arena_bench(0);
+	arena_bench(NARENA_MMAP);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,77 @@
+/*
+ * Compare random access by character index in a pure ASCII string, and in a
+ * string with mixed CJK and Latin characters with and without an index.
+ * See the end of this file for copyright and license terms.
+ */
+
+#include <neo.h>
+#include <neo/utf.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+#define REPS		64
+
+/* what nchrat() used to do: scan from the beginning every time */
+static nchar naive_chrat(const nstr_t *s, usize index)
+{
+	const char *ptr = nstr_raw(s);
+	while (index != 0) {
+		do {
+			ptr++;
+		} while ((*ptr & 0xc0) == 0x80);
+		index--;
+	}
+	nchar c;
+	utf8_to_nchr(&c, ptr, nil);
+	return c;
+}
+
+static void run(const char *name, nstr_t *s, bool naive)
+{
+	usize len = nlen(s);
+	usize reps = naive ? 1 : REPS;
+	u64 sum = 0;
+
+	f64 start = bench_now();
+	for (usize rep = 0; rep < reps; rep++) {
+		for (usize i = 0; i < len; i++)
+			sum += naive ? naive_chrat(s, i) : nchrat(s, i, nil);
+	}
+	f64 time = bench_now() - start;
+	bench_sink(sum);
+
+	printf("  %-24s %9.2f M chars/s\n", name, (f64)(reps * len) / time / 1e6);
+}
+
+void nchrat_bench(void)
+{
+	nstr_t *ascii_piece = nstr("the quick brown fox ", nil);
+	nstr_t *mixed_piece = nstr("\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e text \xe4\xb8\xad\xe6\x96\x87 ", nil);
+	nstr_t *ascii = nstrmul(ascii_piece, 1000, nil);
+	nstr_t *mixed = nstrmul(mixed_piece, 1000, nil);
+
+	printf("nchrat() for every index of a %zu character string:\n",
+	       (size_t)nlen(mixed));
+	run("ASCII", ascii, false);
+	run("CJK/Latin, full scan", mixed, true);
+	run("CJK/Latin, indexed", mixed, false);
+
+	nput(ascii);
+	nput(mixed);
+	nput(ascii_piece);
+	nput(mixed_piece);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
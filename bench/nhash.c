@@ -0,0 +1,150 @@
+/*
+ * Compare the builtin hash functions against djb2, which was the default one
+ * for hash tables before nhash() existed.  Throughput is measured in bytes
+ * per second for a range of key sizes, distribution by counting how evenly a
+ * set of typical (short and similar) keys is spread across table buckets.
+ * See the end of this file for copyright and license terms.
+ */
+
+#include <neo.h>
+#include <neo/nhash.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+/* the old default hash function, verbatim except for the signature */
+static u64 djb2(const void *data, usize size, u32 limit)
+{
+	const u8 *p = data;
+	u32 hash = 0;
+
+	for (usize i = 0; i < size; i++)
+		hash = (hash * 33) ^ p[i];
+
+	return hash % limit;
+}
+
+static const struct nhash_key sipkey = {
+	.k0 = 0x0706050403020100ull,
+	.k1 = 0x0f0e0d0c0b0a0908ull,
+};
+
+enum algo {
+	ALGO_DJB2,
+	ALGO_NHASH,
+	ALGO_SIPHASH,
+};
+
+static const char *const algo_names[] = {
+	[ALGO_DJB2] = "djb2",
+	[ALGO_NHASH] = "nhash",
+	[ALGO_SIPHASH] = "nsiphash",
+};
+
+static inline u64 hash(enum algo algo, const void *data, usize size)
+{
+	switch (algo) {
+	case ALGO_DJB2:
+		return djb2(data, size, 0xffffffff);
+	case ALGO_NHASH:
+		return nhash(data, size, 0x1234);
+	case ALGO_SIPHASH:
+		return nsiphash(data, size, &sipkey);
+	}
+	return 0;
+}
+
+static void throughput(enum algo algo)
+{
+	static u8 data[4096];
+	static const usize sizes[] = { 4, 8, 16, 32, 64, 256, 4096 };
+	const usize total = 1 << 26;
+
+	for (usize i = 0; i < sizeof(data); i++)
+		data[i] = (u8)(i * 7);
+
+	printf("  %-8s", algo_names[algo]);
+	for (usize s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		usize size = sizes[s];
+		usize rounds = total / size;
+		u64 acc = 0;
+
+		f64 start = bench_now();
+		for (usize i = 0; i < rounds; i++) {
+			/* vary the input a little so nothing can be hoisted */
+			data[0] = (u8)i;
+			acc += hash(algo, data, size);
+		}
+		f64 elapsed = bench_now() - start;
+		bench_sink(acc);
+
+		printf(" %9.1f", (f64)(rounds * size) / elapsed / (1024.0 * 1024.0));
+	}
+	printf("\n");
+}
+
+/*
+ * Insert `count` keys of the form "key123" into `buckets` buckets, using the
+ * bucket selection the hash table did before (djb2 % (buckets - 1)) and does
+ * now (nhash & (buckets - 1)), and print the number of empty buckets, the
+ * longest chain, and the average number of key comparisons for a successful
+ * lookup.  Ideal values for load factor 1 are about 36.8% empty buckets and
+ * 1.5 comparisons.
+ */
+static void distribution(enum algo algo, u32 buckets, u32 count)
+{
+	static u32 chains[1 << 16];
+	memset(chains, 0, sizeof(chains[0]) * buckets);
+
+	for (u32 i = 0; i < count; i++) {
+		char key[16];
+		int size = snprintf(key, sizeof(key), "key%u", i);
+		u32 bucket;
+		if (algo == ALGO_DJB2)
+			bucket = (u32)djb2(key, (usize)size, buckets - 1);
+		else
+			bucket = (u32)(hash(algo, key, (usize)size) & (buckets - 1));
+		chains[bucket]++;
+	}
+
+	u32 empty = 0;
+	u32 longest = 0;
+	u64 comparisons = 0;
+	for (u32 i = 0; i < buckets; i++) {
+		if (chains[i] == 0)
+			empty++;
+		longest = nmax(longest, chains[i]);
+		comparisons += (u64)chains[i] * (chains[i] + 1) / 2;
+	}
+
+	printf("  %-8s %6u buckets: %5.1f%% empty, longest chain %3u, %.2f comparisons/lookup\n",
+	       algo_names[algo], buckets, 100.0 * empty / buckets, longest,
+	       (f64)comparisons / count);
+}
+
+void nhash_bench(void)
+{
+	printf("throughput in MiB/s for key sizes 4, 8, 16, 32, 64, 256, 4096:\n");
+	for (enum algo algo = ALGO_DJB2; algo <= ALGO_SIPHASH; algo++)
+		throughput(algo);
+
+	printf("\nbucket distribution of \"key%%u\" keys at load factor 1:\n");
+	for (u32 buckets = 64; buckets <= (1 << 16); buckets <<= 5) {
+		for (enum algo algo = ALGO_DJB2; algo <= ALGO_SIPHASH; algo++)
+			distribution(algo, buckets, buckets);
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,96 @@
+/*
+ * Compare the pool allocator against plain nalloc() for small objects, both
+ * in isolation and through the string and buffer functions that use it.
+ * See the end of this file for copyright and license terms.
+ */
+
+#include <neo.h>
+#include <stdio.h>
+
+#include "bench.h"
+
+#define ROUNDS		(1 << 12)
+/* objects alive at the same time, to make the allocator's life harder */
+#define BATCH		256
+
+static void *objs[BATCH];
+static nstr_t *strs[BATCH];
+static nbuf_t *bufs[BATCH];
+
+static void alloc_bench(usize size)
+{
+	f64 start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++) {
+		for (u32 i = 0; i < BATCH; i++)
+			objs[i] = nalloc(size, nil);
+		for (u32 i = 0; i < BATCH; i++)
+			nfree(objs[i]);
+	}
+	f64 nalloc_time = bench_now() - start;
+
+	start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++) {
+		for (u32 i = 0; i < BATCH; i++)
+			objs[i] = npool_alloc(size, nil);
+		for (u32 i = 0; i < BATCH; i++)
+			npool_free(objs[i], size);
+	}
+	f64 npool_time = bench_now() - start;
+
+	printf("  %3zu bytes: nalloc %7.2f, npool %7.2f M allocations/s\n", size,
+	       ROUNDS * BATCH / nalloc_time / 1e6, ROUNDS * BATCH / npool_time / 1e6);
+}
+
+static void clone_bench(void)
+{
+	nstr_t *s = nstr("owo what's this", nil);
+	nbuf_t *b = nbuf_from_str("owo what's this", nil);
+
+	f64 start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++) {
+		for (u32 i = 0; i < BATCH; i++)
+			strs[i] = nstrdup(s, nil);
+		for (u32 i = 0; i < BATCH; i++)
+			nput(strs[i]);
+	}
+	f64 nstrdup_time = bench_now() - start;
+
+	start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++) {
+		for (u32 i = 0; i < BATCH; i++)
+			bufs[i] = nbuf_clone(b, nil);
+		for (u32 i = 0; i < BATCH; i++)
+			nput(bufs[i]);
+	}
+	f64 nbuf_clone_time = bench_now() - start;
+
+	printf("  nstrdup + nput:    %7.2f M/s\n", ROUNDS * BATCH / nstrdup_time / 1e6);
+	printf("  nbuf_clone + nput: %7.2f M/s\n", ROUNDS * BATCH / nbuf_clone_time / 1e6);
+
+	nput(s);
+	nput(b);
+}
+
+void npool_bench(void)
+{
+	printf("allocating and releasing %d objects at a time:\n", BATCH);
+	alloc_bench(24);
+	alloc_bench(64);
+	alloc_bench(200);
+
+	printf("\nlibrary functions using pools:\n");
+	clone_bench();
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
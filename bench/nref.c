@@ -0,0 +1,158 @@
+/*
+ * Measure how nget() and nput() on a single object scale with the number of
+ * threads hammering it at the same time, for regular, biased and immortal
+ * reference counts.  For biased counts, the first thread is the owner.
+ * See the end of this file for copyright and license terms.
+ */
+
+/* sysconf */
+#define _POSIX_C_SOURCE 200809L
+
+#include <neo.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define OPS_PER_THREAD (1 << 22)
+
+struct bench_obj {
+	NREF_FIELD;
+	u64 payload;
+};
+
+enum variant {
+	VARIANT_ATOMIC,
+	VARIANT_BIASED,
+	VARIANT_IMMORTAL,
+};
+
+static const char *const variant_names[] = {
+	[VARIANT_ATOMIC] = "atomic",
+	[VARIANT_BIASED] = "biased",
+	[VARIANT_IMMORTAL] = "immortal",
+};
+
+static struct bench_obj *obj;
+/* accumulated throughput of all threads in operations per second */
+static f64 total_rate;
+/* throughput of the first thread only */
+static f64 owner_rate;
+static pthread_mutex_t rate_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void bench_obj_destroy(struct bench_obj *o)
+{
+	nfree(o);
+}
+
+static void *worker(void *arg)
+{
+	struct bench_obj *o = obj;
+	u64 acc = 0;
+
+	f64 start = bench_now();
+	for (u32 op = 0; op < OPS_PER_THREAD; op++) {
+		nget(o);
+		acc += o->payload;
+		nput(o);
+	}
+	f64 rate = OPS_PER_THREAD / (bench_now() - start);
+
+	pthread_mutex_lock(&rate_lock);
+	total_rate += rate;
+	if (arg == nil)
+		owner_rate = rate;
+	pthread_mutex_unlock(&rate_lock);
+
+	bench_sink(acc);
+	return nil;
+}
+
+static f64 run(enum variant variant, u32 threads)
+{
+	pthread_t tids[threads];
+
+	obj = nalloc(sizeof(*obj), nil);
+	obj->payload = threads;
+	if (variant == VARIANT_BIASED)
+		nref_init_biased(obj, bench_obj_destroy);
+	else
+		nref_init(obj, bench_obj_destroy);
+	if (variant == VARIANT_IMMORTAL)
+		nref_make_immortal(obj);
+
+	total_rate = 0;
+	/* the calling thread is the first worker, and owns the biased count */
+	for (u32 t = 1; t < threads; t++)
+		pthread_create(&tids[t], nil, worker, (void *)(usize)t);
+	worker(nil);
+	for (u32 t = 1; t < threads; t++)
+		pthread_join(tids[t], nil);
+
+	printf(" %8.2f", total_rate / 1e6);
+	fflush(stdout);
+
+	if (variant == VARIANT_IMMORTAL)
+		nfree(obj);
+	else
+		nput(obj);
+	return owner_rate;
+}
+
+/** Powers of two up to the number of CPUs, and the number of CPUs itself */
+static u32 thread_counts(u32 *counts, u32 max)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	u32 n = 0;
+
+	for (u32 threads = 1; threads < cpus && n < max - 1; threads *= 2)
+		counts[n++] = threads;
+	counts[n++] = cpus < 1 ? 1 : (u32)cpus;
+
+	return n;
+}
+
+void nref_bench(void)
+{
+	u32 counts[32];
+	u32 counts_len = thread_counts(counts, 32);
+	f64 owner_rates[32];
+
+	printf("throughput of nget() + nput() pairs on a single object in\n");
+	printf("million pairs per second\n");
+	printf("%-16s", "threads:");
+	for (u32 i = 0; i < counts_len; i++)
+		printf(" %8u", counts[i]);
+	printf("\n");
+
+	for (enum variant variant = VARIANT_ATOMIC; variant <= VARIANT_IMMORTAL; variant++) {
+		printf("%-16s", variant_names[variant]);
+		for (u32 i = 0; i < counts_len; i++) {
+			f64 rate = run(variant, counts[i]);
+			if (variant == VARIANT_BIASED)
+				owner_rates[i] = rate;
+		}
+		printf("\n");
+
+		if (variant == VARIANT_BIASED) {
+			printf("%-16s", "  owner thread");
+			for (u32 i = 0; i < counts_len; i++)
+				printf(" %8.2f", owner_rates[i] / 1e6);
+			printf("\n");
+		}
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,110 @@
+/*
+ * Measure the throughput of UTF-8 validation and code point counting, which
+ * every string construction has to go through, against decoding one character
+ * at a time with utf8_to_nchr().  Also measure conversion to UTF-16 and back.
+ * See the end of this file for copyright and license terms.
+ */
+
+#include <neo.h>
+#include <neo/utf.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define SIZE		(1 << 20)
+#define ROUNDS		64
+
+static char text[SIZE + 4];
+static u8 units[4 * SIZE];
+
+static void fill(const char *piece)
+{
+	usize piece_size = strlen(piece);
+	usize size = 0;
+	while (size + piece_size <= SIZE) {
+		memcpy(&text[size], piece, piece_size);
+		size += piece_size;
+	}
+	memset(&text[size], 0, sizeof(text) - size);
+}
+
+/* what utf8_check() used to do */
+static usize naive_check(const char *s)
+{
+	usize len = 0;
+	nchar c;
+	while (*s != '\0') {
+		len++;
+		s += utf8_to_nchr(&c, s, nil);
+	}
+	return len;
+}
+
+static void run(const char *name, const char *piece)
+{
+	fill(piece);
+	usize size = strlen(text);
+	f64 start, time;
+
+	start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++)
+		bench_sink(naive_check(text));
+	time = bench_now() - start;
+	printf("  %-10s utf8_to_nchr loop: %7.2f GB/s\n", name, (f64)size * ROUNDS / time / 1e9);
+
+	start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++)
+		bench_sink(utf8_check(text, nil));
+	time = bench_now() - start;
+	printf("  %-10s utf8_check:        %7.2f GB/s\n", name, (f64)size * ROUNDS / time / 1e9);
+
+	start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++)
+		bench_sink(utf8_strlen(text));
+	time = bench_now() - start;
+	printf("  %-10s utf8_strlen:       %7.2f GB/s\n", name, (f64)size * ROUNDS / time / 1e9);
+
+	start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++) {
+		nstr_t *s = nstr(text, nil);
+		bench_sink(nlen(s));
+		nput(s);
+	}
+	time = bench_now() - start;
+	printf("  %-10s nstr:              %7.2f GB/s\n", name, (f64)size * ROUNDS / time / 1e9);
+
+	start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++)
+		bench_sink(utf8_to_utf16(units, sizeof(units), text, size, UTF_LE, nil, nil));
+	time = bench_now() - start;
+	printf("  %-10s utf8_to_utf16:     %7.2f GB/s\n", name, (f64)size * ROUNDS / time / 1e9);
+
+	usize units_size = utf8_to_utf16(units, sizeof(units), text, size, UTF_LE, nil, nil);
+	start = bench_now();
+	for (u32 round = 0; round < ROUNDS; round++)
+		bench_sink(utf16_to_utf8(text, size, units, units_size, UTF_LE, nil, nil));
+	time = bench_now() - start;
+	printf("  %-10s utf16_to_utf8:     %7.2f GB/s\n", name, (f64)size * ROUNDS / time / 1e9);
+}
+
+void utf8_bench(void)
+{
+	printf("validating %d MiB of text:\n", SIZE >> 20);
+	run("ASCII", "the quick brown fox jumps over the lazy dog. ");
+	run("mixed", "the quick brown \xc3\xa4 fox \xe2\x82\xac jumps \xf0\x9f\xa6\x8a ");
+	run("CJK", "\xe6\x97\xa5\xe6\x9c\xac\xe8\xaa\x9e\xe4\xb8\xad\xe6\x96\x87");
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
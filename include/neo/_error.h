@@ -18,14 +18,41 @@
  * on the object exactly once, or the behavior is undefined.
  * If a function yeets an error, its return value is undefined.
  *
+ * Raising an error doesn't allocate any memory.  The message is only
+ * formatted when someone asks for it using `errmsg()`, which is why `fmt` must
+ * be a string literal or otherwise stay valid for as long as the error does.
+ * Arguments are captured by value, except for strings (`%s`), which are
+ * formatted right away because they might not live long enough.
+ *
  * @param err The error pointer passed to the callee
  * @param number An error number appropriate for the condition,
  *	usually one from `errno.h`
  * @param fmt If non `nil`, a printf-style format string followed by
  *	the values to insert which will become the error message.
  */
-void yeet(error *err, u32 number, const char *restrict fmt, ...)
-__attribute__(( __format__(printf, 3, 4) ));
+#define yeet(err, number, ...) _neo_yeet(err, number, __FILE__, __LINE__, __VA_ARGS__)
+
+void _neo_yeet(error *err, u32 number, const char *file, int line,
+	       const char *restrict fmt, ...)
+__attribute__(( __format__(printf, 5, 6) ));
+
+/**
+ * @brief Throw an error with a message that is already a neo string.
+ *
+ * This is the cheapest way to raise an error, especially with strings defined
+ * by `NSTR_STATIC`, because it doesn't have to format or copy anything.
+ * Otherwise, it behaves exactly like `yeet()`.
+ *
+ * @param err The error pointer passed to the callee
+ * @param number An error number appropriate for the condition,
+ *	usually one from `errno.h`
+ * @param msg The error message, the error acquires its own reference to it
+ */
+#define yeet_nstr(err, number, msg) _neo_yeet_nstr(err, number, msg, __FILE__, __LINE__)
+
+void _neo_yeet_nstr(error *err, u32 number, nstr_t *msg, const char *file, int line);
+
+nstr_t *_neo_errmsg(error *err);
 
 /**
  * @brief Indicate an operation has completed successfully.
@@ -82,11 +109,82 @@ void errput(error *err);
  * @brief Get an optional error message, this may be `nil`.
  *
  * Must only be used within a catch block and before `errput()` is called.
+ * The message is formatted on the first call, so this might allocate memory.
  *
  * @param err `error *` to get the message of
  * @returns The error message, may be `nil`
  */
-#define errmsg(err) ((err) == nil ? (nstr_t *)nil : (err)->_message)
+#define errmsg(err) _neo_errmsg(err)
+
+/** @brief Number of errors remembered per thread, see `error_trace()`. */
+#define ERROR_TRACE_SIZE 32
+
+/**
+ * @brief Error numbers below this are counted individually by
+ * `error_count()`, all others share the counter for this number.
+ */
+#define ERROR_TRACE_NUMBERS 256
+
+/**
+ * @brief An error recorded by `yeet()`, see `error_trace()`.
+ */
+struct error_trace_entry {
+	/** @brief Error number passed to `yeet()`. */
+	u32 number;
+	/** @brief Line number of the `yeet()` call. */
+	int line;
+	/** @brief Source file of the `yeet()` call. */
+	const char *file;
+	/**
+	 * @brief Time of the `yeet()` call in nanoseconds (`CLOCK_MONOTONIC`,
+	 * but only accurate to a few milliseconds on Linux).
+	 */
+	u64 time;
+};
+
+/**
+ * @brief Get the most recent errors yeeted by the calling thread.
+ *
+ * Every thread records the last `ERROR_TRACE_SIZE` errors it yeeted in a ring
+ * buffer, including ones that were caught, if libneo was built with the
+ * `ERROR_TRACE` option.  If it wasn't, this function yeets `ENOSYS`.
+ * Recording an error is cheap enough for production builds, it costs a
+ * timestamp and a few stores.
+ *
+ * @param entries Array to store up to `max` errors in, newest first.  May be
+ *	`nil` if `max` is 0.
+ * @param max Length of `entries`
+ * @param err Error pointer
+ * @returns The number of errors stored in `entries`
+ */
+usize error_trace(struct error_trace_entry *entries, usize max, error *err);
+
+/**
+ * @brief Write the calling thread's most recent errors to a file descriptor.
+ *
+ * This is async-signal-safe, so it can be called from a handler for `SIGSEGV`
+ * and friends to see what went wrong before the crash.  It is also called
+ * automatically before the program exits because of an error that was yeeted
+ * to a `nil` error pointer.  Does nothing if libneo was built without the
+ * `ERROR_TRACE` option.
+ *
+ * @param fd File descriptor to write to, e.g. 2 for `stderr`
+ */
+void error_trace_dump(int fd);
+
+/**
+ * @brief Get the number of times an error number was yeeted by any thread.
+ *
+ * This is meant for monitoring, for example to alert on a rising rate of
+ * `ENOMEM` without having to log every single error.  Like `error_trace()`,
+ * this yeets `ENOSYS` if libneo was built without the `ERROR_TRACE` option.
+ *
+ * @param number Error number to get the count for, anything greater than or
+ *	equal to `ERROR_TRACE_NUMBERS` returns the count of all of them
+ * @param err Error pointer
+ * @returns The number of times `number` was yeeted since the program started
+ */
+u64 error_count(u32 number, error *err);
 
 /** @} */
 
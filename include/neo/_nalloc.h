@@ -27,7 +27,10 @@ void nfree(void *ptr);
  * @param size Desired memory size in bytes
  * @param err Error object
  */
-void *nalloc(usize size, error *err) __neo_malloc(nfree, 1);
+#define nalloc(size, err) _neo_nalloc(size, err, __FILE__, __LINE__)
+/** @private */
+void *_neo_nalloc(usize size, error *err, const char *file, int line)
+__neo_malloc(nfree, 1);
 
 /**
  * Allocate `size` bytes of memory and return a pointer to the memory region.
@@ -38,7 +41,10 @@ void *nalloc(usize size, error *err) __neo_malloc(nfree, 1);
  * @param size Desired memory size in bytes
  * @param err Error object
  */
-void *nzalloc(usize size, error *err) __neo_malloc(nfree, 1);
+#define nzalloc(size, err) _neo_nzalloc(size, err, __FILE__, __LINE__)
+/** @private */
+void *_neo_nzalloc(usize size, error *err, const char *file, int line)
+__neo_malloc(nfree, 1);
 
 /**
  * Resize an allocated memory region to fit at least `newsize` bytes and return
@@ -52,7 +58,201 @@ void *nzalloc(usize size, error *err) __neo_malloc(nfree, 1);
  * @param newsize The new size
  * @param err Error object
  */
-void *nrealloc(void *ptr, usize newsize, error *err) __neo_malloc(nfree, 1);
+#define nrealloc(ptr, newsize, err) _neo_nrealloc(ptr, newsize, err, __FILE__, __LINE__)
+/** @private */
+void *_neo_nrealloc(void *ptr, usize newsize, error *err, const char *file, int line)
+__neo_malloc(nfree, 1);
+
+/**
+ * Mark memory allocated with `nalloc()` as intentionally never released,
+ * so it doesn't show up in the `NALLOC_STATS` leak report at exit.
+ * @private
+ */
+void _neo_nalloc_permanent(void *ptr);
+
+/**
+ * @brief Release memory allocated with `npool_alloc()`.
+ *
+ * @param ptr Pointer returned by `npool_alloc()`, may be `nil`
+ * @param size The exact same size that was passed to `npool_alloc()`
+ */
+void npool_free(void *ptr, usize size);
+
+/**
+ * @brief Allocate a small object from a pool.
+ *
+ * This is intended for structures that are allocated and released at high
+ * rates.  Objects of up to 256 bytes are served from slabs that are shared
+ * by all objects of similar size, and every thread keeps a local cache of
+ * free objects, so this is much faster than `nalloc()` in most cases.
+ * Larger objects are just forwarded to `nalloc()`.  Memory must be released
+ * using `npool_free()` rather than `nfree()`, which also needs to know the
+ * size.  Objects may be released by a different thread than the one that
+ * allocated them.  The memory is *not* initialized.
+ * If `size` is 0, the allocation fails.
+ * If the allocation fails, the error is set and `nil` is returned.
+ *
+ * @param size Desired memory size in bytes
+ * @param err Error object
+ */
+void *npool_alloc(usize size, error *err) __neo_malloc(npool_free, 1);
+
+/**
+ * @brief An allocator backend.
+ *
+ * All memory that libneo allocates, including the memory for error messages
+ * and the slabs that `npool_alloc()` carves objects out of, is ultimately
+ * requested from a backend.  The default one forwards everything to libc.
+ *
+ * The callbacks don't have to deal with sizes of 0 or `nil` pointers, and they
+ * may assume that memory passed to `free` and `realloc` was allocated by the
+ * same backend.  Every allocation remembers the backend it came from, so the
+ * backend must remain valid until all memory allocated from it is released.
+ */
+struct nalloc_backend {
+	/** @brief Allocate `size` bytes, or return `nil` on failure. */
+	void *(*alloc)(usize size, void *ctx);
+	/** @brief Allocate `size` zeroed bytes (optional, may be `nil`). */
+	void *(*zalloc)(usize size, void *ctx);
+	/** @brief Resize an allocation (optional, may be `nil`). */
+	void *(*realloc)(void *ptr, usize newsize, void *ctx);
+	/** @brief Release memory, may be a no-op (e.g. for arenas). */
+	void (*free)(void *ptr, void *ctx);
+	/** @brief Passed to every callback as the last parameter. */
+	void *ctx;
+};
+
+/** @brief The builtin backend, which uses `malloc()` and friends. */
+extern const struct nalloc_backend nalloc_libc_backend;
+
+/**
+ * @brief The backend used if `nalloc_backend_set()` was never called.
+ *
+ * This is a weak symbol pointing to `nalloc_libc_backend`.  Applications can
+ * replace it at link time by defining their own non-weak version, which
+ * makes sure that even allocations from within constructors go through it.
+ */
+extern const struct nalloc_backend *const nalloc_default_backend;
+
+/**
+ * @brief Replace the process-wide allocator backend.
+ *
+ * Memory that was allocated before the call continues to be released through
+ * the backend it was allocated from.  This is safe to call from any thread.
+ *
+ * @param backend The new backend, or `nil` to restore `nalloc_default_backend`
+ * @returns The previous process-wide backend
+ */
+const struct nalloc_backend *nalloc_backend_set(const struct nalloc_backend *backend);
+
+/**
+ * @brief Get the backend that `nalloc()` would use on the calling thread.
+ *
+ * @returns The thread's scoped backend if there is one,
+ *	and the process-wide backend otherwise
+ */
+const struct nalloc_backend *nalloc_backend_get(void);
+
+/**
+ * @brief Route all allocations of the calling thread to another backend.
+ *
+ * The override remains in effect until it is undone with `nalloc_scope_exit()`,
+ * and scopes can be nested.  This only affects allocations made by the calling
+ * thread, and only new allocations: objects created within the scope can be
+ * released outside of it, and vice versa.
+ *
+ * Small objects from `npool_alloc()` are carved out of slabs that all threads
+ * share, so they always come from the process-wide backend and are not
+ * affected by scopes.  Within libneo, that applies to hash table entries,
+ * buffer and string clones and slices, rope nodes, weak references and the
+ * state of biased reference counters.
+ * Everything else, including the contents of strings and buffers, uses the
+ * scoped backend.
+ *
+ * @param backend Backend to use within the scope, or `nil` to use the
+ *	process-wide backend
+ * @returns The previous scope, which must be passed to `nalloc_scope_exit()`
+ */
+const struct nalloc_backend *nalloc_scope_enter(const struct nalloc_backend *backend);
+
+/**
+ * @brief Leave a scope entered with `nalloc_scope_enter()`.
+ *
+ * @param prev The value returned by the corresponding `nalloc_scope_enter()`
+ */
+void nalloc_scope_exit(const struct nalloc_backend *prev);
+
+/** @brief Number of size classes in `struct nalloc_stats`. */
+#define NALLOC_STATS_CLASSES 16
+
+/**
+ * @brief Global allocation statistics, see `nalloc_stats()`.
+ */
+struct nalloc_stats {
+	/** @brief Bytes currently allocated (excluding bookkeeping overhead). */
+	usize live_bytes;
+	/** @brief Highest value `live_bytes` ever had. */
+	usize peak_bytes;
+	/** @brief Number of allocations that are still alive. */
+	usize live_count;
+	/** @brief Total number of successful allocations. */
+	u64 allocs;
+	/** @brief Total number of releases. */
+	u64 frees;
+	/**
+	 * @brief Number of allocations per size class.
+	 *
+	 * Class 0 counts allocations of up to 16 bytes, and every following
+	 * class twice as much as the previous one.  The last class counts
+	 * everything that doesn't fit into any of the others.
+	 */
+	u64 class_allocs[NALLOC_STATS_CLASSES];
+};
+
+/**
+ * @brief Allocation statistics for a single call site.
+ */
+struct nalloc_site_stats {
+	/** @brief Source file of the `nalloc()` call. */
+	const char *file;
+	/** @brief Line number of the `nalloc()` call. */
+	int line;
+	/** @brief Total number of allocations made here. */
+	u64 allocs;
+	/** @brief Number of allocations made here that are still alive. */
+	usize live_count;
+	/** @brief Bytes allocated here that are still alive. */
+	usize live_bytes;
+};
+
+/**
+ * @brief Take a snapshot of the global allocation statistics.
+ *
+ * Statistics are only collected if libneo was built with the `NALLOC_STATS`
+ * option, which also makes it print a report of all call sites with memory
+ * that is still allocated when the program exits.  If it wasn't, this
+ * function yeets `ENOSYS`.
+ * The individual counters are not updated atomically as a whole, so they
+ * may be slightly inconsistent with each other if other threads are running.
+ *
+ * @param stats Where to store the statistics
+ * @param err Error pointer
+ */
+void nalloc_stats(struct nalloc_stats *stats, error *err);
+
+/**
+ * @brief Take a snapshot of the per call site allocation statistics.
+ *
+ * Like `nalloc_stats()`, this yeets `ENOSYS` if libneo was built without the
+ * `NALLOC_STATS` option.
+ *
+ * @param sites Array to store up to `max` call sites in, may be `nil` if
+ *	`max` is 0
+ * @param max Length of `sites`
+ * @param err Error pointer
+ * @returns The total number of call sites, which may be more than `max`
+ */
+usize nalloc_site_stats(struct nalloc_site_stats *sites, usize max, error *err);
 
 /** @} */
 
@@ -70,6 +70,23 @@ nbuf_t *nbuf_from_nstr(nstr_t *s, error *err);
  */
 nbuf_t *nbuf_clone(nbuf_t *buf, error *err);
 
+/**
+ * @brief Get a part of a buffer without copying it.
+ *
+ * The slice is a view into the original buffer's memory, and holds a
+ * reference to it.  Unlike buffers created with `nbuf_create()`, its data is
+ * not followed by any padding.
+ * If `buf` is `nil`, `len` is 0, the range is out of bounds, or allocation
+ * fails, an error is yeeted.
+ *
+ * @param buf Buffer to slice
+ * @param offset Offset of the first byte to include
+ * @param len Number of bytes to include
+ * @param err Error pointer
+ * @returns The slice, unless an error occurred
+ */
+nbuf_t *nbuf_slice(nbuf_t *buf, usize offset, usize len, error *err);
+
 /**
  * @brief Get the byte at the specified index.
  *
@@ -130,6 +147,23 @@ int nbuf_cmp(const nbuf_t *buf1, const nbuf_t *buf2, error *err);
  */
 #define nbuf_eq(buf1, buf2, err) ( (bool)(nbuf_cmp(buf1, buf2, err) == 0) )
 
+/**
+ * @brief Get a 64-bit hash of a buffer's contents.
+ *
+ * The hash is computed using `nhash()` with a random seed that is the same for
+ * all buffers within the process, and cached inside the buffer.  Buffers are
+ * immutable, so subsequent calls (like repeated hash table operations with the
+ * same key, even across different tables) are almost free.  Clones created
+ * with `nbuf_clone()` inherit the cached value.
+ *
+ * If `buf` is `nil`, an error is yeeted.
+ *
+ * @param buf Buffer to hash
+ * @param err Error pointer
+ * @returns The hash, unless an error occurred
+ */
+u64 nbuf_hash(const nbuf_t *buf, error *err);
+
 /** @} */
 
 /*
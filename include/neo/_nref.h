@@ -4,11 +4,33 @@
 
 #include "neo/_types.h"
 
+/**
+ * Reference count of objects that are never destroyed, like strings defined
+ * with `NSTR_STATIC`.  `_neo_nget()` and `_neo_nput()` don't touch counters
+ * with this value, so such objects may live in read-only memory.
+ * @private
+ */
+#define _NEO_NREF_IMMORTAL 0x40000000
+
+/**
+ * Anything close enough to `_NEO_NREF_IMMORTAL` is considered immortal as
+ * well, because `nget()` and `nput()` calls from other threads might race
+ * against `nref_make_immortal()` and still modify the count by a little.
+ * @private
+ */
+#define _neo_nref_is_immortal(count) ((count) >= _NEO_NREF_IMMORTAL / 2)
+
 void _neo_nref_init(struct _neo_nref *ref, void (*destroy)(void *ptr), usize offset);
+void _neo_nref_init_biased(struct _neo_nref *ref, void (*destroy)(void *ptr), usize offset);
+void _neo_nref_unbias(struct _neo_nref *ref);
+int _neo_nref_count(const struct _neo_nref *ref);
+void _neo_nref_make_immortal(struct _neo_nref *ref);
 
 int _neo_nget(struct _neo_nref *ref);
 int _neo_nput(struct _neo_nref *ref);
 
+nweak_t *_neo_nweak(struct _neo_nref *ref, error *err);
+
 /**
  * @defgroup nref Reference Counting
  *
@@ -35,6 +57,72 @@ int _neo_nput(struct _neo_nref *ref);
 		       offsetof(typeof(*(ptr)), __neo_nref));			\
 })
 
+/**
+ * @brief Initialize the reference counter in a structure, biased towards
+ * the calling thread.
+ *
+ * This works exactly like `nref_init()`, except that `nget()` and `nput()`
+ * from the thread calling this use a plain (non-atomic) counter.  Other
+ * threads use the regular atomic one, and both are merged when the owning
+ * thread has dropped all of its references.  Use this for structures that
+ * are mostly used by the thread that created them, but occasionally shared
+ * with others.  References may be passed between threads freely, but see
+ * `nref_unbias()` if the owning thread gives away its last reference.
+ *
+ * @param ptr The `struct *` containing the `NREF_FIELD`
+ * @param destroy A callback accepting a pointer to the original struct as its
+ *	only parameter and return type `void`, which will deallocate the struct
+ */
+#define nref_init_biased(ptr, destroy) ({					\
+	void (*__destroy_typechecked)(typeof(ptr)) = (destroy);			\
+	_neo_nref_init_biased(&(ptr)->__neo_nref,				\
+			      (void (*)(void *))__destroy_typechecked,		\
+			      offsetof(typeof(*(ptr)), __neo_nref));		\
+})
+
+/**
+ * @brief Stop biasing the reference counter towards the calling thread.
+ *
+ * The owning thread's references are merged into the atomic counter, so
+ * the structure behaves as if it had been initialized with `nref_init()`.
+ * This happens automatically when the owner drops its last reference.
+ * However, if a reference taken by the owner is handed off to another
+ * thread, dropping it there can't end the bias.  The owning thread must call
+ * this if it won't call `nput()` on the structure ever again, for example
+ * before it exits, or the structure is never destroyed.
+ *
+ * Calling this from any other thread, or on structures whose count isn't
+ * biased, does nothing.
+ *
+ * @param ptr The `struct *` to stop biasing
+ */
+#define nref_unbias(ptr) _neo_nref_unbias(&(ptr)->__neo_nref)
+
+/**
+ * @brief Make a structure embedding `NREF_FIELD` immortal.
+ *
+ * Immortal structures are never destroyed, and `nget()`, `nput()`,
+ * `borrow()` and `unborrow()` on them return without writing to the
+ * reference counter.  This avoids the counter's cache line bouncing between
+ * CPUs for objects that many threads share for the entire lifetime of the
+ * program, like global lookup tables.  Strings defined with `NSTR_DEFINE`
+ * or `NSTR_STATIC` are immortal from the start.
+ *
+ * This cannot be undone.  Any references still held at the time of the call
+ * may be dropped or not, it makes no difference.
+ *
+ * @param ptr The `struct *` to make immortal
+ */
+#define nref_make_immortal(ptr) _neo_nref_make_immortal(&(ptr)->__neo_nref)
+
+/**
+ * @brief Check whether a structure embedding `NREF_FIELD` is immortal.
+ *
+ * @param ptr The `struct *` to check
+ * @returns `true` if `nref_make_immortal()` was called on `ptr`
+ */
+#define nref_is_immortal(ptr) _neo_nref_is_immortal((ptr)->__neo_nref._count)
+
 /**
  * @brief Increment the reference counter of a structure embedding `NREF_FIELD`.
  *
@@ -83,14 +171,100 @@ int _neo_nput(struct _neo_nref *ref);
  */
 #define unborrow(nref) ((void)_neo_nput(nref))
 
+/**
+ * @brief Get a weak reference to a structure embedding `NREF_FIELD`.
+ *
+ * A weak reference doesn't keep the structure alive, but it can be turned
+ * back into a regular one using `nweak_upgrade()` for as long as the
+ * structure has not been destroyed.  This is useful for caches that should
+ * not be the reason for something to stay in memory.  Weak references are
+ * refcounted themselves, and must be released with `nput()` when they are
+ * no longer needed.  Calling this multiple times on the same structure
+ * returns the same weak reference, except for immortal structures (see
+ * `nref_make_immortal()`).  Those might be in read-only memory, so there is
+ * nowhere to remember the weak reference, and every call allocates a new one
+ * that can always be upgraded.  If allocation fails, an error is yeeted.
+ *
+ * @param ptr The `struct *` to get a weak reference to, the caller must own
+ *	a regular reference to it
+ * @param err Error pointer
+ * @returns A new reference to the weak reference, unless an error occurred
+ */
+#define nweak(ptr, err) _neo_nweak(&(ptr)->__neo_nref, err)
+
+/**
+ * @brief Get a regular reference to the structure a weak reference points to.
+ *
+ * The caller owns the returned reference and must `nput()` it when done.
+ * Upgrading is cheap, it only has to take a spinlock that is held for the
+ * duration of a compare-and-swap at most.
+ *
+ * @param weak The weak reference returned by `nweak()`
+ * @returns A pointer to the structure passed to `nweak()`, or `nil` if it has
+ *	already been destroyed or `weak` is `nil`
+ */
+void *nweak_upgrade(nweak_t *weak);
+
+/**
+ * @brief Enable or disable deferred release for the calling thread.
+ *
+ * Normally, the destroy callback passed to `nref_init()` is invoked by
+ * whichever thread drops the last reference, right inside `nput()`.  That
+ * can be expensive if the structure releases lots of others in turn, like
+ * a hash table with thousands of keys.  While deferred release is enabled,
+ * structures whose last reference is dropped by the calling thread are
+ * appended to a per-thread reclamation queue instead.  They are destroyed
+ * when the thread calls `nref_reclaim()` at a convenient time, or hands them
+ * off to a background thread with `nref_reclaim_handoff()`.
+ *
+ * Weak references to queued structures can't be upgraded anymore.  A thread
+ * must empty its queue before it exits, or the structures in it are leaked.
+ *
+ * @param enable Whether to defer releasing structures
+ */
+void nref_defer_release(bool enable);
+
+/**
+ * @brief Destroy structures from the calling thread's reclamation queue.
+ *
+ * Structures are destroyed in the order they were queued in.  If deferred
+ * release is still enabled, structures released by the destroy callbacks are
+ * added to the end of the queue and may be destroyed by the same call.
+ *
+ * @param max Maximum number of structures to destroy, or 0 for all of them
+ * @returns The number of structures that were destroyed
+ */
+usize nref_reclaim(usize max);
+
+/**
+ * @brief Move all structures in the calling thread's reclamation queue to a
+ * queue shared by all threads.
+ *
+ * This is lock-free, so it is suitable for latency critical threads that
+ * leave the actual work to a background thread calling
+ * `nref_reclaim_shared()`.
+ */
+void nref_reclaim_handoff(void);
+
+/**
+ * @brief Destroy all structures that were handed off by other threads.
+ *
+ * This is meant to be called periodically by a background thread.
+ *
+ * @returns The number of structures that were destroyed
+ */
+usize nref_reclaim_shared(void);
+
 /**
  * @brief Return the current reference count of a structure embedding `NREF_FIELD`.
- * You usually shouldn't need this though.
+ * You usually shouldn't need this though.  The value is meaningless if the
+ * structure is immortal, see `nref_is_immortal()`, and only approximate if
+ * the count is biased and other threads hold references at the same time.
  *
  * @param ptr The `struct *` embedding `NREF_FIELD`
  * @returns The structure's current refcount value as a `const int`
  */
-#define nref_count(ptr) ((const int)(ptr)->__neo_nref._count)
+#define nref_count(ptr) ((const int)_neo_nref_count(&(ptr)->__neo_nref))
 
 /** @} */
 
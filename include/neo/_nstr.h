@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "neo/_nref.h"
 #include "neo/_types.h"
 #include "neo/_toolchain.h"
 
@@ -20,6 +21,28 @@ struct _neo_nstr_init_info {
 	const char *data;
 };
 
+/*
+ * Count the Unicode code points in a string literal at compile time by
+ * counting all bytes that aren't UTF-8 continuation bytes.  This is an
+ * integer constant expression for literals of up to 256 bytes, the
+ * conditional index only exists to keep the compiler quiet about literals
+ * shorter than that.
+ */
+#define __NEO_U8_LEAD(s, i)							\
+	((i) + 1 < sizeof(s) && ((s)[(i) + 1 < sizeof(s) ? (i) : 0] & 0xc0) != 0x80)
+#define __NEO_U8_LEN_4(s, i)							\
+	(__NEO_U8_LEAD(s, i) + __NEO_U8_LEAD(s, (i) + 1) +			\
+	 __NEO_U8_LEAD(s, (i) + 2) + __NEO_U8_LEAD(s, (i) + 3))
+#define __NEO_U8_LEN_16(s, i)							\
+	(__NEO_U8_LEN_4(s, i) + __NEO_U8_LEN_4(s, (i) + 4) +			\
+	 __NEO_U8_LEN_4(s, (i) + 8) + __NEO_U8_LEN_4(s, (i) + 12))
+#define __NEO_U8_LEN_64(s, i)							\
+	(__NEO_U8_LEN_16(s, i) + __NEO_U8_LEN_16(s, (i) + 16) +		\
+	 __NEO_U8_LEN_16(s, (i) + 32) + __NEO_U8_LEN_16(s, (i) + 48))
+#define __NEO_U8_LEN_256(s)							\
+	(__NEO_U8_LEN_64(s, 0) + __NEO_U8_LEN_64(s, 64) +			\
+	 __NEO_U8_LEN_64(s, 128) + __NEO_U8_LEN_64(s, 192))
+
 /**
  * @defgroup nstr Strings
  *
@@ -33,6 +56,8 @@ struct _neo_nstr_init_info {
  * when passing the string to `printf` and friends, because it will bypass the
  * refcounting protection.  If you absolutely need to store it in a structure
  * with dynamic lifetime, it is advisable to combine it with `borrow`.
+ * Strings created by `nstr_slice()` might not be NUL terminated, see
+ * `nstr_is_terminated()` and `nstr_terminate()`.
  *
  * @param nstr `nstr_t *` to get the raw string of
  * @returns A `const char *` pointing to the raw C string
@@ -57,7 +82,9 @@ struct _neo_nstr_init_info {
 /**
  * @brief Statically declare and define a neo string (file scope only).
  *
- * The string will be initialized before `main` is called.
+ * The string will be initialized before `main` is called.  It is immortal,
+ * meaning `nget` and `nput` don't change its reference count and it is never
+ * deallocated.  Consider `NSTR_STATIC` for short string literals.
  *
  * @param name Name of the `nstr_t *` variable to be declared
  * @param content A `const char *` with the contents of the string
@@ -66,6 +93,47 @@ struct _neo_nstr_init_info {
 	nstr_t *name = nil;		\
 	NSTR_INIT(name, content)
 
+/**
+ * @brief Maximum size in bytes of a string literal passed to `NSTR_STATIC`,
+ * not including the NUL terminator.
+ */
+#define NSTR_STATIC_MAX 256
+
+/**
+ * @brief Define a neo string from a string literal at compile time
+ * (file scope only).
+ *
+ * Unlike `NSTR_DEFINE`, this doesn't need any initialization before `main`:
+ * the string's header and contents are constant data, and its length is
+ * computed by the compiler.  The string is immortal, meaning `nget` and
+ * `nput` don't change its reference count and it is never deallocated.
+ *
+ * `content` must be a string literal of at most `NSTR_STATIC_MAX` bytes,
+ * longer literals fail to compile.  It must also be valid UTF-8, which
+ * is *not* checked.  Use `NSTR_DEFINE` for anything else.
+ *
+ * @param name Name of the `nstr_t *` variable to be declared
+ * @param content A string literal with the contents of the string
+ */
+#define NSTR_STATIC(name, content)						\
+	static const struct {							\
+		nstr_t nstr;							\
+		char data[sizeof(content) <= NSTR_STATIC_MAX + 1		\
+			  ? (int)sizeof(content) + 3 : -1];			\
+	} __neo_nstr_static_##name = {						\
+		{								\
+			{ __NEO_U8_LEN_256(content) },				\
+			{ nil, __neo_atomic_init(_NEO_NREF_IMMORTAL),		\
+			  0, { nil } },						\
+			sizeof(content) + 3,					\
+			nil,							\
+			__neo_nstr_static_##name.data,				\
+			nil,							\
+		},								\
+		"" content,							\
+	};									\
+	nstr_t *name = (nstr_t *)&__neo_nstr_static_##name.nstr
+
 /**
  * @brief Copy a regular C string to a neo string.
  *
@@ -142,6 +210,52 @@ nstr_t *u2nstr(u64 u, int radix, error *err);
  */
 nstr_t *nstrdup(nstr_t *s, error *err);
 
+/**
+ * @brief Get a part of a string without copying it.
+ *
+ * The slice is a view into the original string's memory, and holds a
+ * reference to it.  Unless the slice extends to the end of the original
+ * string, its data is not followed by a NUL terminator, which means that
+ * `nstr_raw()` can't be used as a regular C string.  All other string
+ * functions work with slices just like they do with regular strings.
+ * If `s` is `nil`, the range is out of bounds, or allocation fails,
+ * an error is yeeted.
+ *
+ * @param s String to slice
+ * @param start Index of the first character to include
+ * @param len Number of characters to include
+ * @param err Error pointer
+ * @returns The slice, unless an error occurred
+ */
+nstr_t *nstr_slice(nstr_t *s, usize start, usize len, error *err);
+
+/**
+ * @brief Check whether a string's data is followed by a NUL terminator.
+ *
+ * This is true for all strings except slices that don't extend to the end of
+ * the string they were taken from.  Neo strings can't contain NUL characters,
+ * so if the byte right after the data is NUL, it must be the terminator of
+ * the original string (which is always padded with four of them).
+ *
+ * @param s `nstr_t *` to check
+ * @returns Whether `nstr_raw(s)` can be used as a regular C string
+ */
+#define nstr_is_terminated(s) ( (bool)((s)->_data[_neo_nstr_size(s)] == '\0') )
+
+/**
+ * @brief Get a NUL terminated version of a string.
+ *
+ * If `s` is already terminated, this just returns a new reference to it.
+ * Otherwise, the string is copied.
+ * If `s` is `nil` or allocation fails, an error is yeeted.
+ *
+ * @param s String to get a terminated version of
+ * @param err Error pointer
+ * @returns A string with the same content as `s` for which `nstr_is_terminated()`
+ *	is true, unless an error occurred
+ */
+nstr_t *nstr_terminate(nstr_t *s, error *err);
+
 /**
  * @brief Repeat a string `n` times and return the new string.
  *
@@ -171,7 +285,7 @@ nstr_t *nstrmul_put(nstr_t *s, usize n, error *err);
  * @brief Create a string considting of `n` repetitions of `c`.
  *
  * If `c` is not within unicode space or allocation fails, an error is yeeted.
- * If `n` is 0, an empty string is returned.
+ * If `n` is 0 or `c` is NUL, an empty string is returned.
  *
  * @param c Character to fill the string with
  * @param n How many characters to put into the string
@@ -237,8 +351,8 @@ int nstrcmp(const nstr_t *s1, const nstr_t *s2, error *err);
  *
  * Prepend fill characters to a string to make it a specific length, and return
  * a new string with the result.  The original string is unmodified.
- * If the string is already longer than the desired width or allocation fails,
- * an error is yeeted.
+ * If the string is already longer than the desired width, `fill` is NUL,
+ * or allocation fails, an error is yeeted.
  *
  * @param s String to expand
  * @param length Desired length of the new string
@@ -269,17 +383,50 @@ nstr_t *leftpad_put(nstr_t *s, usize length, nchar fill, error *err);
  *	error occurred
  */
 #define nstr_foreach(cursor, nstr, err)						\
-	for (const char *__next =						\
-	         (nstr)->_data + utf8_to_nchr(cursor, (nstr)->_data, err);	\
+	for (const char *__next = (nstr)->_data,				\
+			*__end = __next + _neo_nstr_size(nstr);			\
+	     __next < __end							\
+	     && (__next += utf8_to_nchr(cursor, __next, err), true)		\
 	     /* errput sets the error number to 0xffffffff, thus number + 1 */	\
-	     *__next != '\0' && (err) != nil && (err)->_number + 1 < 2;		\
-	     __next += utf8_to_nchr(cursor, __next, err))
+	     && ((err) == nil || ((const error *)(err))->_number + 1 < 2);	\
+	     )
 
 /** @} */
 
 /** Internal callback for nref */
 void _neo_nstr_destroy(nstr_t *s);
 
+/** Internal callback for nref, for strings allocated with `npool_alloc()` */
+void _neo_nstr_destroy_borrowed(nstr_t *s);
+
+/**
+ * Internal helper for constructing strings in place.  Allocates a string
+ * with room for `size_without_nul` bytes of inline data, which the caller has
+ * to fill with exactly `len` valid UTF-8 characters.  The NUL terminator is
+ * already written.
+ * @private
+ */
+nstr_t *_neo_nstr_alloc(usize size_without_nul, usize len, error *err);
+
+/**
+ * Get a pointer to the character at `index`, which may also be `nlen(s)` for
+ * the end of the string.  This uses the same index as `nchrat()`, so it only
+ * takes linear time for short strings.
+ * @private
+ */
+const char *_neo_nstr_char_ptr(const nstr_t *s, usize index);
+
+/** Size of a string's data in bytes, excluding the NUL terminator. @private */
+#define _neo_nstr_size(s) ((s)->_size - 4)
+
+/**
+ * Whether a string consists of ASCII characters only.  Every other character
+ * takes up more than one byte, so this is the case iff the length in
+ * characters is equal to the size in bytes.
+ * @private
+ */
+#define _neo_nstr_is_ascii(s) ( (bool)(nlen(s) == _neo_nstr_size(s)) )
+
 /*
  * This file is part of libneo.
  * Copyright (c) 2021 Fefie <owo@fef.moe>.
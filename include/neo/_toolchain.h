@@ -10,6 +10,8 @@
 	__attribute__(( __malloc__, __malloc__(deallocator, argindex) ))
 #endif
 
+#define __neo_weak __attribute__(( __weak__ ))
+
 #define __neo_section(name) __attribute__(( __section__(#name) ))
 
 #define __neo_init(fn) \
@@ -45,15 +45,31 @@ typedef double		f64;
 
 /** @} */
 
+/*
+ * C11 atomics and C++11 atomics are not the same thing, but gcc and clang
+ * implement both of them in the same way for lock-free types.  We assert that
+ * in the C++ branch below (and in src/nref.c for C), so C++ code accessing
+ * atomic fields does so with the same semantics as the library itself.
+ * Static initializers must wrap their value in __neo_atomic_init() because
+ * std::atomic can't be copy-initialized before C++17.
+ */
 #ifdef __cplusplus
-	/* TODO: This is probably not a good idea */
-#	define __neo_atomic_type volatile int
+extern "C++" {
+#	include <atomic>
+}
+#	define __neo_atomic_type std::atomic<int>
+#	define __neo_atomic_init(val) { val }
+static_assert(sizeof(std::atomic<int>) == sizeof(int) &&
+	      alignof(std::atomic<int>) == alignof(int) &&
+	      ATOMIC_INT_LOCK_FREE == 2,
+	      "std::atomic<int> must be lock-free and have the layout of _Atomic int");
 #else
 #	include <stdbool.h>
 #	ifdef __STDC_NO_ATOMICS__
 #		error "Atomic types are not implemented"
 #	else
 #		define __neo_atomic_type _Atomic int
+#		define __neo_atomic_init(val) (val)
 #	endif
 #endif
 
@@ -71,12 +87,33 @@ typedef double		f64;
 		volatile const usize __neo_nlen;	\
 	}
 
+/**
+ * State for the optional features of reference counters, which is only
+ * allocated when `nref_init_biased()` or `nweak()` is called.  This keeps
+ * `struct _neo_nref` (and therefore every refcounted structure) small.
+ * @private
+ */
+struct _neo_nref_ext {
+	/** identifies the owning thread, or 0 if the count isn't biased */
+	usize _owner;
+	/** references held by the owning thread, see `nref_init_biased()` */
+	int _local;
+	/** control block for weak references, created by the first `nweak()` */
+	struct _neo_nweak *_weak;
+};
+
 /** @private */
 struct _neo_nref {
 	void (*_destroy)(void *);
-	/** byte offset into the struct this is embedded in */
-	usize _offset;
 	__neo_atomic_type _count;
+	/** byte offset into the struct this is embedded in */
+	u32 _offset;
+	union {
+		/** optional state, `nil` unless biased or weakly referenced */
+		struct _neo_nref_ext *_ext;
+		/** next entry in the reclamation queue, see `nref_defer_release()` */
+		struct _neo_nref *_next_deferred;
+	};
 };
 /**
  * @brief A basic reference counter for data structures.
@@ -98,6 +135,21 @@ typedef struct _neo_nref nref_t;
  */
 #define NREF_FIELD nref_t __neo_nref
 
+/** @private */
+struct _neo_nweak {
+	NREF_FIELD;
+	/** the referenced object, or nil if it has been destroyed */
+	nref_t *_target;
+	/** protects `_target` against being destroyed while upgrading */
+	bool _lock;
+};
+/**
+ * @brief A weak reference to a structure embedding `NREF_FIELD`.
+ *
+ * @ingroup nref
+ */
+typedef struct _neo_nweak nweak_t;
+
 /** @private */
 struct _neo_nbuf {
 	NREF_FIELD;
@@ -108,6 +160,12 @@ struct _neo_nbuf {
 	 */
 	nref_t *_borrow;
 	const byte *_data;
+	/**
+	 * Memoized result of `nbuf_hash()`, or 0 if it hasn't been computed
+	 * yet.  Only accessed through atomic builtins because buffers may be
+	 * shared between threads.
+	 */
+	u64 _hash;
 };
 /**
  * @brief An immutable, refcounted buffer.
@@ -129,6 +187,12 @@ struct _neo_nstr {
 	 */
 	nref_t *_borrow;
 	const char *_data;
+	/**
+	 * Byte offsets of every 64th character, built on demand by `nchrat()`
+	 * for long non-ASCII strings.  Only accessed through atomic builtins
+	 * because strings may be shared between threads.
+	 */
+	const usize *_index;
 };
 /**
  * @brief An immutable, refcounted UTF-8 string.
@@ -137,9 +201,27 @@ struct _neo_nstr {
  */
 typedef struct _neo_nstr nstr_t;
 
+/**
+ * Maximum number of arguments to `yeet()` that are captured by value for
+ * formatting the message later.  Anything with more is formatted right away.
+ * @private
+ */
+#define _NEO_ERROR_MAX_ARGS 4
+
+/** @private */
+union _neo_error_arg {
+	long long _ll;
+	double _d;
+	void *_p;
+};
+
 /** @private */
 struct _neo_error {
+	/** formatted message, or nil if `errmsg()` hasn't been called yet */
 	nstr_t *_message;
+	/** format string for `_message` (see `yeet()`), or nil if there is none */
+	const char *_fmt;
+	union _neo_error_arg _args[_NEO_ERROR_MAX_ARGS];
 	u32 _number;
 };
 /**
@@ -0,0 +1,198 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <pthread.h>
+
+#include "neo/_error.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+
+/** @private */
+#define _NEO_CHASHTAB_LOCKS		64
+/** @private */
+#define _NEO_CHASHTAB_READER_STRIPES	64
+
+/** @private */
+struct _neo_chashtab_entry {
+	struct _neo_chashtab_entry *next;
+	u64 hash;
+	nbuf_t *key;
+	/** the table's reference to the value */
+	nref_t *val;
+	/**
+	 * link in the retire list, separate from `next` because readers
+	 * might still be following that one after the entry was removed
+	 */
+	struct _neo_chashtab_entry *retired_next;
+};
+
+/**
+ * Number of readers currently inside the table, for each of the two epochs
+ * that can be active at the same time.  Every thread uses one of these
+ * stripes, and each of them is padded to its own cache line so that readers
+ * on different CPUs don't contend for the same one.
+ * @private
+ */
+struct _neo_chashtab_readers {
+	long count[2];
+	char _pad[64 - 2 * sizeof(long)];
+};
+
+/**
+ * All fields that are accessed concurrently are only ever touched through
+ * the `__atomic` builtins, see `src/chashtab.c` for the details.
+ * @private
+ */
+struct _neo_chashtab {
+	NLEN_FIELD(_len);
+	NREF_FIELD;
+	/** random per-table seed that is mixed with `nbuf_hash()` */
+	u64 _seed;
+	struct _neo_chashtab_entry **_buckets;
+	/** always a power of two */
+	u32 _buckets_len;
+	/** writers lock the mutex at index `bucket % _NEO_CHASHTAB_LOCKS` */
+	pthread_mutex_t _locks[_NEO_CHASHTAB_LOCKS];
+	u64 _epoch;
+	struct _neo_chashtab_readers _readers[_NEO_CHASHTAB_READER_STRIPES];
+	/** protects the retire list and serializes epoch changes */
+	pthread_mutex_t _reclaim_lock;
+	/** entries that have been removed but might still be seen by readers */
+	struct _neo_chashtab_entry *_retired;
+	u32 _retired_len;
+};
+
+/**
+ * @defgroup chashtab Concurrent Hashtable API
+ *
+ * A hash table that can be shared between any number of threads without
+ * external locking.  Lookups never block.  They write to a per-thread reader
+ * counter and to the reference counter of the value they return, so lookups
+ * of different keys scale with the number of CPUs, while lookups of the same
+ * key still contend for that value's reference counter.
+ * Writers lock one of several mutexes depending on the bucket they modify,
+ * so writes to different buckets can proceed in parallel as well.
+ *
+ * Values stored in the table must be refcounted (i.e. embed `NREF_FIELD`).
+ * The table holds a reference to every value, and `chashtab_get()` returns
+ * another one to the caller.  Values that are removed are only released after
+ * all lookups that might still be looking at them have finished (this is
+ * known as epoch based reclamation), so a value returned by `chashtab_get()`
+ * stays valid until the caller `nput()`s it, no matter what other threads do
+ * to the table in the meantime.  Removed entries are collected and released
+ * in batches, so a table with few deletions can hold on to removed values
+ * for a long time unless `chashtab_reclaim()` is called.
+ *
+ * Unlike `hashtab_t`, the number of buckets is fixed at creation time,
+ * so it should be chosen to be at least the expected number of entries.
+ *
+ * @{
+ */
+
+/** @brief The concurrent hash table type. */
+typedef struct _neo_chashtab chashtab_t;
+
+/**
+ * @brief Create a new concurrent hash table.
+ *
+ * Keys are hashed using `nbuf_hash()` mixed with a random per-table seed.
+ * The number of buckets is rounded up to the next power of two.
+ * If allocation fails, `buckets` is 0, or `buckets` is larger than 2^31,
+ * an error is yeeted.
+ *
+ * @param buckets Number of hash buckets
+ * @param err Error pointer
+ * @returns The initialized hash table, unless an error occurred
+ */
+chashtab_t *chashtab_create(u32 buckets, error *err);
+
+/**
+ * @brief Get an entry from a concurrent hash table.
+ *
+ * This never blocks.  If the key exists, the reference counter of the value is
+ * incremented before it is returned, so the caller must `nput()` it after use.
+ * If the key does not exist, *no* error is yeeted and the return value is `nil`.
+ * If `table` or `key` is `nil`, an error is yeeted.
+ *
+ * @param table Hash table to get the entry from
+ * @param key Key to get the value of
+ * @param err Error pointer
+ * @returns A new reference to the value or `nil` if it does not exist,
+ *	unless an error occurred
+ */
+void *chashtab_get(chashtab_t *table, const nbuf_t *key, error *err);
+
+/** @private */
+void _neo_chashtab_put(chashtab_t *table, nbuf_t *key, nref_t *val, error *err);
+
+/**
+ * @brief Put an entry into a concurrent hash table.
+ *
+ * The reference counters of both `key` and `val` are incremented.
+ * If `table`, `key`, or `val` is `nil`, the key already exists in the table,
+ * or allocation fails, an error is yeeted.
+ *
+ * @param table Hash table to insert the value at
+ * @param key Key to insert the value under
+ * @param val Value to insert, must be a `struct *` embedding `NREF_FIELD`
+ * @param err Error pointer
+ */
+#define chashtab_put(table, key, val, err) ({					\
+	nref_t *__val_nref = (val) == nil ? nil : &(val)->__neo_nref;		\
+	_neo_chashtab_put(table, key, __val_nref, err);				\
+})
+
+/**
+ * @brief Delete an entry from a concurrent hash table.
+ *
+ * The table's reference to the value is released once no other thread can
+ * be looking at it anymore.  That happens after enough entries have been
+ * deleted or on the next call to `chashtab_reclaim()`, whichever comes first.
+ * The caller gets a new reference to the removed value, which it must
+ * `nput()` after use.  If the key does not exist, *no* error is yeeted and
+ * the return value is `nil`.
+ * If `table` or `key` is `nil`, an error is yeeted.
+ *
+ * @param table Table to delete an entry from
+ * @param key Key of the item to delete
+ * @param err Error pointer
+ * @returns A new reference to the removed value, or `nil` if the key was not
+ *	found, unless an error occurred
+ */
+void *chashtab_del(chashtab_t *table, const nbuf_t *key, error *err);
+
+/**
+ * @brief Release all entries that were deleted from a concurrent hash table.
+ *
+ * This waits for all lookups that are currently in progress to finish, and
+ * then releases the table's references to all values (and keys) that were
+ * deleted before this call.  It must not be called from a destroy callback
+ * of a value stored in the same table.  Does nothing if `table` is `nil`.
+ *
+ * @param table Table to release deleted entries of
+ */
+void chashtab_reclaim(chashtab_t *table);
+
+/** @} */
+
+#ifdef __cplusplus
+}; /* extern "C" */
+#endif
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
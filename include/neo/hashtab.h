@@ -10,21 +10,75 @@ extern "C" {
 #include "neo/_stddef.h"
 #include "neo/_types.h"
 #include "neo/list.h"
+#include "neo/nhash.h"
 
 /** @private */
 struct _neo_hashtab_entry {
 	listnode_t link;
+	/** full hash of `key`, compared before the key itself */
+	u64 hash;
 	nbuf_t *key;
 	void *val;
 };
 
+/** @private */
+struct _neo_hashtab_slot {
+	/** full hash of `key`, compared before the key itself */
+	u64 hash;
+	nbuf_t *key;
+	void *val;
+};
+
+/**
+ * Storage for tables using the flat engine.  The control byte array holds one
+ * byte per slot which is either `EMPTY`, `DELETED`, or the 7 most significant
+ * bits of the key's hash.  Slots are grouped in chunks of 16 so a whole group
+ * of control bytes can be scanned with a single SIMD comparison.
+ * See `src/hashtab_flat.c` for details.
+ * @private
+ */
+struct _neo_hashtab_flat {
+	u8 *ctrl;
+	struct _neo_hashtab_slot *slots;
+	/** number of slots, always a power of two and at least 16 */
+	u32 capacity;
+	/** number of slots that can still be filled before we must rehash */
+	u32 growth_left;
+};
+
+/** @private */
+struct _neo_hashtab_chained {
+	list_t *buckets; /* -> _neo_hashtab_entry::link */
+	u32 buckets_len;
+};
+
 /** @private */
 struct _neo_hashtab {
 	NLEN_FIELD(_len);
 	NREF_FIELD;
+	/** custom hash function, or `nil` for the builtin ones */
 	u32 (*_hashfn)(const nbuf_t *key, u32 limit);
-	u32 _buckets_len;
-	list_t _buckets[0]; /* -> _neo_hashtab_entry::link */
+	/**
+	 * random per-table secret for the builtin hash functions;
+	 * the default one only uses `k0`
+	 */
+	struct nhash_key _seed;
+	u32 _flags;
+	/** the table never shrinks below its initial size */
+	u32 _min_size;
+	/**
+	 * While the table is being resized, index 1 holds the old storage
+	 * whose entries are moved over to the new one at index 0 a few buckets
+	 * at a time by every call to `hashtab_get`, `hashtab_put`, and
+	 * `hashtab_del`.  `_rehash_pos` is the next bucket (or group of 16
+	 * slots for flat tables) to migrate.
+	 */
+	bool _rehashing;
+	u32 _rehash_pos;
+	union {
+		struct _neo_hashtab_chained _chained[2];
+		struct _neo_hashtab_flat _flat[2];
+	};
 };
 
 /**
@@ -36,14 +90,61 @@ struct _neo_hashtab {
 /** @brief The hash table type. */
 typedef struct _neo_hashtab hashtab_t;
 
+/**
+ * @brief Use the chained engine (the default).
+ *
+ * Every entry is allocated individually and linked into a list per bucket.
+ * Insertion and deletion are cheap, but every lookup has to chase a pointer
+ * for each entry in the bucket.
+ */
+#define HASHTAB_CHAINED		0
+/**
+ * @brief Use the flat engine.
+ *
+ * Entries are stored inline in a single open addressing array, and a separate
+ * array of control bytes holding a fragment of each key's hash is scanned 16
+ * slots at a time using SSE2 or NEON where available.  Keys are only compared
+ * if their hash fragments match.  This is usually the better choice for tables
+ * with many lookups.
+ */
+#define HASHTAB_FLAT		(1u << 0)
+/**
+ * @brief Shrink the table when entries are deleted.
+ *
+ * All tables grow automatically when their load factor gets too high.
+ * If this flag is set, they also shrink (but never below the size passed to
+ * `hashtab_create_flags()`) if the load factor drops below 1/8 after an entry
+ * was deleted.
+ */
+#define HASHTAB_SHRINK		(1u << 1)
+/**
+ * @brief Hash keys with SipHash instead of the default hash function.
+ *
+ * The default hash function (`nhash()`) is very fast, but it is not designed
+ * to withstand an attacker who can observe the table's behavior and
+ * deliberately chooses colliding keys.  It also hashes every key only once
+ * per process (see `nbuf_hash()`), and only mixes that with a random seed
+ * for every table.  So the per-table seed changes which keys share a bucket,
+ * but two keys whose 64-bit `nbuf_hash()` values collide collide in every
+ * table.
+ * Set this flag if the keys come from an untrusted source, in which case
+ * `nsiphash()` is used with a random key.  This is not compatible with custom
+ * hash functions.
+ */
+#define HASHTAB_SIPHASH		(1u << 2)
+
 /**
  * @brief Create a new hash table.
  *
- * The hashing function used is implementation defined; use
- * `hashtab_create_custom` to specify your own.
+ * The hashing function used is implementation defined (currently `nhash()`
+ * with a random seed for every table); use `hashtab_create_custom` to specify
+ * your own.  The default hash function is based on `nbuf_hash()`, so the hash
+ * of a key is only computed once even if the same `nbuf_t *` is used for many
+ * lookups in many different tables.  Chained tables always round the number of
+ * buckets up to the next power of two.
  * If allocation fails or `buckets` is 0, an error is yeeted.
  *
- * @param buckets Number of hash buckets
+ * @param buckets Initial number of hash buckets
  * @param err Error pointer
  * @returns The initialized hash table, unless an error occurred
  */
@@ -53,10 +154,11 @@ hashtab_t *hashtab_create(u32 buckets, error *err);
  * @brief Create a new hash table with custom hashing algorithm.
  *
  * If allocation fails, `buckets` is 0, or `hashfn` is nil, an error is yeeted.
- * The custom hash function must return a value less than the `limit` parameter
- * passed to it.  The `limit` parameter is the number of buckets minus one.
+ * The custom hash function must return a value less than or equal to the
+ * `limit` parameter passed to it, which is currently always `0xffffffff`
+ * because the table grows over time and maps hashes to buckets on its own.
  *
- * @param buckets Number of hash buckets
+ * @param buckets Initial number of hash buckets
  * @param hashfn Custom hash function to use
  * @param err Error pointer
  * @returns The initialized hash table, unless an error occurred
@@ -65,12 +167,34 @@ hashtab_t *hashtab_create_custom(u32 buckets,
 				 u32 (*hashfn)(const nbuf_t *key, u32 limit),
 				 error *err);
 
+/**
+ * @brief Create a new hash table using a specific engine.
+ *
+ * This is the most flexible way of creating a hash table; `hashtab_create()`
+ * and `hashtab_create_custom()` are just shorthands for this function with
+ * `flags` set to `HASHTAB_CHAINED`.  If `hashfn` is `nil`, the default hashing
+ * function is used.  For flat tables, `buckets` is the number of entries the
+ * table should be able to hold initially.
+ * If allocation fails, `buckets` is 0, `flags` contains unknown bits,
+ * or `HASHTAB_SIPHASH` is set and `hashfn` is not `nil`, an error is yeeted.
+ *
+ * @param buckets Initial number of hash buckets, or initial capacity for
+ *	flat tables
+ * @param flags Engine selection (`HASHTAB_CHAINED` or `HASHTAB_FLAT`),
+ *	optionally combined with `HASHTAB_SHRINK` and `HASHTAB_SIPHASH`
+ * @param hashfn Custom hash function to use, or `nil` for the default one
+ * @param err Error pointer
+ * @returns The initialized hash table, unless an error occurred
+ */
+hashtab_t *hashtab_create_flags(u32 buckets, u32 flags,
+				u32 (*hashfn)(const nbuf_t *key, u32 limit),
+				error *err);
+
 /**
  * @brief Get an entry in a hash table.
  *
  * If the key does not exist, *no* error is yeeted and the return value is `nil`.
- * If the key is `nil` or the hash function returned a value greater than the
- * maxval parameter passed to it, an error is yeeted.
+ * If `table` or `key` is `nil`, an error is yeeted.
  *
  * @param table Hash table to get the entry from
  * @param key Key to get the value of
@@ -82,10 +206,10 @@ void *hashtab_get(hashtab_t *table, const nbuf_t *key, error *err);
 /**
  * @brief Put an entry into a hash table.
  *
- * The reference counter in `key` is incremented.
- * If `key` is `nil`, `key_size` is 0, the key already exists in the table,
- * or the hash function returned a value greater than or equal to the `limit`
- * parameter passed to it, an error is yeeted.
+ * The reference counter in `key` is incremented.  If this makes the load
+ * factor exceed its maximum, the table starts to grow.
+ * If `table` or `key` is `nil`, the key already exists in the table,
+ * or allocation fails, an error is yeeted.
  *
  * @param table Hash table to insert the value at
  * @param key Key to insert the value under
@@ -124,6 +248,32 @@ int hashtab_foreach(hashtab_t *table,
 		    int (*callback)(hashtab_t *table, nbuf_t *key, void *val, void *extra),
 		    void *extra, error *err);
 
+/**
+ * @brief Get the current load factor of a hash table.
+ *
+ * For chained tables, this is the average number of entries per bucket.
+ * For flat tables, it is the fraction of slots that are occupied.
+ * If `table` is `nil`, the return value is 0.
+ *
+ * @param table Hash table to get the load factor of
+ * @returns The load factor
+ */
+f32 hashtab_load_factor(const hashtab_t *table);
+
+/**
+ * @brief Get the progress of an ongoing resize operation.
+ *
+ * Resizing is done incrementally, so that no single operation has to move all
+ * entries at once.  If `table` is `nil` or not currently being resized, the
+ * return value is 1.
+ *
+ * @param table Hash table to get the resize progress of
+ * @returns The fraction (between 0 and 1) of the old buckets, or slot groups
+ *	for `HASHTAB_FLAT` tables, that have already been migrated to the
+ *	resized storage.  This is not necessarily the fraction of entries.
+ */
+f32 hashtab_rehash_progress(const hashtab_t *table);
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,162 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "neo/_error.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+
+struct _neo_narena_chunk;
+
+/** @private */
+struct _neo_narena {
+	NREF_FIELD;
+	u32 _flags;
+	/** default size of new chunks, including the chunk header */
+	usize _chunk_size;
+	/** free space in the current chunk */
+	u8 *_pos;
+	u8 *_end;
+	/** all chunks, most recently allocated one first */
+	struct _neo_narena_chunk *_chunks;
+};
+
+/**
+ * @defgroup narena Arenas
+ *
+ * An arena is a memory region that objects are allocated from by simply
+ * incrementing a pointer, and which is released as a whole rather than one
+ * object at a time.  This is useful for lots of small objects that all have
+ * the same lifetime, like the ones created while handling a single request:
+ * Allocating them is nearly free, and so is releasing them because the cost
+ * depends only on the number of chunks the arena consists of.
+ *
+ * Strings and buffers can be created within an arena using the `_in` variants
+ * of their constructors.  They are refcounted just like regular ones, but their
+ * memory is only released along with the entire arena.  It is up to you to
+ * make sure no references to any of them are left by then.
+ *
+ * @{
+ */
+
+/** @brief The arena type. */
+typedef struct _neo_narena narena_t;
+
+/**
+ * @brief Allocate chunks with `mmap()` rather than `nalloc()`.
+ *
+ * This keeps large arenas from fragmenting the heap, and guarantees their
+ * memory is actually returned to the operating system when they are released.
+ * Chunk sizes are rounded up to the page size.
+ */
+#define NARENA_MMAP (1u << 0)
+
+/**
+ * @brief Create a new arena.
+ *
+ * Memory is requested from the system in chunks of `chunk_size` bytes (or,
+ * for single allocations that wouldn't fit into one, exactly as much as they
+ * need).  The first chunk is allocated right away.  The arena is refcounted,
+ * and releases all of its memory when the count reaches zero.
+ * If allocation fails or `flags` contains unknown bits, an error is yeeted.
+ *
+ * @param chunk_size Size of every chunk in bytes, or 0 for a sensible default
+ * @param flags Either 0 or `NARENA_MMAP`
+ * @param err Error pointer
+ * @returns The new arena, unless an error occurred
+ */
+narena_t *narena_create(usize chunk_size, u32 flags, error *err);
+
+/**
+ * @brief Allocate memory from an arena.
+ *
+ * The returned memory is aligned to 16 bytes and *not* initialized.
+ * There is no way to release it individually, see `narena_reset()`.
+ * If `arena` is `nil`, `size` is 0, or allocation fails, an error is yeeted.
+ *
+ * @param arena Arena to allocate from
+ * @param size Number of bytes to allocate
+ * @param err Error pointer
+ * @returns The allocated memory, unless an error occurred
+ */
+void *narena_alloc(narena_t *arena, usize size, error *err);
+
+/**
+ * @brief Release everything that was allocated from an arena at once.
+ *
+ * All chunks except for the most recently allocated one are returned to the
+ * system, and the remaining one is reused for subsequent allocations.  Any
+ * objects that were allocated from the arena become invalid.
+ * If `arena` is `nil`, this does nothing.
+ *
+ * @param arena Arena to reset
+ */
+void narena_reset(narena_t *arena);
+
+/**
+ * @brief Copy a regular C string to a neo string within an arena.
+ *
+ * This works just like `nstr()`, except that the string is allocated from
+ * `arena`, and its memory is not released when its refcount reaches zero.
+ * If `arena` or `s` is `nil`, `s` is not valid UTF-8, or allocation fails,
+ * an error is yeeted.
+ *
+ * @param arena Arena to allocate the string from
+ * @param s String to convert
+ * @param err Error pointer
+ * @returns The converted string, unless an error occurred
+ */
+nstr_t *nstr_in(narena_t *arena, const char *restrict s, error *err);
+
+/**
+ * @brief Create a new buffer of fixed size within an arena.
+ *
+ * This works just like `nbuf_create()`, except that the buffer is allocated
+ * from `arena`, and its memory is not released when its refcount reaches zero.
+ * If `arena` is `nil`, `size` is 0, or allocation fails, an error is yeeted.
+ *
+ * @param arena Arena to allocate the buffer from
+ * @param size Size in bytes
+ * @param err Error pointer
+ * @returns The buffer, unless an error occurred
+ */
+nbuf_t *nbuf_create_in(narena_t *arena, usize size, error *err);
+
+/**
+ * @brief Create a new buffer within an arena and copy `data` into it.
+ *
+ * This works just like `nbuf_from()`, except that the buffer is allocated
+ * from `arena`, and its memory is not released when its refcount reaches zero.
+ * If `arena` or `data` is `nil`, `size` is 0, or allocation fails,
+ * an error is yeeted.
+ *
+ * @param arena Arena to allocate the buffer from
+ * @param data Raw data to fill the buffer with
+ * @param size How many bytes are read from `data`, and the buffer size
+ * @param err Error pointer
+ * @returns The buffer, unless an error occurred
+ */
+nbuf_t *nbuf_from_in(narena_t *arena, const void *restrict data, usize size, error *err);
+
+/** @} */
+
+#ifdef __cplusplus
+}; /* extern "C" */
+#endif
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,102 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "neo/_types.h"
+
+/**
+ * @defgroup nhash Hashing
+ *
+ * Two general purpose hash functions are provided:  `nhash()` is a very fast
+ * non-cryptographic hash function based on wyhash, suitable for anything
+ * that doesn't process untrusted keys.  `nsiphash()` is an implementation of
+ * SipHash-2-4, which is considerably slower but keyed with a secret, and
+ * therefore resistant to hash flooding attacks.
+ *
+ * @{
+ */
+
+/**
+ * @brief Key for `nsiphash()`.
+ *
+ * Use `nhash_random_key()` to obtain a random one.
+ */
+struct nhash_key {
+	u64 k0;
+	u64 k1;
+};
+
+/**
+ * @brief Compute a fast 64-bit hash of arbitrary data.
+ *
+ * The algorithm is a variant of wyhash, which processes 16 bytes per step
+ * (48 for inputs longer than that) and has excellent distribution.  It is
+ * *not* cryptographically secure.  The result is only stable within the same
+ * version of libneo, so don't store it anywhere.
+ *
+ * @param data Data to hash, may be `nil` if `size` is 0
+ * @param size Number of bytes in `data`
+ * @param seed Arbitrary seed value; different seeds yield different hashes
+ * @returns The hash
+ */
+u64 nhash(const void *restrict data, usize size, u64 seed);
+
+/**
+ * @brief Compute the SipHash-2-4 of arbitrary data.
+ *
+ * As long as the key is kept secret, it is practically impossible for an
+ * attacker to construct input that yields colliding hashes.  Use this for
+ * hash tables with untrusted keys.
+ *
+ * @param data Data to hash, may be `nil` if `size` is 0
+ * @param size Number of bytes in `data`
+ * @param key Secret key
+ * @returns The hash
+ */
+u64 nsiphash(const void *restrict data, usize size, const struct nhash_key *key);
+
+/**
+ * @brief Get a random seed for `nhash()`.
+ *
+ * Seeds are derived from a secret that is initialized from the system's
+ * entropy source on startup, and differ on every call.  This never fails.
+ *
+ * @returns A random seed
+ */
+u64 nhash_random_seed(void);
+
+/**
+ * @brief Get a random key for `nsiphash()`.
+ *
+ * Keys are generated from a secret that is initialized from the system's
+ * entropy source on startup, and differ on every call.  Unlike seeds from
+ * `nhash_random_seed()`, they are cryptographically independent: knowing
+ * any number of seeds or keys doesn't help predicting others.
+ * This never fails.
+ *
+ * @returns A random key
+ */
+struct nhash_key nhash_random_key(void);
+
+/** @} */
+
+#ifdef __cplusplus
+}; /* extern "C" */
+#endif
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
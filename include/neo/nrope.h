@@ -0,0 +1,218 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "neo/_error.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+
+/** @private */
+struct _neo_nrope {
+	NREF_FIELD;
+	/** number of Unicode characters */
+	NLEN_FIELD(_len);
+	/** number of bytes */
+	usize _size;
+	/** 0 for leaves, 1 + the height of the higher child for everything else */
+	unsigned int _height;
+	/* leaves are a window into a string they hold a reference to */
+	nstr_t *_str;
+	const char *_data;
+	/* all other nodes are the concatenation of two children */
+	struct _neo_nrope *_left;
+	struct _neo_nrope *_right;
+};
+
+/**
+ * @private
+ * Ropes are always balanced, so this is enough for more leaves than
+ * could possibly fit into memory.
+ */
+#define _NEO_NROPE_MAX_HEIGHT 64
+
+/** @private */
+struct _neo_nrope_iter {
+	const struct _neo_nrope *_stack[_NEO_NROPE_MAX_HEIGHT];
+	unsigned int _depth;
+	const char *_pos;
+	const char *_end;
+};
+
+/**
+ * @defgroup nrope Ropes
+ *
+ * A rope is an immutable string that is stored as a balanced binary tree of
+ * smaller strings.  This makes concatenating, inserting and slicing cheap even
+ * for huge texts, at the cost of slightly slower access to single characters.
+ * The leaves borrow the strings the rope was made from rather than copying
+ * them, and subtrees are shared between ropes, so all operations return new
+ * ropes without touching the original ones.
+ *
+ * Ropes are refcounted, and all functions returning one return a new
+ * reference that must be released with `nput()`.
+ *
+ * @{
+ */
+
+/** @brief The rope type. */
+typedef struct _neo_nrope nrope_t;
+
+/** @brief Iterator over the characters in a rope, see `nrope_iter()`. */
+typedef struct _neo_nrope_iter nrope_iter_t;
+
+/**
+ * @brief Create a rope from a string.
+ *
+ * The string is not copied, the rope just holds references to it.
+ * If `s` is `nil` or allocation fails, an error is yeeted.
+ *
+ * @param s String to create the rope from
+ * @param err Error pointer
+ * @returns The new rope, unless an error occurred
+ */
+nrope_t *nrope_from_nstr(nstr_t *s, error *err);
+
+/**
+ * @brief Concatenate two ropes.
+ *
+ * This takes O(log n) time, and the result is balanced again.
+ * If any of the two ropes are `nil` or allocation fails, an error is yeeted.
+ *
+ * @param r1 First rope
+ * @param r2 Second rope
+ * @param err Error pointer
+ * @returns A rope with the contents of `r1` followed by `r2`,
+ *	unless an error occurred
+ */
+nrope_t *nrope_cat(nrope_t *r1, nrope_t *r2, error *err);
+
+/**
+ * @brief Get a part of a rope.
+ *
+ * If `rope` is `nil`, the range is out of bounds, or allocation fails,
+ * an error is yeeted.
+ *
+ * @param rope Rope to slice
+ * @param start Index of the first character to include
+ * @param len Number of characters to include
+ * @param err Error pointer
+ * @returns The slice, unless an error occurred
+ */
+nrope_t *nrope_slice(nrope_t *rope, usize start, usize len, error *err);
+
+/**
+ * @brief Insert a rope into another one.
+ *
+ * If any of the two ropes are `nil`, `index` is out of bounds, or allocation
+ * fails, an error is yeeted.
+ *
+ * @param rope Rope to insert into
+ * @param index Character index to insert at, may be equal to the length
+ * @param other Rope to insert
+ * @param err Error pointer
+ * @returns The new rope, unless an error occurred
+ */
+nrope_t *nrope_insert(nrope_t *rope, usize index, nrope_t *other, error *err);
+
+/**
+ * @brief Get the character at the specified index.
+ *
+ * This takes O(log n) time.
+ * If `rope` is `nil` or `index` is out of bounds, an error is yeeted.
+ *
+ * @param rope Rope to get the character from
+ * @param index Character index
+ * @param err Error pointer
+ * @returns The character, unless an error occurred
+ */
+nchar nrope_chrat(const nrope_t *rope, usize index, error *err);
+
+/**
+ * @brief Get the byte at the specified offset of the UTF-8 representation.
+ *
+ * This takes O(log n) time.
+ * If `rope` is `nil` or `offset` is out of bounds, an error is yeeted.
+ *
+ * @param rope Rope to get the byte from
+ * @param offset Byte offset
+ * @param err Error pointer
+ * @returns The byte, unless an error occurred
+ */
+u8 nrope_byteat(const nrope_t *rope, usize offset, error *err);
+
+/**
+ * @brief Get the size of a rope's UTF-8 representation in bytes.
+ *
+ * @param rope Rope to get the size of
+ */
+#define nrope_size(rope) ((usize)(rope)->_size)
+
+/**
+ * @brief Copy the entire contents of a rope to a regular string.
+ *
+ * If `rope` is `nil` or allocation fails, an error is yeeted.
+ *
+ * @param rope Rope to flatten
+ * @param err Error pointer
+ * @returns The string, unless an error occurred
+ */
+nstr_t *nrope_flatten(const nrope_t *rope, error *err);
+
+/**
+ * @brief Create an iterator over the characters in a rope.
+ *
+ * The iterator does not hold a reference to the rope, so the rope must not be
+ * released while the iterator is in use.
+ *
+ * @param rope Rope to iterate over
+ * @returns The iterator
+ */
+nrope_iter_t nrope_iter(const nrope_t *rope);
+
+/**
+ * @brief Advance a rope iterator.
+ *
+ * @param iter Iterator returned by `nrope_iter()`
+ * @param c Where to store the next character
+ * @param err Error pointer
+ * @returns `true` if a character was stored in `c`, `false` if the end of the
+ *	rope was reached or an error occurred
+ */
+bool nrope_iter_next(nrope_iter_t *iter, nchar *c, error *err);
+
+/**
+ * @brief Iterate over each character in a rope.
+ *
+ * Characters are decoded with `utf8_to_nchr()`, just like in `nstr_foreach()`.
+ *
+ * @param cursor `nchar *` to store the current character in
+ * @param rope `nrope_t *` to iterate over
+ * @param err Error pointer; the loop will terminate early if an error occurred
+ */
+#define nrope_foreach(cursor, rope, err)					\
+	for (nrope_iter_t __iter = nrope_iter(rope);				\
+	     nrope_iter_next(&__iter, cursor, err);				\
+	     )
+
+/** @} */
+
+#ifdef __cplusplus
+}; /* extern "C" */
+#endif
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
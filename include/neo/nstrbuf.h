@@ -0,0 +1,161 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "neo/_error.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+
+/** @private */
+struct _neo_nstrbuf {
+	/** number of Unicode characters appended so far */
+	NLEN_FIELD(_len);
+	/**
+	 * The string under construction.  Its header is only filled in by
+	 * `nstrbuf_finish()`, until then this is just a block of memory that
+	 * has room for the header, `_capacity` bytes of data and 4 NULs.
+	 */
+	nstr_t *_str;
+	/** number of bytes appended so far */
+	usize _size;
+	usize _capacity;
+};
+
+/**
+ * @defgroup nstrbuf String Builders
+ *
+ * Strings are immutable, so building one out of many pieces with `nstrcat()`
+ * copies the whole string over and over again.  A string builder is a growable
+ * buffer that pieces can be appended to in amortized constant time per byte.
+ * When you're done, `nstrbuf_finish()` turns the buffer itself into the final
+ * string without copying it again.
+ *
+ * @{
+ */
+
+/** @brief The string builder type. */
+typedef struct _neo_nstrbuf nstrbuf_t;
+
+/**
+ * @brief Initialize a string builder.
+ *
+ * The builder must eventually be released with either `nstrbuf_finish()` or
+ * `nstrbuf_destroy()`.
+ * If `buf` is `nil` or allocation fails, an error is yeeted.
+ *
+ * @param buf Builder to initialize
+ * @param capacity Number of bytes to reserve up front, or 0 for a default
+ * @param err Error pointer
+ */
+void nstrbuf_init(nstrbuf_t *buf, usize capacity, error *err);
+
+/**
+ * @brief Release a string builder without creating a string.
+ *
+ * This is a no-op for builders that have already been finished.
+ *
+ * @param buf Builder to release
+ */
+void nstrbuf_destroy(nstrbuf_t *buf);
+
+/**
+ * @brief Convert a string builder to a string.
+ *
+ * The returned string takes over the builder's memory, so its contents are
+ * not copied again (unless the allocator backend decides to move them while
+ * trimming excess capacity).  The builder is left empty, and must be
+ * initialized again before it can be reused.
+ * If `buf` is `nil`, an error is yeeted.
+ *
+ * @param buf Builder to finish
+ * @param err Error pointer
+ * @returns The built string, unless an error occurred
+ */
+nstr_t *nstrbuf_finish(nstrbuf_t *buf, error *err);
+
+/**
+ * @brief Append a neo string.
+ *
+ * If either argument is `nil` or allocation fails, an error is yeeted and the
+ * builder is left unmodified.
+ *
+ * @param buf Builder to append to
+ * @param s String to append
+ * @param err Error pointer
+ */
+void nstrbuf_append(nstrbuf_t *buf, const nstr_t *s, error *err);
+
+/**
+ * @brief Append a regular C string.
+ *
+ * If either argument is `nil`, `s` is not valid UTF-8, or allocation fails,
+ * an error is yeeted and the builder is left unmodified.
+ *
+ * @param buf Builder to append to
+ * @param s String to append
+ * @param err Error pointer
+ */
+void nstrbuf_append_cstr(nstrbuf_t *buf, const char *restrict s, error *err);
+
+/**
+ * @brief Append a single Unicode character.
+ *
+ * If `buf` is `nil`, `c` is NUL or not within Unicode space, or allocation
+ * fails, an error is yeeted and the builder is left unmodified.
+ *
+ * @param buf Builder to append to
+ * @param c Character to append
+ * @param err Error pointer
+ */
+void nstrbuf_append_chr(nstrbuf_t *buf, nchar c, error *err);
+
+/**
+ * @brief Append the string representation of an unsigned integer.
+ *
+ * This works like `u2nstr()`, but doesn't create a temporary string.
+ * If `buf` is `nil`, `radix` is not within the range 2 to 36, or allocation
+ * fails, an error is yeeted and the builder is left unmodified.
+ *
+ * @param buf Builder to append to
+ * @param u Number to append
+ * @param radix Numerical base
+ * @param err Error pointer
+ */
+void nstrbuf_append_u(nstrbuf_t *buf, u64 u, int radix, error *err);
+
+/**
+ * @brief Append the string representation of a signed integer.
+ *
+ * This works like `i2nstr()`, but doesn't create a temporary string.
+ * If `buf` is `nil`, `radix` is not within the range 2 to 36, or allocation
+ * fails, an error is yeeted and the builder is left unmodified.
+ *
+ * @param buf Builder to append to
+ * @param i Number to append
+ * @param radix Numerical base
+ * @param err Error pointer
+ */
+void nstrbuf_append_i(nstrbuf_t *buf, i64 i, int radix, error *err);
+
+/** @} */
+
+#ifdef __cplusplus
+}; /* extern "C" */
+#endif
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
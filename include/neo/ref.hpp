@@ -0,0 +1,219 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+/**
+ * @file
+ * @brief RAII wrappers for refcounted structures in C++ code.
+ */
+
+#ifndef __cplusplus
+#error "neo/ref.hpp is only for C++, use nget() and nput() in C"
+#endif
+
+#include <cstddef>
+#include <utility>
+
+#include "neo.h"
+
+namespace neo {
+
+/**
+ * @brief Tag for constructing a `neo::ref` that takes over a reference the
+ * caller already owns, like the one returned by `nstr()`.
+ *
+ * @ingroup nref
+ */
+struct adopt_t {};
+
+/**
+ * @brief Tag for constructing a `neo::ref` that acquires a new reference.
+ *
+ * @ingroup nref
+ */
+struct retain_t {};
+
+/**
+ * @brief Owning pointer to a structure embedding `NREF_FIELD`.
+ *
+ * This owns exactly one reference, which is released with `nput()` when the
+ * `ref` is destroyed.  Copying calls `nget()`, but moving just transfers the
+ * reference, so passing refs around by value or returning them from functions
+ * doesn't touch the reference counter at all.  Functions that only look at a
+ * structure should take a `const neo::ref<T> &` or a plain `T *` instead.
+ *
+ * @ingroup nref
+ */
+template<typename T>
+class ref {
+public:
+	constexpr ref() noexcept : ptr(nullptr) {}
+	constexpr ref(std::nullptr_t) noexcept : ptr(nullptr) {}
+
+	/** @brief Take over a reference that the caller owns. */
+	ref(T *p, adopt_t) noexcept : ptr(p) {}
+
+	/** @brief Acquire a new reference, leaving the caller's one untouched. */
+	ref(T *p, retain_t) noexcept : ptr(p)
+	{
+		acquire();
+	}
+
+	ref(const ref &other) noexcept : ptr(other.ptr)
+	{
+		acquire();
+	}
+
+	ref(ref &&other) noexcept : ptr(other.ptr)
+	{
+		other.ptr = nullptr;
+	}
+
+	~ref()
+	{
+		reset();
+	}
+
+	ref &operator=(const ref &other) noexcept
+	{
+		ref(other).swap(*this);
+		return *this;
+	}
+
+	ref &operator=(ref &&other) noexcept
+	{
+		ref(std::move(other)).swap(*this);
+		return *this;
+	}
+
+	ref &operator=(std::nullptr_t) noexcept
+	{
+		reset();
+		return *this;
+	}
+
+	void swap(ref &other) noexcept
+	{
+		std::swap(ptr, other.ptr);
+	}
+
+	/** @brief Release the owned reference, if any, and become empty. */
+	void reset() noexcept
+	{
+		T *p = ptr;
+		ptr = nullptr;
+		if (p != nullptr)
+			_neo_nput(nref_of(p));
+	}
+
+	/**
+	 * @brief Give up ownership of the reference without releasing it.
+	 *
+	 * Use this to pass the reference on to C code that consumes it.
+	 *
+	 * @returns The pointer, which the caller now owns a reference to
+	 */
+	T *release() noexcept
+	{
+		T *p = ptr;
+		ptr = nullptr;
+		return p;
+	}
+
+	/** @brief Get the raw pointer without affecting the reference count. */
+	T *get() const noexcept
+	{
+		return ptr;
+	}
+
+	T &operator*() const noexcept
+	{
+		return *ptr;
+	}
+
+	T *operator->() const noexcept
+	{
+		return ptr;
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return ptr != nullptr;
+	}
+
+private:
+	T *ptr;
+
+	static nref_t *nref_of(T *p) noexcept
+	{
+		/* references to const structures may still be counted */
+		return const_cast<nref_t *>(&p->__neo_nref);
+	}
+
+	void acquire() noexcept
+	{
+		if (ptr != nullptr)
+			_neo_nget(nref_of(ptr));
+	}
+};
+
+/**
+ * @brief Wrap a reference the caller owns, like the one returned by `nstr()`.
+ *
+ * @ingroup nref
+ */
+template<typename T>
+inline ref<T> adopt(T *p) noexcept
+{
+	return ref<T>(p, adopt_t());
+}
+
+/**
+ * @brief Acquire a new reference and wrap it.
+ *
+ * @ingroup nref
+ */
+template<typename T>
+inline ref<T> retain(T *p) noexcept
+{
+	return ref<T>(p, retain_t());
+}
+
+template<typename T, typename U>
+inline bool operator==(const ref<T> &a, const ref<U> &b) noexcept
+{
+	return a.get() == b.get();
+}
+
+template<typename T, typename U>
+inline bool operator!=(const ref<T> &a, const ref<U> &b) noexcept
+{
+	return a.get() != b.get();
+}
+
+template<typename T>
+inline bool operator==(const ref<T> &a, std::nullptr_t) noexcept
+{
+	return a.get() == nullptr;
+}
+
+template<typename T>
+inline bool operator!=(const ref<T> &a, std::nullptr_t) noexcept
+{
+	return a.get() != nullptr;
+}
+
+} /* namespace neo */
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
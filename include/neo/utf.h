@@ -9,6 +9,15 @@ extern "C" {
 #include "neo/_toolchain.h"
 #include "neo/_types.h"
 
+/** @private */
+struct _neo_utf8_stream {
+	/** number of bytes consumed before `_pending` */
+	usize _offset;
+	/** start of a sequence that was cut off at the end of the last chunk */
+	u8 _pending[4];
+	u8 _pending_size;
+};
+
 /**
  * @defgroup utf Raw UTF Handling
  *
@@ -39,7 +48,8 @@ usize utf8_check(const char *restrict s, error *err);
 
 /**
  * @brief Check whether a NUL terminated string is valid UTF-8.
- * At most `maxsize + 3` bytes are read (this function uses `utf8_to_nchr()` internally).
+ * At most `maxsize` bytes are read, so a sequence that is cut off by `maxsize`
+ * is treated as malformed.
  *
  * If a NUL terminator is encountered before `maxsize` bytes, reading stops
  * before the specified size.  If the string contains any malformed code
@@ -111,6 +121,256 @@ usize utf8_from_nchr(char *restrict dest, nchar c, error *err);
  */
 usize utf8_to_nchr(nchar *c, const char *restrict utf8chr, error *err);
 
+/**
+ * @brief Byte order of UTF-16 and UTF-32 data.
+ */
+enum utf_byteorder {
+	/** Least significant byte first */
+	UTF_LE,
+	/** Most significant byte first */
+	UTF_BE,
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	/** Byte order of the host, for arrays of `u16` or `u32` */
+	UTF_NATIVE = UTF_BE,
+#else
+	/** Byte order of the host, for arrays of `u16` or `u32` */
+	UTF_NATIVE = UTF_LE,
+#endif
+};
+
+/**
+ * @brief Convert UTF-8 to UTF-16.
+ *
+ * All of the bulk conversion functions below work the same way: `src_size`
+ * bytes from `src` are converted and written to `dest`, which has room for
+ * `dest_size` bytes.  If `dest` is `nil`, nothing is written and the return
+ * value is the size that `dest` would need to hold the entire result.  Unlike
+ * with the other functions in this module, no bytes outside of `src` are read
+ * and the input may contain NUL characters, which are converted like any
+ * other character.
+ *
+ * If the input is malformed or `dest` is too small, an error is yeeted and
+ * conversion stops before the offending character.  In any case, if `errpos`
+ * is not `nil`, the byte offset within `src` where conversion stopped is
+ * stored there (which is `src_size` if no error occurred).
+ *
+ * @param dest Where to store the UTF-16 data, may be `nil`
+ * @param dest_size Size of `dest` in bytes
+ * @param src UTF-8 data to convert
+ * @param src_size Size of `src` in bytes
+ * @param order Byte order of the UTF-16 data
+ * @param errpos Where to store the offset within `src` where conversion
+ *	stopped, may be `nil`
+ * @param err Error pointer
+ * @returns The number of bytes written to `dest` (or that would have been
+ *	written if `dest` is `nil`), including if an error occurred
+ */
+usize utf8_to_utf16(void *restrict dest, usize dest_size,
+		    const char *restrict src, usize src_size,
+		    enum utf_byteorder order, usize *errpos, error *err);
+
+/**
+ * @brief Convert UTF-16 to UTF-8.
+ *
+ * Unpaired surrogates are an error.
+ * See `utf8_to_utf16()` for how the parameters and errors work.
+ *
+ * @param dest Where to store the UTF-8 data (*not* NUL terminated), may be `nil`
+ * @param dest_size Size of `dest` in bytes
+ * @param src UTF-16 data to convert
+ * @param src_size Size of `src` in bytes, must be a multiple of 2
+ * @param order Byte order of the UTF-16 data
+ * @param errpos Where to store the offset within `src` where conversion
+ *	stopped, may be `nil`
+ * @param err Error pointer
+ * @returns The number of bytes written to `dest`
+ */
+usize utf16_to_utf8(char *restrict dest, usize dest_size,
+		    const void *restrict src, usize src_size,
+		    enum utf_byteorder order, usize *errpos, error *err);
+
+/**
+ * @brief Convert UTF-8 to UTF-32.
+ *
+ * See `utf8_to_utf16()` for how the parameters and errors work.
+ *
+ * @param dest Where to store the UTF-32 data, may be `nil`
+ * @param dest_size Size of `dest` in bytes
+ * @param src UTF-8 data to convert
+ * @param src_size Size of `src` in bytes
+ * @param order Byte order of the UTF-32 data
+ * @param errpos Where to store the offset within `src` where conversion
+ *	stopped, may be `nil`
+ * @param err Error pointer
+ * @returns The number of bytes written to `dest`
+ */
+usize utf8_to_utf32(void *restrict dest, usize dest_size,
+		    const char *restrict src, usize src_size,
+		    enum utf_byteorder order, usize *errpos, error *err);
+
+/**
+ * @brief Convert UTF-32 to UTF-8.
+ *
+ * Surrogates and values above `0x0010ffff` are an error.
+ * See `utf8_to_utf16()` for how the parameters and errors work.
+ *
+ * @param dest Where to store the UTF-8 data (*not* NUL terminated), may be `nil`
+ * @param dest_size Size of `dest` in bytes
+ * @param src UTF-32 data to convert
+ * @param src_size Size of `src` in bytes, must be a multiple of 4
+ * @param order Byte order of the UTF-32 data
+ * @param errpos Where to store the offset within `src` where conversion
+ *	stopped, may be `nil`
+ * @param err Error pointer
+ * @returns The number of bytes written to `dest`
+ */
+usize utf32_to_utf8(char *restrict dest, usize dest_size,
+		    const void *restrict src, usize src_size,
+		    enum utf_byteorder order, usize *errpos, error *err);
+
+/**
+ * @brief Convert a string to a buffer with UTF-16 data.
+ *
+ * If `s` is `nil` or empty (buffers can't be empty), or allocation fails,
+ * an error is yeeted.
+ *
+ * @param s String to convert
+ * @param order Byte order of the UTF-16 data
+ * @param err Error pointer
+ * @returns The buffer, unless an error occurred
+ */
+nbuf_t *nstr_to_utf16(const nstr_t *s, enum utf_byteorder order, error *err);
+
+/**
+ * @brief Convert a string to a buffer with UTF-32 data.
+ *
+ * If `s` is `nil` or empty (buffers can't be empty), or allocation fails,
+ * an error is yeeted.
+ *
+ * @param s String to convert
+ * @param order Byte order of the UTF-32 data
+ * @param err Error pointer
+ * @returns The buffer, unless an error occurred
+ */
+nbuf_t *nstr_to_utf32(const nstr_t *s, enum utf_byteorder order, error *err);
+
+/**
+ * @brief Create a string from UTF-16 data.
+ *
+ * If `src` is `nil` or malformed, contains NUL characters, or allocation
+ * fails, an error is yeeted.
+ *
+ * @param src UTF-16 data to convert
+ * @param src_size Size of `src` in bytes, must be a multiple of 2
+ * @param order Byte order of the UTF-16 data
+ * @param errpos Where to store the offset within `src` of the first
+ *	malformed character, may be `nil`
+ * @param err Error pointer
+ * @returns The string, unless an error occurred
+ */
+nstr_t *utf16_to_nstr(const void *src, usize src_size, enum utf_byteorder order,
+		      usize *errpos, error *err);
+
+/**
+ * @brief Create a string from UTF-32 data.
+ *
+ * If `src` is `nil` or malformed, contains NUL characters, or allocation
+ * fails, an error is yeeted.
+ *
+ * @param src UTF-32 data to convert
+ * @param src_size Size of `src` in bytes, must be a multiple of 4
+ * @param order Byte order of the UTF-32 data
+ * @param errpos Where to store the offset within `src` of the first
+ *	malformed character, may be `nil`
+ * @param err Error pointer
+ * @returns The string, unless an error occurred
+ */
+nstr_t *utf32_to_nstr(const void *src, usize src_size, enum utf_byteorder order,
+		      usize *errpos, error *err);
+
+/**
+ * @brief State of a streaming UTF-8 decoder, see `utf8_stream_init()`.
+ */
+typedef struct _neo_utf8_stream utf8_stream_t;
+
+/**
+ * @brief Initialize a streaming UTF-8 decoder.
+ *
+ * Stream decoders validate or decode UTF-8 data that arrives in chunks of
+ * arbitrary size, for example from a network socket.  Characters may be
+ * split across chunks; the decoder remembers the incomplete part and resumes
+ * with the next chunk.  Unlike the other functions in this module, the stream
+ * functions never read beyond the end of a chunk, and NUL characters are
+ * treated like any other character.
+ *
+ * The state does not hold any resources, so there is no function to destroy
+ * it.  After an error was yeeted, it must be initialized again before reuse.
+ *
+ * @param stream Decoder state to initialize
+ */
+void utf8_stream_init(utf8_stream_t *stream);
+
+/**
+ * @brief Validate the next chunk of UTF-8 data.
+ *
+ * If the chunk ends in the middle of a character, its last few bytes are
+ * stored in the decoder and checked together with the next chunk, so the
+ * returned prefix of `chunk` ends on a character boundary.  The characters in
+ * it are complete and valid, including the ones that started in the previous
+ * chunk.  If `stream` is `nil`, `chunk` is `nil` but `size` is not 0, or the
+ * data is malformed, an error is yeeted and `utf8_stream_offset()` is the
+ * offset of the malformed character within the entire stream.
+ *
+ * @param stream Decoder state
+ * @param chunk Next chunk of data
+ * @param size Size of `chunk` in bytes
+ * @param err Error pointer
+ * @returns The number of bytes at the beginning of `chunk` that end on a
+ *	character boundary, unless an error occurred
+ */
+usize utf8_stream_feed(utf8_stream_t *stream, const char *chunk, usize size, error *err);
+
+/**
+ * @brief Decode the next character from a chunk of UTF-8 data.
+ *
+ * Call this repeatedly with the same chunk to decode one character at a time.
+ * `pos` is the current position within the chunk, which should be 0 for every
+ * new chunk and is advanced past the returned character.  When the chunk is
+ * exhausted, any incomplete character at the end is stored in the decoder and
+ * finished with the next chunk.  If the data is malformed, an error is yeeted.
+ *
+ * @param stream Decoder state
+ * @param chunk Current chunk of data
+ * @param size Size of `chunk` in bytes
+ * @param pos Current position within `chunk`
+ * @param c Where to store the decoded character
+ * @param err Error pointer
+ * @returns `true` if a character was stored in `c`, `false` if more data is
+ *	needed or an error occurred
+ */
+bool utf8_stream_next(utf8_stream_t *stream, const char *chunk, usize size, usize *pos,
+		      nchar *c, error *err);
+
+/**
+ * @brief Signal the end of a stream.
+ *
+ * If the last chunk ended in the middle of a character, an error is yeeted.
+ *
+ * @param stream Decoder state
+ * @param err Error pointer
+ */
+void utf8_stream_finish(utf8_stream_t *stream, error *err);
+
+/**
+ * @brief Get the number of bytes processed by a stream decoder.
+ *
+ * This only includes complete characters.  After an error, this is the offset
+ * of the malformed character.
+ *
+ * @param stream `utf8_stream_t *` to get the offset of
+ */
+#define utf8_stream_offset(stream) ((usize)(stream)->_offset)
+
 /** @} */
 
 #ifdef __cplusplus
@@ -0,0 +1,405 @@
+/** See the end of this file for copyright and license terms. */
+
+/*
+ * Readers traverse the bucket chains without taking any locks, which works
+ * because writers only ever modify a chain with a single atomic pointer store
+ * (inserting at the head, or unlinking an entry by pointing its predecessor
+ * to its successor).  A reader that is currently looking at an entry while
+ * it is being unlinked still sees a consistent chain, as the removed entry's
+ * own next pointer is left intact.  The only problem is knowing when it is
+ * safe to actually free the entry and release the table's reference to its
+ * value, and that is what the epoch stuff is for.
+ *
+ * The table has a global epoch counter, and two reader counters (one for
+ * even and one for odd epochs) in each of several stripes.  A reader
+ * increments the counter for the current epoch in its own stripe before
+ * touching any entries, and decrements the same counter when it is done.
+ * Removed entries are put on a retire list.  Once that list is long enough,
+ * the writer increments the epoch and waits for the counters of the previous
+ * epoch in all stripes to drop to zero.  After that, no reader can possibly
+ * hold a pointer to any of the retired entries anymore, because all readers
+ * that entered before they were unlinked have left, and newer ones can't
+ * find them.  This is essentially a very simple variant of RCU.
+ *
+ * Because the counters are striped, readers on different CPUs (usually)
+ * write to different cache lines, and lookups scale almost linearly.
+ */
+
+/* sched_yield */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "neo/_error.h"
+#include "neo/_hashtab.h"
+#include "neo/_nalloc.h"
+#include "neo/_nbuf.h"
+#include "neo/_nref.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+#include "neo/chashtab.h"
+#include "neo/nhash.h"
+
+/** Number of removed entries to collect before waiting for readers */
+#define CHASHTAB_RECLAIM_BATCH 64
+
+static inline u64 chashtab_hash(const chashtab_t *table, const nbuf_t *key)
+{
+	return _neo_hashtab_fmix64(nbuf_hash(key, nil) ^ table->_seed);
+}
+
+static inline struct _neo_chashtab_entry **chashtab_bucket(chashtab_t *table, u64 hash)
+{
+	return &table->_buckets[hash & (table->_buckets_len - 1)];
+}
+
+static inline pthread_mutex_t *chashtab_lock(chashtab_t *table, u64 hash)
+{
+	return &table->_locks[hash & (table->_buckets_len - 1) & (_NEO_CHASHTAB_LOCKS - 1)];
+}
+
+static inline void *chashtab_container(nref_t *ref)
+{
+	return (u8 *)ref - ref->_offset;
+}
+
+/*
+ * Threads are assigned to reader stripes in a round robin fashion on their
+ * first lookup.  This is stored as the stripe index plus one, so that the
+ * default value of 0 means unassigned.
+ */
+static _Thread_local u32 reader_stripe;
+static u32 reader_stripe_next;
+
+static inline struct _neo_chashtab_readers *reader_get_stripe(chashtab_t *table)
+{
+	u32 stripe = reader_stripe;
+	if (stripe == 0) {
+		stripe = __atomic_fetch_add(&reader_stripe_next, 1, __ATOMIC_RELAXED);
+		stripe = stripe % _NEO_CHASHTAB_READER_STRIPES + 1;
+		reader_stripe = stripe;
+	}
+	return &table->_readers[stripe - 1];
+}
+
+/** Enter a read side critical section and return the epoch for `reader_leave()`. */
+static u64 reader_enter(struct _neo_chashtab_readers *readers, chashtab_t *table)
+{
+	for (;;) {
+		u64 epoch = __atomic_load_n(&table->_epoch, __ATOMIC_SEQ_CST);
+		__atomic_fetch_add(&readers->count[epoch & 1], 1, __ATOMIC_SEQ_CST);
+		/*
+		 * If the epoch changed in between, the writer might already be
+		 * past the point of checking our counter, so it's not safe to
+		 * continue with the old epoch.
+		 */
+		if (__atomic_load_n(&table->_epoch, __ATOMIC_SEQ_CST) == epoch)
+			return epoch;
+		__atomic_fetch_sub(&readers->count[epoch & 1], 1, __ATOMIC_RELEASE);
+	}
+}
+
+static inline void reader_leave(struct _neo_chashtab_readers *readers, u64 epoch)
+{
+	__atomic_fetch_sub(&readers->count[epoch & 1], 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Wait until all readers that might still be looking at previously removed
+ * entries have left.  The caller must hold the reclaim lock.
+ */
+static void chashtab_synchronize(chashtab_t *table)
+{
+	u64 epoch = __atomic_fetch_add(&table->_epoch, 1, __ATOMIC_SEQ_CST);
+
+	for (u32 i = 0; i < _NEO_CHASHTAB_READER_STRIPES; i++) {
+		long *count = &table->_readers[i].count[epoch & 1];
+		while (__atomic_load_n(count, __ATOMIC_ACQUIRE) != 0)
+			sched_yield();
+	}
+}
+
+static void entry_free(struct _neo_chashtab_entry *entry)
+{
+	nput(entry->key);
+	_neo_nput(entry->val);
+	npool_free(entry, sizeof(*entry));
+}
+
+/**
+ * Wait for readers and take the whole retire list.
+ * The caller must hold the reclaim lock.
+ */
+static struct _neo_chashtab_entry *retired_take(chashtab_t *table)
+{
+	if (table->_retired == nil)
+		return nil;
+
+	chashtab_synchronize(table);
+	struct _neo_chashtab_entry *reclaim = table->_retired;
+	table->_retired = nil;
+	table->_retired_len = 0;
+	return reclaim;
+}
+
+static void retired_free(struct _neo_chashtab_entry *reclaim)
+{
+	/* destroy callbacks might take a while, don't hold the lock for them */
+	while (reclaim != nil) {
+		struct _neo_chashtab_entry *next = reclaim->retired_next;
+		entry_free(reclaim);
+		reclaim = next;
+	}
+}
+
+static void chashtab_retire(chashtab_t *table, struct _neo_chashtab_entry *entry)
+{
+	struct _neo_chashtab_entry *reclaim = nil;
+
+	pthread_mutex_lock(&table->_reclaim_lock);
+	entry->retired_next = table->_retired;
+	table->_retired = entry;
+	if (++table->_retired_len >= CHASHTAB_RECLAIM_BATCH)
+		reclaim = retired_take(table);
+	pthread_mutex_unlock(&table->_reclaim_lock);
+
+	retired_free(reclaim);
+}
+
+static void chashtab_destroy(chashtab_t *table)
+{
+	/* there are no other users left if the refcount dropped to zero */
+	for (u32 i = 0; i < table->_buckets_len; i++) {
+		struct _neo_chashtab_entry *entry = table->_buckets[i];
+		while (entry != nil) {
+			struct _neo_chashtab_entry *next = entry->next;
+			entry_free(entry);
+			entry = next;
+		}
+	}
+
+	struct _neo_chashtab_entry *entry = table->_retired;
+	while (entry != nil) {
+		struct _neo_chashtab_entry *next = entry->retired_next;
+		entry_free(entry);
+		entry = next;
+	}
+
+	for (u32 i = 0; i < _NEO_CHASHTAB_LOCKS; i++)
+		pthread_mutex_destroy(&table->_locks[i]);
+	pthread_mutex_destroy(&table->_reclaim_lock);
+	nfree(table->_buckets);
+	nfree(table);
+}
+
+chashtab_t *chashtab_create(u32 buckets, error *err)
+{
+	if (buckets == 0) {
+		yeet(err, ERANGE, "Number of buckets is 0");
+		return nil;
+	}
+	if (buckets > 0x80000000) {
+		yeet(err, ERANGE, "Too many buckets");
+		return nil;
+	}
+
+	u32 buckets_len = 1;
+	while (buckets_len < buckets)
+		buckets_len <<= 1;
+
+	chashtab_t *table = nalloc(sizeof(*table), err);
+	catch(err) {
+		return nil;
+	}
+
+	table->_buckets = nalloc(sizeof(*table->_buckets) * buckets_len, err);
+	catch(err) {
+		nfree(table);
+		return nil;
+	}
+	for (u32 i = 0; i < buckets_len; i++)
+		table->_buckets[i] = nil;
+
+	table->_len = 0;
+	table->_seed = nhash_random_seed();
+	table->_buckets_len = buckets_len;
+	for (u32 i = 0; i < _NEO_CHASHTAB_LOCKS; i++)
+		pthread_mutex_init(&table->_locks[i], nil);
+	table->_epoch = 0;
+	for (u32 i = 0; i < _NEO_CHASHTAB_READER_STRIPES; i++) {
+		table->_readers[i].count[0] = 0;
+		table->_readers[i].count[1] = 0;
+	}
+	pthread_mutex_init(&table->_reclaim_lock, nil);
+	table->_retired = nil;
+	table->_retired_len = 0;
+
+	nref_init(table, chashtab_destroy);
+
+	neat(err);
+	return table;
+}
+
+static bool chashtab_check_args(chashtab_t *table, const nbuf_t *key, error *err)
+{
+	if (table == nil) {
+		yeet(err, EFAULT, "Hash table is nil");
+		return false;
+	}
+	if (key == nil) {
+		yeet(err, EFAULT, "Key is nil");
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Return the entry with `key` in the chain starting at `*link`, or `nil` if
+ * there is none.  `link` is updated to point to the link pointing to the
+ * returned entry.  Must be called either from within a read side critical
+ * section or with the bucket lock held.
+ */
+static struct _neo_chashtab_entry *chashtab_find(struct _neo_chashtab_entry ***link,
+						 const nbuf_t *key, u64 hash)
+{
+	struct _neo_chashtab_entry *entry;
+	/*
+	 * Each link must be loaded exactly once, because a concurrent writer
+	 * might change it to point to a different entry at any time.
+	 */
+	while ((entry = __atomic_load_n(*link, __ATOMIC_ACQUIRE)) != nil) {
+		if (entry->hash == hash && nbuf_eq(entry->key, key, nil))
+			break;
+		*link = &entry->next;
+	}
+
+	return entry;
+}
+
+void *chashtab_get(chashtab_t *table, const nbuf_t *key, error *err)
+{
+	if (!chashtab_check_args(table, key, err))
+		return nil;
+
+	u64 hash = chashtab_hash(table, key);
+	void *val = nil;
+
+	struct _neo_chashtab_readers *readers = reader_get_stripe(table);
+	u64 epoch = reader_enter(readers, table);
+
+	struct _neo_chashtab_entry **link = chashtab_bucket(table, hash);
+	struct _neo_chashtab_entry *entry = chashtab_find(&link, key, hash);
+	if (entry != nil) {
+		/* the table's reference keeps the value alive until we leave */
+		_neo_nget(entry->val);
+		val = chashtab_container(entry->val);
+	}
+
+	reader_leave(readers, epoch);
+
+	neat(err);
+	return val;
+}
+
+void _neo_chashtab_put(chashtab_t *table, nbuf_t *key, nref_t *val, error *err)
+{
+	if (!chashtab_check_args(table, key, err))
+		return;
+	if (val == nil) {
+		yeet(err, EFAULT, "Value is nil");
+		return;
+	}
+
+	u64 hash = chashtab_hash(table, key);
+
+	struct _neo_chashtab_entry *entry = npool_alloc(sizeof(*entry), err);
+	catch(err) {
+		return;
+	}
+	entry->hash = hash;
+	entry->key = key;
+	entry->val = val;
+
+	pthread_mutex_t *lock = chashtab_lock(table, hash);
+	pthread_mutex_lock(lock);
+
+	struct _neo_chashtab_entry **head = chashtab_bucket(table, hash);
+	struct _neo_chashtab_entry **link = head;
+	if (chashtab_find(&link, key, hash) != nil) {
+		pthread_mutex_unlock(lock);
+		npool_free(entry, sizeof(*entry));
+		yeet(err, EEXIST, "Key already present");
+		return;
+	}
+
+	nget(key);
+	_neo_nget(val);
+	entry->next = *head;
+	/* the release makes sure readers see the initialized entry */
+	__atomic_store_n(head, entry, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&table->_len, 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock(lock);
+
+	neat(err);
+}
+
+void *chashtab_del(chashtab_t *table, const nbuf_t *key, error *err)
+{
+	if (!chashtab_check_args(table, key, err))
+		return nil;
+
+	u64 hash = chashtab_hash(table, key);
+
+	pthread_mutex_t *lock = chashtab_lock(table, hash);
+	pthread_mutex_lock(lock);
+
+	struct _neo_chashtab_entry **link = chashtab_bucket(table, hash);
+	struct _neo_chashtab_entry *entry = chashtab_find(&link, key, hash);
+	if (entry == nil) {
+		pthread_mutex_unlock(lock);
+		neat(err);
+		return nil;
+	}
+
+	/* readers currently looking at the entry can still follow its next ptr */
+	__atomic_store_n(link, entry->next, __ATOMIC_RELEASE);
+	__atomic_fetch_sub(&table->_len, 1, __ATOMIC_RELAXED);
+	_neo_nget(entry->val);
+	void *val = chashtab_container(entry->val);
+
+	pthread_mutex_unlock(lock);
+
+	chashtab_retire(table, entry);
+
+	neat(err);
+	return val;
+}
+
+void chashtab_reclaim(chashtab_t *table)
+{
+	if (table == nil)
+		return;
+
+	pthread_mutex_lock(&table->_reclaim_lock);
+	struct _neo_chashtab_entry *reclaim = retired_take(table);
+	pthread_mutex_unlock(&table->_reclaim_lock);
+
+	retired_free(reclaim);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -1,9 +1,16 @@
 /** See the end of this file for copyright and license terms. */
 
+/* clock_gettime */
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "neo/_error.h"
@@ -12,41 +19,469 @@
 #include "neo/_nstr.h"
 #include "neo/_stddef.h"
 #include "neo/_types.h"
+#include "neo/buildconfig.h"
+
+/*
+ * Messages are formatted lazily, because most errors are caught and released
+ * without anybody ever looking at them.  yeet() only stores the format string
+ * and the arguments, which requires parsing the format string once to know
+ * the types of the arguments.  _neo_errmsg() walks the format string again
+ * and feeds every conversion specification to snprintf() along with its
+ * argument, cast back to the original type.
+ */
+
+enum arg_class {
+	ARG_NONE,		/* %% */
+	ARG_INT,
+	ARG_LONG,
+	ARG_LLONG,
+	ARG_SIZE,
+	ARG_INTMAX,
+	ARG_PTRDIFF,
+	ARG_DOUBLE,
+	ARG_PTR,
+	ARG_UNSUPPORTED,	/* %s, %n, '*' width or precision, ... */
+};
+
+/** longest conversion specification we can handle, including the % */
+#define SPEC_MAX 16
+
+/**
+ * Parse the conversion specification `*fmt` points to (just after the `%`)
+ * and advance `*fmt` to the character after it.
+ */
+static enum arg_class parse_spec(const char **fmt)
+{
+	const char *pos = *fmt;
+	enum arg_class class = ARG_INT;
+
+	while (*pos != '\0' && strchr("-+ #0", *pos) != nil)
+		pos++;
+	while ((*pos >= '0' && *pos <= '9') || *pos == '.')
+		pos++;
+
+	switch (*pos) {
+	case 'h':
+		pos += pos[1] == 'h' ? 2 : 1;
+		break;
+	case 'l':
+		if (pos[1] == 'l') {
+			class = ARG_LLONG;
+			pos += 2;
+		} else {
+			class = ARG_LONG;
+			pos++;
+		}
+		break;
+	case 'z':
+		class = ARG_SIZE;
+		pos++;
+		break;
+	case 'j':
+		class = ARG_INTMAX;
+		pos++;
+		break;
+	case 't':
+		class = ARG_PTRDIFF;
+		pos++;
+		break;
+	}
+
+	char conv = *pos;
+	if (conv != '\0')
+		pos++;
+	usize len = (usize)(pos - *fmt);
+	*fmt = pos;
+	/* this also applies to %%, format_args() copies every spec to a buffer */
+	if (len >= SPEC_MAX - 1)
+		return ARG_UNSUPPORTED;
+
+	switch (conv) {
+	case '%':
+		return ARG_NONE;
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		return class;
+	case 'c':
+		return class == ARG_INT ? ARG_INT : ARG_UNSUPPORTED;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		return class == ARG_INT ? ARG_DOUBLE : ARG_UNSUPPORTED;
+	case 'p':
+		return class == ARG_INT ? ARG_PTR : ARG_UNSUPPORTED;
+	default:
+		return ARG_UNSUPPORTED;
+	}
+}
+
+/**
+ * Capture the arguments for `fmt` into `args`.  Returns false if the format
+ * string contains anything we can't capture by value.
+ */
+static bool capture_args(union _neo_error_arg *args, const char *fmt, va_list vargs)
+{
+	usize count = 0;
+
+	while ((fmt = strchr(fmt, '%')) != nil) {
+		fmt++;
+		enum arg_class class = parse_spec(&fmt);
+		if (class == ARG_NONE)
+			continue;
+		if (class == ARG_UNSUPPORTED || count == _NEO_ERROR_MAX_ARGS)
+			return false;
+
+		union _neo_error_arg *arg = &args[count++];
+		switch (class) {
+		case ARG_INT:
+			arg->_ll = va_arg(vargs, int);
+			break;
+		case ARG_LONG:
+			arg->_ll = va_arg(vargs, long);
+			break;
+		case ARG_LLONG:
+			arg->_ll = va_arg(vargs, long long);
+			break;
+		case ARG_SIZE:
+			arg->_ll = (long long)va_arg(vargs, size_t);
+			break;
+		case ARG_INTMAX:
+			arg->_ll = (long long)va_arg(vargs, intmax_t);
+			break;
+		case ARG_PTRDIFF:
+			arg->_ll = va_arg(vargs, ptrdiff_t);
+			break;
+		case ARG_DOUBLE:
+			arg->_d = va_arg(vargs, double);
+			break;
+		case ARG_PTR:
+			arg->_p = va_arg(vargs, void *);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/** like snprintf(), but with arguments captured by capture_args() */
+static usize format_args(char *buf, usize size, const char *fmt,
+			 const union _neo_error_arg *args)
+{
+	usize len = 0;
+
+	while (*fmt != '\0') {
+		const char *percent = strchr(fmt, '%');
+		usize literal = percent != nil ? (usize)(percent - fmt) : strlen(fmt);
+		if (len < size)
+			memcpy(&buf[len], fmt, literal < size - len ? literal : size - len);
+		len += literal;
+		if (percent == nil)
+			break;
+
+		fmt = percent + 1;
+		enum arg_class class = parse_spec(&fmt);
+		char spec[SPEC_MAX];
+		memcpy(spec, percent, fmt - percent);
+		spec[fmt - percent] = '\0';
+
+		char *out = len < size ? &buf[len] : nil;
+		usize remaining = len < size ? size - len : 0;
+		int n = 0;
+		switch (class) {
+		case ARG_NONE:
+			n = snprintf(out, remaining, "%%");
+			break;
+		case ARG_INT:
+			n = snprintf(out, remaining, spec, (int)args->_ll);
+			break;
+		case ARG_LONG:
+			n = snprintf(out, remaining, spec, (long)args->_ll);
+			break;
+		case ARG_LLONG:
+			n = snprintf(out, remaining, spec, args->_ll);
+			break;
+		case ARG_SIZE:
+			n = snprintf(out, remaining, spec, (size_t)args->_ll);
+			break;
+		case ARG_INTMAX:
+			n = snprintf(out, remaining, spec, (intmax_t)args->_ll);
+			break;
+		case ARG_PTRDIFF:
+			n = snprintf(out, remaining, spec, (ptrdiff_t)args->_ll);
+			break;
+		case ARG_DOUBLE:
+			n = snprintf(out, remaining, spec, args->_d);
+			break;
+		case ARG_PTR:
+			n = snprintf(out, remaining, spec, args->_p);
+			break;
+		case ARG_UNSUPPORTED:
+			/* capture_args() made sure this can't happen */
+			break;
+		}
+		if (class != ARG_NONE)
+			args++;
+		if (n > 0)
+			len += (usize)n;
+	}
+
+	if (size != 0)
+		buf[len < size ? len : size - 1] = '\0';
+	return len;
+}
+
+/** format the message right away, for anything capture_args() can't handle */
+static nstr_t *format_now(const char *fmt, va_list vargs)
+{
+	char small[128];
+	va_list vargs2;
+	va_copy(vargs2, vargs);
+
+	nstr_t *msg;
+	int len = vsnprintf(small, sizeof(small), fmt, vargs);
+	if (len < 0) {
+		msg = nstr("Runtime error", nil);
+	} else if ((usize)len < sizeof(small)) {
+		msg = nstr(small, nil);
+	} else {
+		char *buf = nalloc(len + 1, nil);
+		vsnprintf(buf, len + 1, fmt, vargs2);
+		msg = nstr(buf, nil);
+		nfree(buf);
+	}
+
+	va_end(vargs2);
+	return msg;
+}
+
+#ifdef ERROR_TRACE
+
+/*
+ * Every thread has its own ring buffer, so recording only has to publish the
+ * new head after writing the entry.  The only concurrent reader is a signal
+ * handler on the same thread, which is why a compiler barrier is enough.
+ * The per number counters are shared between all threads and updated with
+ * relaxed atomics, they are only approximate while errors are being yeeted.
+ */
+
+struct trace_ring {
+	struct error_trace_entry entries[ERROR_TRACE_SIZE];
+	/* total number of errors recorded, the newest is at (head - 1) */
+	usize head;
+};
+
+/*
+ * The coarse clock is only accurate to a few milliseconds, but it doesn't
+ * need a syscall or even reading the TSC, which would otherwise dominate the
+ * cost of recording an error.
+ */
+#ifdef CLOCK_MONOTONIC_COARSE
+#define TRACE_CLOCK CLOCK_MONOTONIC_COARSE
+#else
+#define TRACE_CLOCK CLOCK_MONOTONIC
+#endif
+
+static _Thread_local struct trace_ring trace;
+static u64 trace_counts[ERROR_TRACE_NUMBERS + 1];
+
+static void trace_record(u32 number, const char *file, int line)
+{
+	struct timespec ts;
+	clock_gettime(TRACE_CLOCK, &ts);
 
-void yeet(error *err, u32 number, const char *restrict fmt, ...)
+	usize head = trace.head;
+	struct error_trace_entry *entry = &trace.entries[head % ERROR_TRACE_SIZE];
+	entry->number = number;
+	entry->line = line;
+	entry->file = file;
+	entry->time = (u64)ts.tv_sec * 1000000000 + (u64)ts.tv_nsec;
+	__atomic_signal_fence(__ATOMIC_RELEASE);
+	trace.head = head + 1;
+
+	u32 bucket = number < ERROR_TRACE_NUMBERS ? number : ERROR_TRACE_NUMBERS;
+	__atomic_fetch_add(&trace_counts[bucket], 1, __ATOMIC_RELAXED);
+}
+
+/** append the decimal representation of `val` to `buf`, signal safe */
+static char *dump_u64(char *buf, u64 val)
+{
+	char digits[20];
+	int n = 0;
+	do {
+		digits[n++] = (char)('0' + val % 10);
+		val /= 10;
+	} while (val != 0);
+	while (n != 0)
+		*buf++ = digits[--n];
+	return buf;
+}
+
+static char *dump_str(char *buf, const char *end, const char *s)
+{
+	while (*s != '\0' && buf != end)
+		*buf++ = *s++;
+	return buf;
+}
+
+#else /* ERROR_TRACE */
+
+static inline void trace_record(u32 number, const char *file, int line)
+{
+	(void)number;
+	(void)file;
+	(void)line;
+}
+
+#endif /* ERROR_TRACE */
+
+usize error_trace(struct error_trace_entry *entries, usize max, error *err)
+{
+#ifdef ERROR_TRACE
+	if (entries == nil && max != 0) {
+		yeet(err, EFAULT, "Entry array is nil");
+		return 0;
+	}
+
+	usize head = trace.head;
+	usize count = head < ERROR_TRACE_SIZE ? head : ERROR_TRACE_SIZE;
+	if (count > max)
+		count = max;
+	for (usize i = 0; i < count; i++)
+		entries[i] = trace.entries[(head - 1 - i) % ERROR_TRACE_SIZE];
+
+	neat(err);
+	return count;
+#else
+	(void)entries;
+	(void)max;
+	yeet(err, ENOSYS, "libneo was built without ERROR_TRACE");
+	return 0;
+#endif
+}
+
+void error_trace_dump(int fd)
+{
+#ifdef ERROR_TRACE
+	__atomic_signal_fence(__ATOMIC_ACQUIRE);
+	usize head = trace.head;
+	usize count = head < ERROR_TRACE_SIZE ? head : ERROR_TRACE_SIZE;
+
+	static const char header[] = "\nmost recent errors on this thread (newest first):\n";
+	(void)!write(fd, header, sizeof(header) - 1);
+
+	for (usize i = 0; i < count; i++) {
+		const struct error_trace_entry *entry =
+			&trace.entries[(head - 1 - i) % ERROR_TRACE_SIZE];
+		char line[512];
+		char *end = &line[sizeof(line) - 64];
+		char *pos = dump_str(line, end, "  ");
+		pos = dump_str(pos, end, entry->file);
+		*pos++ = ':';
+		pos = dump_u64(pos, (u64)entry->line);
+		pos = dump_str(pos, end, ": error ");
+		pos = dump_u64(pos, entry->number);
+		pos = dump_str(pos, end, " at ");
+		pos = dump_u64(pos, entry->time / 1000000000);
+		*pos++ = '.';
+		u64 nsec = entry->time % 1000000000;
+		for (u64 div = 100000000; div != 0; div /= 10)
+			*pos++ = (char)('0' + nsec / div % 10);
+		*pos++ = '\n';
+		(void)!write(fd, line, (usize)(pos - line));
+	}
+#else
+	(void)fd;
+#endif
+}
+
+u64 error_count(u32 number, error *err)
+{
+#ifdef ERROR_TRACE
+	u32 bucket = number < ERROR_TRACE_NUMBERS ? number : ERROR_TRACE_NUMBERS;
+	neat(err);
+	return __atomic_load_n(&trace_counts[bucket], __ATOMIC_RELAXED);
+#else
+	(void)number;
+	yeet(err, ENOSYS, "libneo was built without ERROR_TRACE");
+	return 0;
+#endif
+}
+
+void _neo_yeet(error *err, u32 number, const char *file, int line,
+	       const char *restrict fmt, ...)
 {
 	va_list vargs;
-	usize msg_size = 64;
-	char *msg = nil;
 
-	if (fmt != nil) {
-		do {
-			msg = nalloc(msg_size, nil);
+	trace_record(number, file, line);
+
+	if (err == nil) {
+		/* we are about to exit anyway, so truncating is fine */
+		char msg[256] = "Runtime error";
+		if (fmt != nil) {
 			va_start(vargs, fmt);
-			int required_size = vsnprintf(msg, msg_size, fmt, vargs);
+			vsnprintf(msg, sizeof(msg), fmt, vargs);
 			va_end(vargs);
-			/* required_size excludes NUL, therefore >= */
-			if (required_size >= msg_size) {
-				msg_size = required_size + 1;
-				nfree(msg);
-				msg = nil;
-			} else if (required_size < 0) {
-				write(2, "Runtime error\n", strlen("Runtime error\n"));
-				exit(1);
-			}
-		} while (msg == nil);
-	} else {
-		msg = "Runtime error";
+		}
+		write(2, msg, strlen(msg));
+		error_trace_dump(2);
+		exit(number);
 	}
 
+	err->_number = number;
+	err->_message = nil;
+	err->_fmt = fmt;
+	if (fmt == nil)
+		return;
+
+	va_start(vargs, fmt);
+	bool captured = capture_args(err->_args, fmt, vargs);
+	va_end(vargs);
+
+	if (!captured) {
+		va_start(vargs, fmt);
+		err->_message = format_now(fmt, vargs);
+		va_end(vargs);
+	}
+}
+
+void _neo_yeet_nstr(error *err, u32 number, nstr_t *msg, const char *file, int line)
+{
+	trace_record(number, file, line);
+
 	if (err == nil) {
-		write(2, msg, strlen(msg));
+		if (msg != nil)
+			write(2, nstr_raw(msg), _neo_nstr_size(msg));
+		else
+			write(2, "Runtime error", strlen("Runtime error"));
+		error_trace_dump(2);
 		exit(number);
 	}
 
 	err->_number = number;
-	err->_message = nstr(msg, nil);
-	nfree(msg);
+	err->_fmt = nil;
+	err->_message = msg;
+	if (msg != nil)
+		nget(msg);
+}
+
+nstr_t *_neo_errmsg(error *err)
+{
+	if (err == nil)
+		return nil;
+	if (err->_message != nil || err->_fmt == nil)
+		return err->_message;
+
+	char small[128];
+	char *buf = small;
+	usize len = format_args(small, sizeof(small), err->_fmt, err->_args);
+	if (len >= sizeof(small)) {
+		buf = nalloc(len + 1, nil);
+		format_args(buf, len + 1, err->_fmt, err->_args);
+	}
+
+	err->_message = nstr(buf, nil);
+	if (buf != small)
+		nfree(buf);
+	return err->_message;
 }
 
 void neat(error *err)
@@ -54,6 +489,7 @@ void neat(error *err)
 	if (err) {
 		err->_number = 0;
 		err->_message = nil;
+		err->_fmt = nil;
 	}
 }
 
@@ -62,6 +498,8 @@ void errput(error *err)
 	if (err != nil) {
 		if (err->_message != nil)
 			nput(err->_message);
+		err->_message = nil;
+		err->_fmt = nil;
 		err->_number = 0xffffffff;
 	}
 }
@@ -3,128 +3,259 @@
 #include <errno.h>
 
 #include "neo/_error.h"
+#include "neo/_hashtab.h"
 #include "neo/_nalloc.h"
 #include "neo/_nbuf.h"
 #include "neo/_nref.h"
+#include "neo/_stddef.h"
 #include "neo/_types.h"
 #include "neo/hashtab.h"
 #include "neo/list.h"
 
-static void hashtab_destroy(hashtab_t *table)
+/*
+ * Tables grow (and optionally shrink) incrementally, very much like the dict
+ * implementation in Redis: When the load factor crosses a threshold, new
+ * storage is allocated and the old one is kept around next to it.  From then
+ * on, every call to hashtab_get(), hashtab_put(), and hashtab_del() moves a
+ * handful of buckets over to the new storage before doing its actual job,
+ * until the old storage is empty and can be released.  New entries always go
+ * to the new storage, and lookups have to check both while this is going on.
+ * This way, no single operation ever has to pay for a full rehash.
+ */
+
+/** Number of buckets a chained table migrates per operation when resizing */
+#define CHAINED_REHASH_STEP 4
+
+/** `buckets_len` must be a power of two */
+static void chained_alloc(struct _neo_hashtab_chained *chained, u32 buckets_len,
+			  error *err)
 {
-	for (u32 i = 0; i < table->_buckets_len; i++) {
+	list_t *buckets = nalloc(sizeof(*buckets) * buckets_len, err);
+	catch(err) {
+		return;
+	}
+
+	for (u32 i = 0; i < buckets_len; i++)
+		list_init(&buckets[i]);
+	chained->buckets = buckets;
+	chained->buckets_len = buckets_len;
+}
+
+static void chained_destroy(struct _neo_hashtab_chained *chained)
+{
+	for (u32 i = 0; i < chained->buckets_len; i++) {
 		struct _neo_hashtab_entry *cursor;
-		list_foreach(cursor, &table->_buckets[i], link) {
+		list_foreach(cursor, &chained->buckets[i], link) {
 			nput(cursor->key);
-			nfree(cursor);
+			npool_free(cursor, sizeof(*cursor));
 		}
 	}
+	nfree(chained->buckets);
+}
+
+static inline list_t *chained_bucket(struct _neo_hashtab_chained *chained, u64 hash)
+{
+	return &chained->buckets[hash & (chained->buckets_len - 1)];
+}
+
+static struct _neo_hashtab_entry *chained_find(struct _neo_hashtab_chained *chained,
+					       const nbuf_t *key, u64 hash)
+{
+	struct _neo_hashtab_entry *cursor;
+	list_foreach(cursor, chained_bucket(chained, hash), link) {
+		if (cursor->hash == hash && nbuf_eq(cursor->key, key, nil))
+			return cursor;
+	}
+
+	return nil;
+}
+
+static void chained_resize(hashtab_t *table, u32 buckets_len, error *err)
+{
+	struct _neo_hashtab_chained new;
+	chained_alloc(&new, buckets_len, err);
+	catch(err) {
+		return;
+	}
+
+	table->_chained[1] = table->_chained[0];
+	table->_chained[0] = new;
+	table->_rehash_pos = 0;
+	table->_rehashing = true;
+}
+
+static void chained_rehash_step(hashtab_t *table)
+{
+	struct _neo_hashtab_chained *new = &table->_chained[0];
+	struct _neo_hashtab_chained *old = &table->_chained[1];
+
+	u32 end = nmin(table->_rehash_pos + CHAINED_REHASH_STEP, old->buckets_len);
+	for (; table->_rehash_pos < end; table->_rehash_pos++) {
+		struct _neo_hashtab_entry *cursor;
+		list_foreach(cursor, &old->buckets[table->_rehash_pos], link) {
+			list_del(&cursor->link);
+			list_add(chained_bucket(new, cursor->hash), &cursor->link);
+		}
+	}
+
+	if (table->_rehash_pos == old->buckets_len) {
+		nfree(old->buckets);
+		table->_rehashing = false;
+	}
+}
+
+static inline u32 hashtab_size(const hashtab_t *table)
+{
+	if (table->_flags & HASHTAB_FLAT)
+		return table->_flat[0].capacity;
+	else
+		return table->_chained[0].buckets_len;
+}
+
+static void hashtab_resize(hashtab_t *table, u32 size)
+{
+	/*
+	 * Resizing is merely an optimization, so if we can't allocate the new
+	 * storage we just carry on with the old one.
+	 */
+	error err;
+	if (table->_flags & HASHTAB_FLAT)
+		_neo_hashtab_flat_resize(table, size, &err);
+	else
+		chained_resize(table, size, &err);
+	catch(&err) {
+		errput(&err);
+	}
+}
+
+static inline void hashtab_rehash_step(hashtab_t *table)
+{
+	if (!table->_rehashing)
+		return;
+
+	if (table->_flags & HASHTAB_FLAT)
+		_neo_hashtab_flat_rehash_step(table);
+	else
+		chained_rehash_step(table);
+}
+
+static void hashtab_destroy(hashtab_t *table)
+{
+	if (table->_flags & HASHTAB_FLAT) {
+		_neo_hashtab_flat_destroy(table);
+	} else {
+		chained_destroy(&table->_chained[0]);
+		if (table->_rehashing)
+			chained_destroy(&table->_chained[1]);
+	}
 	nfree(table);
 }
 
-hashtab_t *hashtab_create_custom(u32 buckets,
-				 u32 (*hashfn)(const nbuf_t *key, u32 limit),
-				 error *err)
+hashtab_t *hashtab_create_flags(u32 buckets, u32 flags,
+				u32 (*hashfn)(const nbuf_t *key, u32 limit),
+				error *err)
 {
 	if (buckets == 0) {
 		yeet(err, ERANGE, "Number of buckets is 0");
 		return nil;
 	}
-	if (hashfn == nil) {
-		yeet(err, EFAULT, "Hash function is nil");
+	if ((flags & ~(HASHTAB_FLAT | HASHTAB_SHRINK | HASHTAB_SIPHASH)) != 0) {
+		yeet(err, EINVAL, "Unknown hash table flags");
+		return nil;
+	}
+	if ((flags & HASHTAB_SIPHASH) && hashfn != nil) {
+		yeet(err, EINVAL, "SipHash is incompatible with custom hash functions");
 		return nil;
 	}
 
-	struct _neo_hashtab *table;
-	usize buckets_size = sizeof(table->_buckets[0]) * buckets;
-	table = nalloc(sizeof(*table) + buckets_size, err);
+	struct _neo_hashtab *table = nalloc(sizeof(*table), err);
 	catch(err) {
 		return nil;
 	}
 
 	table->_len = 0;
 	table->_hashfn = hashfn;
-	table->_buckets_len = buckets;
-	for (usize i = 0; i < buckets; i++)
-		list_init(&table->_buckets[i]);
+	table->_seed = nhash_random_key();
+	table->_flags = flags;
+	table->_rehashing = false;
+	table->_rehash_pos = 0;
+
+	if (flags & HASHTAB_FLAT) {
+		_neo_hashtab_flat_init(table, buckets, err);
+	} else if (buckets > 0x80000000) {
+		yeet(err, ERANGE, "Too many buckets");
+	} else {
+		/* bucket indices are computed by masking rather than modulo */
+		u32 buckets_len = 1;
+		while (buckets_len < buckets)
+			buckets_len <<= 1;
+		chained_alloc(&table->_chained[0], buckets_len, err);
+		table->_min_size = buckets_len;
+	}
+	catch(err) {
+		nfree(table);
+		return nil;
+	}
+
 	nref_init(table, hashtab_destroy);
 
 	neat(err);
 	return table;
 }
 
-/* djb2 */
-static u32 hashtab_default_hashfn(const nbuf_t *key, u32 limit)
+hashtab_t *hashtab_create_custom(u32 buckets,
+				 u32 (*hashfn)(const nbuf_t *key, u32 limit),
+				 error *err)
 {
-	u32 hash = 0;
-	const u8 *cursor;
-
-	nbuf_foreach(cursor, key) {
-		hash = (hash * 33) ^ *cursor;
+	if (hashfn == nil) {
+		yeet(err, EFAULT, "Hash function is nil");
+		return nil;
 	}
 
-	/* TODO: we can probably do better than this */
-	return hash % limit;
+	return hashtab_create_flags(buckets, HASHTAB_CHAINED, hashfn, err);
 }
 
 hashtab_t *hashtab_create(u32 buckets, error *err)
 {
-	return hashtab_create_custom(buckets, hashtab_default_hashfn, err);
+	return hashtab_create_flags(buckets, HASHTAB_CHAINED, nil, err);
 }
 
-static u32 hashtab_compute_hash(hashtab_t *table, const nbuf_t *key, error *err)
+static bool hashtab_check_args(hashtab_t *table, const nbuf_t *key, error *err)
 {
 	if (table == nil) {
 		yeet(err, EFAULT, "Hash table is nil");
-		return 0;
+		return false;
 	}
 	if (key == nil) {
 		yeet(err, EFAULT, "Key is nil");
-		return 0;
-	}
-
-	u32 hash = table->_hashfn(key, table->_buckets_len - 1);
-	if (hash >= table->_buckets_len) {
-		yeet(err, ERANGE, "Hash function returned value outside range");
-		return 0;
+		return false;
 	}
 
-	neat(err);
-	return hash;
+	return true;
 }
 
 static struct _neo_hashtab_entry *hashtab_find_entry(hashtab_t *table,
-						     const nbuf_t *key,
-						     error *err)
+						     const nbuf_t *key, u64 hash)
 {
-	u32 hash = hashtab_compute_hash(table, key, err);
-	catch(err) {
-		return nil;
-	}
-
-	list_t *bucket = &table->_buckets[hash];
-	struct _neo_hashtab_entry *cursor;
-	bool found = false;
-	list_foreach(cursor, bucket, link) {
-		if (nbuf_eq(cursor->key, key, nil)) {
-			found = true;
-			break;
-		}
-	}
-	if (!found)
-		cursor = nil;
-
-	neat(err);
-	return cursor;
+	struct _neo_hashtab_entry *entry = chained_find(&table->_chained[0], key, hash);
+	if (entry == nil && table->_rehashing)
+		entry = chained_find(&table->_chained[1], key, hash);
+	return entry;
 }
 
 void *hashtab_get(hashtab_t *table, const nbuf_t *key, error *err)
 {
-	struct _neo_hashtab_entry *entry = hashtab_find_entry(table, key, err);
-	catch(err) {
+	if (!hashtab_check_args(table, key, err))
 		return nil;
-	}
 
+	hashtab_rehash_step(table);
+	neat(err);
+
+	if (table->_flags & HASHTAB_FLAT)
+		return _neo_hashtab_flat_get(table, key);
+
+	struct _neo_hashtab_entry *entry = hashtab_find_entry(table, key,
+							      _neo_hashtab_hash(table, key));
 	if (entry == nil)
 		return nil;
 	else
@@ -133,52 +264,93 @@ void *hashtab_get(hashtab_t *table, const nbuf_t *key, error *err)
 
 void hashtab_put(hashtab_t *table, nbuf_t *key, void *val, error *err)
 {
-	/* TODO: avoid double hash computing */
-	error get_err;
-	struct _neo_hashtab_entry *existing_entry = hashtab_find_entry(table, key, err);
-	catch(err) {
+	if (!hashtab_check_args(table, key, err))
 		return;
-	}
-	if (existing_entry != nil) {
-		yeet(err, EEXIST, "Key already present");
+
+	hashtab_rehash_step(table);
+
+	if (table->_flags & HASHTAB_FLAT) {
+		/* flat tables have to grow before inserting, see there */
+		_neo_hashtab_flat_put(table, key, val, err);
 		return;
 	}
 
-	u32 hash = table->_hashfn(key, table->_buckets_len - 1);
-	if (hash >= table->_buckets_len) {
-		yeet(err, ERANGE, "Hash function returned value out of range");
+	u64 hash = _neo_hashtab_hash(table, key);
+	if (hashtab_find_entry(table, key, hash) != nil) {
+		yeet(err, EEXIST, "Key already present");
 		return;
 	}
 
-	struct _neo_hashtab_entry *entry = nalloc(sizeof(*entry), err);
+	struct _neo_hashtab_entry *entry = npool_alloc(sizeof(*entry), err);
 	catch(err) {
 		return;
 	}
 	nget(key);
+	entry->hash = hash;
 	entry->key = key;
 	entry->val = val;
 
-	list_t *bucket = &table->_buckets[hash];
-	list_add(bucket, &entry->link);
+	list_add(chained_bucket(&table->_chained[0], hash), &entry->link);
 	table->_len++;
+
+	/* maximum load factor for chained tables is 1 */
+	u32 size = hashtab_size(table);
+	if (!table->_rehashing && nlen(table) > size && size < 0x80000000)
+		hashtab_resize(table, size * 2);
+
 	neat(err);
 }
 
 void *hashtab_del(hashtab_t *table, nbuf_t *key, error *err)
 {
-	struct _neo_hashtab_entry *entry = hashtab_find_entry(table, key, err);
-	catch(err) {
+	if (!hashtab_check_args(table, key, err))
 		return nil;
-	}
 
-	if (entry != nil) {
-		list_del(&entry->link);
-		table->_len--;
-		nput(entry->key);
-		return entry->val;
+	hashtab_rehash_step(table);
+
+	void *val;
+	if (table->_flags & HASHTAB_FLAT) {
+		val = _neo_hashtab_flat_del(table, key);
 	} else {
-		return nil;
+		struct _neo_hashtab_entry *entry =
+			hashtab_find_entry(table, key, _neo_hashtab_hash(table, key));
+		if (entry == nil) {
+			val = nil;
+		} else {
+			val = entry->val;
+			list_del(&entry->link);
+			table->_len--;
+			nput(entry->key);
+			npool_free(entry, sizeof(*entry));
+		}
+	}
+
+	if ((table->_flags & HASHTAB_SHRINK) && !table->_rehashing) {
+		u32 size = hashtab_size(table);
+		if (nlen(table) < size / 8 && size / 2 >= table->_min_size)
+			hashtab_resize(table, size / 2);
+	}
+
+	neat(err);
+	return val;
+}
+
+static int chained_foreach(hashtab_t *table, struct _neo_hashtab_chained *chained,
+			   int (*callback)(hashtab_t *table, nbuf_t *key, void *val, void *extra),
+			   void *extra)
+{
+	int ret = 0;
+
+	for (u32 i = 0; i < chained->buckets_len; i++) {
+		struct _neo_hashtab_entry *cursor;
+		list_foreach(cursor, &chained->buckets[i], link) {
+			ret = callback(table, cursor->key, cursor->val, extra);
+			if (ret != 0)
+				return ret;
+		}
 	}
+
+	return ret;
 }
 
 int hashtab_foreach(hashtab_t *table,
@@ -194,23 +366,38 @@ int hashtab_foreach(hashtab_t *table,
 		return 0;
 	}
 
-	int ret = 0;
-	for (u32 i = 0; i < table->_buckets_len; i++) {
-		struct _neo_hashtab_entry *cursor;
-		list_foreach(cursor, &table->_buckets[i], link) {
-			ret = callback(table, cursor->key, cursor->val, extra);
-			if (ret != 0)
-				break;
-		}
+	neat(err);
 
-		if (ret != 0)
-			break;
-	}
+	if (table->_flags & HASHTAB_FLAT)
+		return _neo_hashtab_flat_foreach(table, callback, extra);
 
-	neat(err);
+	int ret = chained_foreach(table, &table->_chained[0], callback, extra);
+	if (ret == 0 && table->_rehashing)
+		ret = chained_foreach(table, &table->_chained[1], callback, extra);
 	return ret;
 }
 
+f32 hashtab_load_factor(const hashtab_t *table)
+{
+	if (table == nil)
+		return 0;
+
+	return (f32)nlen(table) / (f32)hashtab_size(table);
+}
+
+f32 hashtab_rehash_progress(const hashtab_t *table)
+{
+	if (table == nil || !table->_rehashing)
+		return 1;
+
+	u32 total;
+	if (table->_flags & HASHTAB_FLAT)
+		total = table->_flat[1].capacity / _NEO_HASHTAB_GROUP_SIZE;
+	else
+		total = table->_chained[1].buckets_len;
+	return (f32)table->_rehash_pos / (f32)total;
+}
+
 /*
  * This file is part of libneo.
  * Copyright (c) 2021 Fefie <owo@fef.moe>.
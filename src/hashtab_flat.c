@@ -0,0 +1,369 @@
+/** See the end of this file for copyright and license terms. */
+
+/*
+ * The flat hash table engine is a simplified variant of the "Swiss Table"
+ * design popularized by Abseil.  All entries live in one big array of slots
+ * that is probed in groups of 16.  Next to the slots, there is an array of
+ * control bytes (one per slot) that marks the slot as either EMPTY, DELETED,
+ * or FULL, in which case the lower 7 bits hold the 7 most significant bits of
+ * the key's hash (called H2).  The remaining hash bits (H1) select the group
+ * where probing starts.  A lookup loads all 16 control bytes of a group into a
+ * vector register, compares them against H2 in one go, and only touches the
+ * actual keys for the (usually zero or one) matches.  Probing stops as soon as
+ * a group contains an EMPTY slot.
+ *
+ * Groups are always aligned to 16 slots, and the probe sequence visits groups
+ * in triangular steps (+1, +2, +3, ...), which is guaranteed to hit every group
+ * exactly once because the number of groups is a power of two.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#	define HASHTAB_FLAT_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#	include <arm_neon.h>
+#	define HASHTAB_FLAT_NEON
+#endif
+
+#include "neo/_error.h"
+#include "neo/_hashtab.h"
+#include "neo/_nalloc.h"
+#include "neo/_nbuf.h"
+#include "neo/_nref.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+#include "neo/hashtab.h"
+
+#define GROUP_SIZE	_NEO_HASHTAB_GROUP_SIZE
+#define CTRL_EMPTY	((u8)0x80)
+#define CTRL_DELETED	((u8)0xfe)
+/* anything with the MSB cleared is a FULL slot */
+#define ctrl_is_full(ctrl) (((ctrl) & 0x80) == 0)
+
+#define H1(hash) ((u32)(hash))
+#define H2(hash) ((u8)((hash) >> 57))
+
+/* bitmask with one bit per slot in a group, LSB is the first slot */
+typedef u32 groupmask_t;
+
+#ifdef HASHTAB_FLAT_NEON
+static inline groupmask_t neon_movemask(uint8x16_t v)
+{
+	static const u8 bits[GROUP_SIZE] = {
+		1, 2, 4, 8, 16, 32, 64, 128,
+		1, 2, 4, 8, 16, 32, 64, 128,
+	};
+	uint8x16_t masked = vandq_u8(v, vld1q_u8(&bits[0]));
+	return (groupmask_t)vaddv_u8(vget_low_u8(masked))
+		| ((groupmask_t)vaddv_u8(vget_high_u8(masked)) << 8);
+}
+#endif
+
+/** Return a mask of all slots in a group whose control byte equals `c`. */
+static inline groupmask_t group_match(const u8 *group, u8 c)
+{
+#if defined(HASHTAB_FLAT_SSE2)
+	__m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+	return (groupmask_t)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)c)));
+#elif defined(HASHTAB_FLAT_NEON)
+	return neon_movemask(vceqq_u8(vld1q_u8(group), vdupq_n_u8(c)));
+#else
+	groupmask_t mask = 0;
+	for (unsigned int i = 0; i < GROUP_SIZE; i++)
+		mask |= (groupmask_t)(group[i] == c) << i;
+	return mask;
+#endif
+}
+
+/** Return a mask of all slots in a group that are either EMPTY or DELETED. */
+static inline groupmask_t group_match_free(const u8 *group)
+{
+#if defined(HASHTAB_FLAT_SSE2)
+	return (groupmask_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+#elif defined(HASHTAB_FLAT_NEON)
+	return neon_movemask(vtstq_u8(vld1q_u8(group), vdupq_n_u8(0x80)));
+#else
+	groupmask_t mask = 0;
+	for (unsigned int i = 0; i < GROUP_SIZE; i++)
+		mask |= (groupmask_t)!ctrl_is_full(group[i]) << i;
+	return mask;
+#endif
+}
+
+static void flat_alloc(struct _neo_hashtab_flat *flat, u32 capacity, error *err)
+{
+	/* control bytes come first so the slot array is aligned to 16 */
+	usize size = (usize)capacity * (1 + sizeof(struct _neo_hashtab_slot));
+	u8 *mem = nalloc(size, err);
+	catch(err) {
+		return;
+	}
+
+	memset(mem, CTRL_EMPTY, capacity);
+	flat->ctrl = mem;
+	flat->slots = (struct _neo_hashtab_slot *)(mem + capacity);
+	flat->capacity = capacity;
+	/* maximum load factor is 7/8 */
+	flat->growth_left = capacity - capacity / 8;
+}
+
+/** Return the index of the slot holding `key`, or -1 if it doesn't exist. */
+static isize flat_find(const struct _neo_hashtab_flat *flat, const nbuf_t *key, u64 hash)
+{
+	u32 groups_mask = flat->capacity / GROUP_SIZE - 1;
+	u32 group = H1(hash) & groups_mask;
+	u8 h2 = H2(hash);
+
+	for (u32 probe = 1; probe <= groups_mask + 1; probe++) {
+		const u8 *ctrl = &flat->ctrl[group * GROUP_SIZE];
+
+		groupmask_t match = group_match(ctrl, h2);
+		while (match != 0) {
+			u32 index = group * GROUP_SIZE + __builtin_ctz(match);
+			const struct _neo_hashtab_slot *slot = &flat->slots[index];
+			if (slot->hash == hash && nbuf_eq(slot->key, key, nil))
+				return index;
+			match &= match - 1;
+		}
+
+		if (group_match(ctrl, CTRL_EMPTY) != 0)
+			break;
+		group = (group + probe) & groups_mask;
+	}
+
+	return -1;
+}
+
+/**
+ * Return the index of the first slot in the probe sequence that is either
+ * EMPTY or DELETED.  There is always at least one EMPTY slot because the
+ * maximum load factor is 7/8, so this never fails.
+ */
+static u32 flat_find_free(const struct _neo_hashtab_flat *flat, u64 hash)
+{
+	u32 groups_mask = flat->capacity / GROUP_SIZE - 1;
+	u32 group = H1(hash) & groups_mask;
+
+	for (u32 probe = 1; ; probe++) {
+		groupmask_t match = group_match_free(&flat->ctrl[group * GROUP_SIZE]);
+		if (match != 0)
+			return group * GROUP_SIZE + __builtin_ctz(match);
+		group = (group + probe) & groups_mask;
+	}
+}
+
+static inline void flat_insert(struct _neo_hashtab_flat *flat, u32 index,
+			       u64 hash, nbuf_t *key, void *val)
+{
+	if (flat->ctrl[index] == CTRL_EMPTY)
+		flat->growth_left--;
+	flat->ctrl[index] = H2(hash);
+	flat->slots[index].hash = hash;
+	flat->slots[index].key = key;
+	flat->slots[index].val = val;
+}
+
+static void flat_erase(struct _neo_hashtab_flat *flat, u32 index)
+{
+	/*
+	 * Probing stops at the first group that has an EMPTY slot, and groups
+	 * never gain new EMPTY slots (except through this very branch), so if
+	 * our group still has one, no probe sequence has ever gone past it and
+	 * we don't need to leave a tombstone.
+	 */
+	const u8 *group = &flat->ctrl[index & ~(u32)(GROUP_SIZE - 1)];
+	if (group_match(group, CTRL_EMPTY) != 0) {
+		flat->ctrl[index] = CTRL_EMPTY;
+		flat->growth_left++;
+	} else {
+		flat->ctrl[index] = CTRL_DELETED;
+	}
+}
+
+void _neo_hashtab_flat_init(hashtab_t *table, u32 capacity, error *err)
+{
+	/* make room for `capacity` entries without exceeding the load factor */
+	u64 slots = GROUP_SIZE;
+	while (slots - slots / 8 < capacity)
+		slots <<= 1;
+
+	if (slots > 0x80000000) {
+		yeet(err, ERANGE, "Hash table capacity too large");
+		return;
+	}
+
+	flat_alloc(&table->_flat[0], (u32)slots, err);
+	table->_min_size = (u32)slots;
+}
+
+void _neo_hashtab_flat_destroy(hashtab_t *table)
+{
+	for (int t = table->_rehashing ? 1 : 0; t >= 0; t--) {
+		struct _neo_hashtab_flat *flat = &table->_flat[t];
+		for (u32 i = 0; i < flat->capacity; i++) {
+			if (ctrl_is_full(flat->ctrl[i]))
+				nput(flat->slots[i].key);
+		}
+		nfree(flat->ctrl);
+	}
+}
+
+void _neo_hashtab_flat_resize(hashtab_t *table, u32 capacity, error *err)
+{
+	struct _neo_hashtab_flat new;
+	flat_alloc(&new, capacity, err);
+	catch(err) {
+		return;
+	}
+
+	table->_flat[1] = table->_flat[0];
+	table->_flat[0] = new;
+	table->_rehash_pos = 0;
+	table->_rehashing = true;
+}
+
+void _neo_hashtab_flat_rehash_step(hashtab_t *table)
+{
+	struct _neo_hashtab_flat *new = &table->_flat[0];
+	struct _neo_hashtab_flat *old = &table->_flat[1];
+
+	/*
+	 * Migrated slots are marked DELETED rather than EMPTY in the old
+	 * storage, because lookups of entries that haven't been migrated yet
+	 * might have to probe past them.
+	 */
+	u32 end = (table->_rehash_pos + 1) * GROUP_SIZE;
+	for (u32 i = table->_rehash_pos * GROUP_SIZE; i < end; i++) {
+		if (!ctrl_is_full(old->ctrl[i]))
+			continue;
+
+		struct _neo_hashtab_slot *slot = &old->slots[i];
+		flat_insert(new, flat_find_free(new, slot->hash), slot->hash,
+			    slot->key, slot->val);
+		old->ctrl[i] = CTRL_DELETED;
+	}
+
+	table->_rehash_pos++;
+	if (table->_rehash_pos == old->capacity / GROUP_SIZE) {
+		nfree(old->ctrl);
+		table->_rehashing = false;
+	}
+}
+
+void *_neo_hashtab_flat_get(hashtab_t *table, const nbuf_t *key)
+{
+	u64 hash = _neo_hashtab_hash(table, key);
+
+	for (int t = 0; t <= (table->_rehashing ? 1 : 0); t++) {
+		struct _neo_hashtab_flat *flat = &table->_flat[t];
+		isize index = flat_find(flat, key, hash);
+		if (index >= 0)
+			return flat->slots[index].val;
+	}
+
+	return nil;
+}
+
+void _neo_hashtab_flat_put(hashtab_t *table, nbuf_t *key, void *val, error *err)
+{
+	u64 hash = _neo_hashtab_hash(table, key);
+
+	for (int t = 0; t <= (table->_rehashing ? 1 : 0); t++) {
+		if (flat_find(&table->_flat[t], key, hash) >= 0) {
+			yeet(err, EEXIST, "Key already present");
+			return;
+		}
+	}
+
+	struct _neo_hashtab_flat *flat = &table->_flat[0];
+	u32 index = flat_find_free(flat, hash);
+	if (flat->growth_left == 0 && flat->ctrl[index] == CTRL_EMPTY) {
+		/*
+		 * New storage is always at least twice as large as the number
+		 * of entries in the old one, and we migrate one group per
+		 * operation, so this should never happen during a resize.
+		 * Let's be defensive anyway and finish the old one first.
+		 */
+		while (table->_rehashing)
+			_neo_hashtab_flat_rehash_step(table);
+
+		/*
+		 * If less than half of the used slots are actually occupied,
+		 * the rest are DELETED and we can just clean them up without
+		 * growing the table.
+		 */
+		u32 capacity = flat->capacity;
+		if (nlen(table) >= capacity / 2 - capacity / 16) {
+			if (capacity == 0x80000000) {
+				yeet(err, ERANGE, "Hash table capacity too large");
+				return;
+			}
+			capacity <<= 1;
+		}
+
+		_neo_hashtab_flat_resize(table, capacity, err);
+		catch(err) {
+			return;
+		}
+		/* the new storage is empty, there are no collisions yet */
+		index = flat_find_free(flat, hash);
+	}
+
+	nget(key);
+	flat_insert(flat, index, hash, key, val);
+	table->_len++;
+	neat(err);
+}
+
+void *_neo_hashtab_flat_del(hashtab_t *table, const nbuf_t *key)
+{
+	u64 hash = _neo_hashtab_hash(table, key);
+
+	for (int t = 0; t <= (table->_rehashing ? 1 : 0); t++) {
+		struct _neo_hashtab_flat *flat = &table->_flat[t];
+		isize index = flat_find(flat, key, hash);
+		if (index < 0)
+			continue;
+
+		void *val = flat->slots[index].val;
+		nput(flat->slots[index].key);
+		flat_erase(flat, (u32)index);
+		table->_len--;
+		return val;
+	}
+
+	return nil;
+}
+
+int _neo_hashtab_flat_foreach(hashtab_t *table,
+			      int (*callback)(hashtab_t *table, nbuf_t *key, void *val, void *extra),
+			      void *extra)
+{
+	int ret = 0;
+
+	for (int t = 0; t <= (table->_rehashing ? 1 : 0); t++) {
+		struct _neo_hashtab_flat *flat = &table->_flat[t];
+		for (u32 i = 0; i < flat->capacity && ret == 0; i++) {
+			if (ctrl_is_full(flat->ctrl[i]))
+				ret = callback(table, flat->slots[i].key, flat->slots[i].val, extra);
+		}
+	}
+
+	return ret;
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
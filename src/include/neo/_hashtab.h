@@ -0,0 +1,93 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+/*
+ * Internal interface between the generic hash table frontend in
+ * src/hashtab.c and the flat (open addressing) engine in src/hashtab_flat.c.
+ * None of these functions check their arguments for nil, that is the job of
+ * the frontend.
+ */
+
+#include "neo/_nbuf.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+#include "neo/hashtab.h"
+#include "neo/nhash.h"
+
+/** Number of slots the flat engine probes at once, see src/hashtab_flat.c */
+#define _NEO_HASHTAB_GROUP_SIZE 16
+
+/** 64-bit murmur3 finalizer */
+static inline u64 _neo_hashtab_fmix64(u64 hash)
+{
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+/**
+ * Compute the 64-bit hash of a key.  Both engines use the lowest bits to
+ * select a bucket or group, and the flat one also needs the highest ones,
+ * so all bits must be evenly distributed.  Entries store the result, so
+ * this is only called once per operation and never while rehashing.
+ */
+static inline u64 _neo_hashtab_hash(const hashtab_t *table, const nbuf_t *key)
+{
+	/*
+	 * Custom hash functions only return 32 bits, which also aren't
+	 * guaranteed to be any good, so spread them out.
+	 */
+	if (table->_hashfn != nil)
+		return _neo_hashtab_fmix64(table->_hashfn(key, 0xffffffff));
+
+	/* SipHash keys are secret and per-table, so there is nothing to share */
+	if (table->_flags & HASHTAB_SIPHASH)
+		return nsiphash(key->_data, nlen(key), &table->_seed);
+
+	/*
+	 * The default is to use the hash memoized in the key itself, which is
+	 * the same for every table.  Mixing it with the table's own seed still
+	 * makes every table distribute its keys differently.  Full 64-bit
+	 * collisions of the memoized hash carry over to every table though,
+	 * no matter how it is re-keyed, because that would require hashing
+	 * the key's bytes again.  HASHTAB_SIPHASH is for untrusted keys.
+	 */
+	return _neo_hashtab_fmix64(nbuf_hash(key, nil) ^ table->_seed.k0);
+}
+
+void _neo_hashtab_flat_init(hashtab_t *table, u32 capacity, error *err);
+
+void _neo_hashtab_flat_destroy(hashtab_t *table);
+
+/** Start migrating all entries to new storage with `capacity` slots. */
+void _neo_hashtab_flat_resize(hashtab_t *table, u32 capacity, error *err);
+
+/** Migrate the next group of slots to the new storage. */
+void _neo_hashtab_flat_rehash_step(hashtab_t *table);
+
+void *_neo_hashtab_flat_get(hashtab_t *table, const nbuf_t *key);
+
+void _neo_hashtab_flat_put(hashtab_t *table, nbuf_t *key, void *val, error *err);
+
+void *_neo_hashtab_flat_del(hashtab_t *table, const nbuf_t *key);
+
+int _neo_hashtab_flat_foreach(hashtab_t *table,
+			      int (*callback)(hashtab_t *table, nbuf_t *key, void *val, void *extra),
+			      void *extra);
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,66 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+#include <string.h>
+
+#include "neo/_types.h"
+#include "neo/utf.h"
+
+/**
+ * Validate `size` bytes of UTF-8 and return the number of code points, where
+ * NUL characters count like any other character.  Exactly `size` bytes are
+ * read, so a sequence that is cut off at the end is an error.  The error
+ * messages are the same as the ones from `utf8_to_nchr()`.
+ */
+usize _neo_utf8_validate(const char *s, usize size, error *err);
+
+/**
+ * Decode the character at `s[pos]` with `utf8_to_nchr()`, but without reading
+ * beyond `s[size - 1]`.  Returns the size of the character in bytes.
+ */
+static inline usize _neo_utf8_decode_at(nchar *c, const char *s, usize pos, usize size,
+					error *err)
+{
+	if (size - pos >= 4)
+		return utf8_to_nchr(c, &s[pos], err);
+
+	/* zeroes are never continuation bytes, so cut off sequences fail */
+	char tail[4] = { 0 };
+	memcpy(tail, &s[pos], size - pos);
+	return utf8_to_nchr(c, tail, err);
+}
+
+/**
+ * Count the code points in `size` bytes of (already validated) UTF-8.
+ */
+usize _neo_utf8_count(const char *s, usize size);
+
+/**
+ * Advance `pos` by `n` UTF-8 sequences.  The string must already be known to
+ * be valid, so we only need to skip over continuation bytes.  This can't run
+ * past the end of a neo string because the next byte is either a NUL or the
+ * start of another sequence in the original string.
+ */
+static inline const char *_neo_utf8_skip(const char *pos, usize n)
+{
+	while (n-- != 0) {
+		do {
+			pos++;
+		} while ((*pos & 0xc0) == 0x80);
+	}
+	return pos;
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
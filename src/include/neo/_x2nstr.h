@@ -0,0 +1,26 @@
+/* See the end of this file for copyright and license terms. */
+
+#pragma once
+
+#include "neo/_types.h"
+
+/**
+ * Write the digits of `n` in the given radix to the memory immediately
+ * before `end`, followed by a NUL terminator at `end` itself.  The buffer
+ * has to be at least 65 bytes large for base 2.
+ * Returns a pointer to the first digit.
+ */
+char *_neo_unsigned_convert(char *end, u64 n, int radix, error *err);
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -1,76 +1,449 @@
 /** See the end of this file for copyright and license terms. */
 
 #include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <stdio.h>
 
 #include "neo/_error.h"
 #include "neo/_nalloc.h"
 #include "neo/_stddef.h"
+#include "neo/_toolchain.h"
 #include "neo/_types.h"
+#include "neo/buildconfig.h"
 
-void nfree(void *ptr)
+struct nalloc_site;
+
+/*
+ * Every allocation is preceded by a small header that remembers the backend
+ * it came from.  This is what allows memory to be released through the right
+ * backend even after the calling thread has left the scope it was allocated
+ * in, or the process-wide backend was replaced.  The header also stores the
+ * size so that backends don't need to implement realloc themselves.
+ */
+struct nalloc_header {
+	_Alignas(16) const struct nalloc_backend *backend;
+	usize size;
+#ifdef NALLOC_STATS
+	struct nalloc_site *site;
+	/** set by _neo_nalloc_permanent(), excluded from the leak report */
+	bool permanent;
+#endif
+};
+
+#ifdef NALLOC_STATS
+
+/*
+ * Call sites are identified by the (file, line) pair passed to _neo_nalloc().
+ * They live in a fixed size open addressing table that is never cleared, so
+ * headers can simply point to their site.  Lookups are lock-free because
+ * a slot's file pointer is only published after its line has been written,
+ * and only insertions take the lock.  If the table is full, allocations are
+ * accounted to overflow_site.
+ */
+
+#define NALLOC_SITES 1024
+
+struct nalloc_site {
+	const char *file;
+	int line;
+	u64 allocs;
+	usize live_count;
+	usize live_bytes;
+	/** live allocations that are never meant to be released */
+	usize permanent_count;
+	usize permanent_bytes;
+};
+
+static struct nalloc_site sites[NALLOC_SITES];
+static struct nalloc_site overflow_site = {
+	.file = "(other)",
+};
+static pthread_mutex_t sites_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct nalloc_stats global_stats;
+static usize permanent_count;
+static usize permanent_bytes;
+
+static struct nalloc_site *site_get(const char *file, int line)
 {
+	u64 hash = ((u64)(uintptr_t)file ^ (u64)line) * 0x9e3779b97f4a7c15;
+	u32 index = (u32)(hash >> 32) % NALLOC_SITES;
+
+	for (u32 probe = 0; probe < NALLOC_SITES; probe++) {
+		struct nalloc_site *site = &sites[(index + probe) % NALLOC_SITES];
+		const char *site_file = __atomic_load_n(&site->file, __ATOMIC_ACQUIRE);
+
+		if (site_file == nil) {
+			pthread_mutex_lock(&sites_lock);
+			site_file = site->file;
+			if (site_file == nil) {
+				site->line = line;
+				__atomic_store_n(&site->file, file, __ATOMIC_RELEASE);
+				site_file = file;
+			}
+			pthread_mutex_unlock(&sites_lock);
+		}
+
+		if (site_file == file && site->line == line)
+			return site;
+	}
+
+	return &overflow_site;
+}
+
+static inline unsigned int size_class(usize size)
+{
+	unsigned int class = 0;
+	while (class < NALLOC_STATS_CLASSES - 1 && size > ((usize)16 << class))
+		class++;
+	return class;
+}
+
+static void stats_alloc(struct nalloc_header *header, const char *file, int line)
+{
+	struct nalloc_site *site = site_get(file, line);
+	header->site = site;
+	header->permanent = false;
+
+	__atomic_fetch_add(&site->allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&site->live_count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&site->live_bytes, header->size, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&global_stats.allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&global_stats.live_count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&global_stats.class_allocs[size_class(header->size)], 1,
+			   __ATOMIC_RELAXED);
+	usize live = __atomic_add_fetch(&global_stats.live_bytes, header->size,
+					__ATOMIC_RELAXED);
+	usize peak = __atomic_load_n(&global_stats.peak_bytes, __ATOMIC_RELAXED);
+	while (live > peak) {
+		if (__atomic_compare_exchange_n(&global_stats.peak_bytes, &peak, live, true,
+						__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+	}
+}
+
+static void stats_permanent(struct nalloc_header *header)
+{
+	if (header->permanent)
+		return;
+
+	struct nalloc_site *site = header->site;
+	header->permanent = true;
+	__atomic_fetch_add(&site->permanent_count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&site->permanent_bytes, header->size, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&permanent_count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&permanent_bytes, header->size, __ATOMIC_RELAXED);
+}
+
+static void stats_free(struct nalloc_header *header)
+{
+	struct nalloc_site *site = header->site;
+	if (header->permanent) {
+		__atomic_fetch_sub(&site->permanent_count, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&site->permanent_bytes, header->size, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&permanent_count, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_sub(&permanent_bytes, header->size, __ATOMIC_RELAXED);
+	}
+	__atomic_fetch_sub(&site->live_count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&site->live_bytes, header->size, __ATOMIC_RELAXED);
+
+	__atomic_fetch_add(&global_stats.frees, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&global_stats.live_count, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_sub(&global_stats.live_bytes, header->size, __ATOMIC_RELAXED);
+}
+
+static void stats_report(void)
+{
+	/* pool slabs, NSTR_DEFINE strings etc. are not leaks */
+	usize live_count = __atomic_load_n(&global_stats.live_count, __ATOMIC_RELAXED)
+		- __atomic_load_n(&permanent_count, __ATOMIC_RELAXED);
+	usize live_bytes = __atomic_load_n(&global_stats.live_bytes, __ATOMIC_RELAXED)
+		- __atomic_load_n(&permanent_bytes, __ATOMIC_RELAXED);
+	if (live_count == 0)
+		return;
+
+	fprintf(stderr, "libneo: %zu bytes in %zu allocations still alive at exit:\n",
+		live_bytes, live_count);
+	for (u32 i = 0; i <= NALLOC_SITES; i++) {
+		struct nalloc_site *site = i < NALLOC_SITES ? &sites[i] : &overflow_site;
+		if (site->file == nil || site->live_count == site->permanent_count)
+			continue;
+		fprintf(stderr, "  %s:%d: %zu bytes in %zu allocations\n",
+			site->file, site->line, site->live_bytes - site->permanent_bytes,
+			site->live_count - site->permanent_count);
+	}
+}
+__neo_fini(stats_report);
+
+#else /* NALLOC_STATS */
+
+static inline void stats_alloc(struct nalloc_header *header, const char *file, int line)
+{
+	(void)header;
+	(void)file;
+	(void)line;
+}
+
+static inline void stats_free(struct nalloc_header *header)
+{
+	(void)header;
+}
+
+static inline void stats_permanent(struct nalloc_header *header)
+{
+	(void)header;
+}
+
+#endif /* NALLOC_STATS */
+
+void nalloc_stats(struct nalloc_stats *stats, error *err)
+{
+#ifdef NALLOC_STATS
+	if (stats == nil) {
+		yeet(err, EFAULT, "Stats pointer is nil");
+		return;
+	}
+
+	stats->live_bytes = __atomic_load_n(&global_stats.live_bytes, __ATOMIC_RELAXED);
+	stats->peak_bytes = __atomic_load_n(&global_stats.peak_bytes, __ATOMIC_RELAXED);
+	stats->live_count = __atomic_load_n(&global_stats.live_count, __ATOMIC_RELAXED);
+	stats->allocs = __atomic_load_n(&global_stats.allocs, __ATOMIC_RELAXED);
+	stats->frees = __atomic_load_n(&global_stats.frees, __ATOMIC_RELAXED);
+	for (unsigned int i = 0; i < NALLOC_STATS_CLASSES; i++) {
+		stats->class_allocs[i] = __atomic_load_n(&global_stats.class_allocs[i],
+							 __ATOMIC_RELAXED);
+	}
+	neat(err);
+#else
+	(void)stats;
+	yeet(err, ENOSYS, "libneo was built without NALLOC_STATS");
+#endif
+}
+
+usize nalloc_site_stats(struct nalloc_site_stats *out, usize max, error *err)
+{
+#ifdef NALLOC_STATS
+	if (out == nil && max != 0) {
+		yeet(err, EFAULT, "Site array is nil");
+		return 0;
+	}
+
+	usize count = 0;
+	for (u32 i = 0; i <= NALLOC_SITES; i++) {
+		struct nalloc_site *site = i < NALLOC_SITES ? &sites[i] : &overflow_site;
+		const char *file = __atomic_load_n(&site->file, __ATOMIC_ACQUIRE);
+		u64 allocs = __atomic_load_n(&site->allocs, __ATOMIC_RELAXED);
+		if (file == nil || allocs == 0)
+			continue;
+
+		if (count < max) {
+			out[count].file = file;
+			out[count].line = site->line;
+			out[count].allocs = allocs;
+			out[count].live_count = __atomic_load_n(&site->live_count,
+								__ATOMIC_RELAXED);
+			out[count].live_bytes = __atomic_load_n(&site->live_bytes,
+								__ATOMIC_RELAXED);
+		}
+		count++;
+	}
+
+	neat(err);
+	return count;
+#else
+	(void)out;
+	(void)max;
+	yeet(err, ENOSYS, "libneo was built without NALLOC_STATS");
+	return 0;
+#endif
+}
+
+static void *libc_alloc(usize size, void *ctx)
+{
+	(void)ctx;
+	return malloc(size);
+}
+
+static void *libc_zalloc(usize size, void *ctx)
+{
+	(void)ctx;
+	return calloc(1, size);
+}
+
+static void *libc_realloc(void *ptr, usize newsize, void *ctx)
+{
+	(void)ctx;
+	return realloc(ptr, newsize);
+}
+
+static void libc_free(void *ptr, void *ctx)
+{
+	(void)ctx;
 	free(ptr);
 }
 
+const struct nalloc_backend nalloc_libc_backend = {
+	.alloc = libc_alloc,
+	.zalloc = libc_zalloc,
+	.realloc = libc_realloc,
+	.free = libc_free,
+	.ctx = nil,
+};
+
+__neo_weak const struct nalloc_backend *const nalloc_default_backend = &nalloc_libc_backend;
+
+/** process-wide backend, nil means nalloc_default_backend */
+static const struct nalloc_backend *global_backend = nil;
+/** scoped backend of the current thread, nil means global_backend */
+static _Thread_local const struct nalloc_backend *thread_backend = nil;
+
+const struct nalloc_backend *nalloc_backend_set(const struct nalloc_backend *backend)
+{
+	const struct nalloc_backend *prev =
+		__atomic_exchange_n(&global_backend, backend, __ATOMIC_ACQ_REL);
+	return prev != nil ? prev : nalloc_default_backend;
+}
+
+const struct nalloc_backend *nalloc_backend_get(void)
+{
+	if (thread_backend != nil)
+		return thread_backend;
+
+	const struct nalloc_backend *backend =
+		__atomic_load_n(&global_backend, __ATOMIC_ACQUIRE);
+	return backend != nil ? backend : nalloc_default_backend;
+}
+
+const struct nalloc_backend *nalloc_scope_enter(const struct nalloc_backend *backend)
+{
+	const struct nalloc_backend *prev = thread_backend;
+	thread_backend = backend;
+	return prev;
+}
+
+void nalloc_scope_exit(const struct nalloc_backend *prev)
+{
+	thread_backend = prev;
+}
+
+static inline struct nalloc_header *header_of(void *ptr)
+{
+	return (struct nalloc_header *)ptr - 1;
+}
+
+void _neo_nalloc_permanent(void *ptr)
+{
+	if (ptr == nil)
+		return;
+
+	stats_permanent(header_of(ptr));
+}
+
+void nfree(void *ptr)
+{
+	if (ptr == nil)
+		return;
+
+	struct nalloc_header *header = header_of(ptr);
+	stats_free(header);
+	header->backend->free(header, header->backend->ctx);
+}
+
 /*
  * the error messages are nil if malloc fails because if we are running low
  * on memory, vsnprintf (which yeet() uses) is probably gonna fail as well
  */
 
-void *nalloc(usize size, error *err)
+static void *backend_alloc(const struct nalloc_backend *backend, usize size,
+			   bool zero, error *err, const char *file, int line)
 {
 	if (size == 0) {
 		yeet(err, EINVAL, "Requested memory size is 0");
 		return nil;
 	}
-
-	void *ptr = malloc(size);
-
-	if (!ptr)
+	if (size > (usize)-1 - sizeof(struct nalloc_header)) {
 		yeet(err, ENOMEM, nil);
-	else
-		neat(err);
+		return nil;
+	}
 
-	return ptr;
-}
+	usize total = sizeof(struct nalloc_header) + size;
+	struct nalloc_header *header;
+	if (zero && backend->zalloc != nil) {
+		header = backend->zalloc(total, backend->ctx);
+	} else {
+		header = backend->alloc(total, backend->ctx);
+		if (zero && header != nil)
+			memset(header + 1, 0, size);
+	}
 
-void *zalloc(usize size, error *err)
-{
-	if (size == 0) {
-		yeet(err, EINVAL, "Requested memory size is 0");
+	if (header == nil) {
+		yeet(err, ENOMEM, nil);
 		return nil;
 	}
 
-	void *ptr = calloc(1, size);
+	header->backend = backend;
+	header->size = size;
+	stats_alloc(header, file, line);
+	neat(err);
+	return header + 1;
+}
 
-	if (!ptr)
-		yeet(err, ENOMEM, nil);
-	else
-		neat(err);
+void *_neo_nalloc(usize size, error *err, const char *file, int line)
+{
+	return backend_alloc(nalloc_backend_get(), size, false, err, file, line);
+}
 
-	return ptr;
+void *_neo_nzalloc(usize size, error *err, const char *file, int line)
+{
+	return backend_alloc(nalloc_backend_get(), size, true, err, file, line);
 }
 
-void *nrealloc(void *ptr, usize newsz, error *err)
+void *_neo_nrealloc(void *ptr, usize newsz, error *err, const char *file, int line)
 {
-	void *ret = realloc(ptr, newsz);
+	if (ptr == nil)
+		return _neo_nalloc(newsz, err, file, line);
 
-	if (!ret) {
-		if (newsz == 0) {
-			ret = nil;
-			neat(err);
-		} else {
-			ret = ptr;
+	if (newsz == 0) {
+		nfree(ptr);
+		neat(err);
+		return nil;
+	}
+
+	/* memory always stays with the backend it was allocated from */
+	struct nalloc_header *header = header_of(ptr);
+	const struct nalloc_backend *backend = header->backend;
+
+	if (backend->realloc != nil) {
+		if (newsz > (usize)-1 - sizeof(*header)) {
 			yeet(err, ENOMEM, nil);
+			return ptr;
 		}
-	} else {
+		struct nalloc_header *new = backend->realloc(header, sizeof(*header) + newsz,
+							     backend->ctx);
+		if (new == nil) {
+			yeet(err, ENOMEM, nil);
+			return ptr;
+		}
+		/* the header was moved along with the data, and still has the old size */
+		stats_free(new);
+		new->size = newsz;
+		stats_alloc(new, file, line);
 		neat(err);
+		return new + 1;
 	}
 
-	return ret;
+	void *new = backend_alloc(backend, newsz, false, err, file, line);
+	catch(err) {
+		return ptr;
+	}
+	memcpy(new, ptr, nmin(header->size, newsz));
+	nfree(ptr);
+	return new;
 }
 
 /*
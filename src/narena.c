@@ -0,0 +1,185 @@
+/** See the end of this file for copyright and license terms. */
+
+/* MAP_ANONYMOUS */
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "neo/_error.h"
+#include "neo/_nalloc.h"
+#include "neo/_nref.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+#include "neo/narena.h"
+
+#define NARENA_DEFAULT_CHUNK_SIZE	(64 * 1024)
+#define NARENA_ALIGN			16
+
+#define align_up(n) (((n) + NARENA_ALIGN - 1) & ~(usize)(NARENA_ALIGN - 1))
+
+struct _neo_narena_chunk {
+	struct _neo_narena_chunk *next;
+	/** total size including this header, needed for munmap() */
+	usize size;
+};
+
+/* the header is padded so that the usable area is aligned */
+#define CHUNK_HEADER_SIZE align_up(sizeof(struct _neo_narena_chunk))
+
+static struct _neo_narena_chunk *chunk_alloc(narena_t *arena, usize size, error *err)
+{
+	struct _neo_narena_chunk *chunk;
+
+	if (arena->_flags & NARENA_MMAP) {
+		usize page_size = (usize)sysconf(_SC_PAGESIZE);
+		if (size > (usize)-1 - page_size) {
+			yeet(err, ERANGE, "Arena chunk size is too large");
+			return nil;
+		}
+		size = (size + page_size - 1) & ~(page_size - 1);
+		chunk = mmap(nil, size, PROT_READ | PROT_WRITE,
+			     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (chunk == MAP_FAILED) {
+			yeet(err, errno, "Cannot map arena chunk");
+			return nil;
+		}
+	} else {
+		chunk = nalloc(size, err);
+		catch(err) {
+			return nil;
+		}
+	}
+
+	chunk->size = size;
+	neat(err);
+	return chunk;
+}
+
+static void chunk_free(narena_t *arena, struct _neo_narena_chunk *chunk)
+{
+	if (arena->_flags & NARENA_MMAP)
+		munmap(chunk, chunk->size);
+	else
+		nfree(chunk);
+}
+
+/** Make `chunk` the current one that new objects are allocated from. */
+static void chunk_use(narena_t *arena, struct _neo_narena_chunk *chunk)
+{
+	chunk->next = arena->_chunks;
+	arena->_chunks = chunk;
+	arena->_pos = (u8 *)chunk + CHUNK_HEADER_SIZE;
+	arena->_end = (u8 *)chunk + chunk->size;
+}
+
+static void narena_destroy(narena_t *arena)
+{
+	struct _neo_narena_chunk *chunk = arena->_chunks;
+	while (chunk != nil) {
+		struct _neo_narena_chunk *next = chunk->next;
+		chunk_free(arena, chunk);
+		chunk = next;
+	}
+	nfree(arena);
+}
+
+narena_t *narena_create(usize chunk_size, u32 flags, error *err)
+{
+	if ((flags & ~NARENA_MMAP) != 0) {
+		yeet(err, EINVAL, "Unknown arena flags");
+		return nil;
+	}
+	if (chunk_size == 0)
+		chunk_size = NARENA_DEFAULT_CHUNK_SIZE;
+	chunk_size = nmax(chunk_size, 2 * CHUNK_HEADER_SIZE);
+
+	narena_t *arena = nalloc(sizeof(*arena), err);
+	catch(err) {
+		return nil;
+	}
+
+	arena->_flags = flags;
+	arena->_chunk_size = chunk_size;
+	arena->_chunks = nil;
+
+	struct _neo_narena_chunk *chunk = chunk_alloc(arena, chunk_size, err);
+	catch(err) {
+		nfree(arena);
+		return nil;
+	}
+	chunk_use(arena, chunk);
+
+	nref_init(arena, narena_destroy);
+	return arena;
+}
+
+void *narena_alloc(narena_t *arena, usize size, error *err)
+{
+	if (arena == nil) {
+		yeet(err, EFAULT, "Arena is nil");
+		return nil;
+	}
+	if (size == 0) {
+		yeet(err, EINVAL, "Requested memory size is 0");
+		return nil;
+	}
+	/* neither the alignment nor the dedicated chunk's header may overflow */
+	if (size > (usize)-1 - CHUNK_HEADER_SIZE - NARENA_ALIGN) {
+		yeet(err, ERANGE, "Requested memory size is too large");
+		return nil;
+	}
+
+	size = align_up(size);
+	if (size > (usize)(arena->_end - arena->_pos)) {
+		/*
+		 * Objects that are too large for a regular chunk get a
+		 * dedicated one.  We still switch to it, which wastes the
+		 * rest of the previous chunk, but that's fine because this
+		 * should be rare anyway.
+		 */
+		usize chunk_size = nmax(arena->_chunk_size, CHUNK_HEADER_SIZE + size);
+		struct _neo_narena_chunk *chunk = chunk_alloc(arena, chunk_size, err);
+		catch(err) {
+			return nil;
+		}
+		chunk_use(arena, chunk);
+	}
+
+	void *ptr = arena->_pos;
+	arena->_pos += size;
+
+	neat(err);
+	return ptr;
+}
+
+void narena_reset(narena_t *arena)
+{
+	if (arena == nil)
+		return;
+
+	struct _neo_narena_chunk *keep = arena->_chunks;
+	struct _neo_narena_chunk *chunk = keep->next;
+	while (chunk != nil) {
+		struct _neo_narena_chunk *next = chunk->next;
+		chunk_free(arena, chunk);
+		chunk = next;
+	}
+
+	arena->_chunks = nil;
+	chunk_use(arena, keep);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
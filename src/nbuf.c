@@ -7,18 +7,32 @@
 #include "neo/_error.h"
 #include "neo/_nalloc.h"
 #include "neo/_nref.h"
+#include "neo/_nstr.h"
 #include "neo/_stddef.h"
 #include "neo/_types.h"
+#include "neo/narena.h"
+#include "neo/nhash.h"
 
 static void nbuf_destroy(struct _neo_nbuf *buf)
 {
-	if (buf->_borrow != nil)
-		_neo_nput(buf->_borrow);
-
 	nfree(buf);
 }
 
-nbuf_t *nbuf_create(usize size, error *err)
+/** for buffers that only consist of the header and borrow their data */
+static void nbuf_destroy_borrowed(struct _neo_nbuf *buf)
+{
+	_neo_nput(buf->_borrow);
+	npool_free(buf, sizeof(*buf));
+}
+
+/** arena buffers are released along with their arena, see narena.c */
+static void nbuf_destroy_arena(struct _neo_nbuf *buf)
+{
+	(void)buf;
+}
+
+/** if `arena` is `nil`, the buffer is allocated with nalloc() */
+static nbuf_t *nbuf_create_unsafe(narena_t *arena, usize size, error *err)
 {
 	if (size == 0) {
 		yeet(err, ERANGE, "Cannot create zero-size buffer");
@@ -29,7 +43,11 @@ nbuf_t *nbuf_create(usize size, error *err)
 	 * Just like with strings, we allocate 4 extra bytes.
 	 * The buffer functions depend on this behavior, don't change.
 	 */
-	struct _neo_nbuf *buf = nalloc(sizeof(*buf) + size + 4, err);
+	struct _neo_nbuf *buf;
+	if (arena == nil)
+		buf = nalloc(sizeof(*buf) + size + 4, err);
+	else
+		buf = narena_alloc(arena, sizeof(*buf) + size + 4, err);
 	catch(err) {
 		return nil;
 	}
@@ -41,30 +59,64 @@ nbuf_t *nbuf_create(usize size, error *err)
 	buf->_size = size;
 	buf->_data = data;
 	buf->_borrow = nil;
-	nref_init(buf, nbuf_destroy);
+	buf->_hash = 0;
+	if (arena == nil)
+		nref_init(buf, nbuf_destroy);
+	else
+		nref_init(buf, nbuf_destroy_arena);
 	neat(err);
 	return buf;
 }
 
-nbuf_t *nbuf_from(const void *data, usize len, error *err)
+static nbuf_t *nbuf_from_unsafe(narena_t *arena, const void *data, usize len, error *err)
 {
 	if (data == nil) {
 		yeet(err, EFAULT, "Data is nil");
 		return nil;
 	}
 
-	struct _neo_nbuf *buf = nbuf_create(len, err);
+	struct _neo_nbuf *buf = nbuf_create_unsafe(arena, len, err);
 	catch(err) {
 		return nil;
 	}
 
 	byte *buf_data = (byte *)buf + sizeof(*buf);
 	memcpy(buf_data, data, len);
-	/* _data field already filled by nbuf_create */
+	/* _data field already filled by nbuf_create_unsafe */
 
 	return buf;
 }
 
+nbuf_t *nbuf_create(usize size, error *err)
+{
+	return nbuf_create_unsafe(nil, size, err);
+}
+
+nbuf_t *nbuf_create_in(narena_t *arena, usize size, error *err)
+{
+	if (arena == nil) {
+		yeet(err, EFAULT, "Arena is nil");
+		return nil;
+	}
+
+	return nbuf_create_unsafe(arena, size, err);
+}
+
+nbuf_t *nbuf_from(const void *data, usize len, error *err)
+{
+	return nbuf_from_unsafe(nil, data, len, err);
+}
+
+nbuf_t *nbuf_from_in(narena_t *arena, const void *restrict data, usize size, error *err)
+{
+	if (arena == nil) {
+		yeet(err, EFAULT, "Arena is nil");
+		return nil;
+	}
+
+	return nbuf_from_unsafe(arena, data, size, err);
+}
+
 nbuf_t *nbuf_from_str(const char *s, error *err)
 {
 	if (s == nil) {
@@ -83,7 +135,22 @@ nbuf_t *nbuf_from_nstr(nstr_t *s, error *err)
 		return nil;
 	}
 
-	nbuf_t *buf = nalloc(sizeof(*buf), err);
+	/*
+	 * Buffers created from strings include the NUL terminators.  Slices
+	 * don't have any, so we have to make a padded copy in that case.
+	 */
+	if (!nstr_is_terminated(s)) {
+		nbuf_t *copy = nbuf_create_unsafe(nil, s->_size, err);
+		catch(err) {
+			return nil;
+		}
+		byte *data = (byte *)copy->_data;
+		memcpy(data, s->_data, _neo_nstr_size(s));
+		memset(data + _neo_nstr_size(s), 0, 4);
+		return copy;
+	}
+
+	nbuf_t *buf = npool_alloc(sizeof(*buf), err);
 	catch(err) {
 		return nil;
 	}
@@ -92,7 +159,8 @@ nbuf_t *nbuf_from_nstr(nstr_t *s, error *err)
 	buf->_size = s->_size;
 	buf->_borrow = &s->__neo_nref;
 	buf->_data = (const byte *)s->_data;
-	nref_init(buf, nbuf_destroy);
+	buf->_hash = 0;
+	nref_init(buf, nbuf_destroy_borrowed);
 
 	return buf;
 }
@@ -104,7 +172,7 @@ nbuf_t *nbuf_clone(nbuf_t *buf, error *err)
 		return nil;
 	}
 
-	nbuf_t *clone = nalloc(sizeof(*clone), err);
+	nbuf_t *clone = npool_alloc(sizeof(*clone), err);
 	catch(err) {
 		return nil;
 	}
@@ -114,11 +182,45 @@ nbuf_t *nbuf_clone(nbuf_t *buf, error *err)
 	clone->_size = buf->_size;
 	clone->_borrow = &buf->__neo_nref;
 	clone->_data = buf->_data;
-	nref_init(clone, nbuf_destroy);
+	clone->_hash = __atomic_load_n(&buf->_hash, __ATOMIC_RELAXED);
+	nref_init(clone, nbuf_destroy_borrowed);
 
 	return clone;
 }
 
+nbuf_t *nbuf_slice(nbuf_t *buf, usize offset, usize len, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "Source buffer is nil");
+		return nil;
+	}
+	if (len == 0) {
+		yeet(err, ERANGE, "Cannot create zero-size buffer");
+		return nil;
+	}
+	if (offset > nlen(buf) || len > nlen(buf) - offset) {
+		yeet(err, ERANGE, "Slice out of bounds");
+		return nil;
+	}
+
+	nbuf_t *slice = npool_alloc(sizeof(*slice), err);
+	catch(err) {
+		return nil;
+	}
+
+	/* borrow from the owner of the memory directly to avoid long chains */
+	nref_t *owner = buf->_borrow != nil ? buf->_borrow : &buf->__neo_nref;
+	_neo_nget(owner);
+
+	slice->_size = len;
+	slice->_borrow = owner;
+	slice->_data = buf->_data + offset;
+	slice->_hash = 0;
+	nref_init(slice, nbuf_destroy_borrowed);
+
+	return slice;
+}
+
 int nbuf_cmp(const nbuf_t *buf1, const nbuf_t *buf2, error *err)
 {
 	if (buf1 == nil) {
@@ -135,15 +237,65 @@ int nbuf_cmp(const nbuf_t *buf1, const nbuf_t *buf2, error *err)
 
 	neat(err);
 
-	if (buf1->_data == buf2->_data)
+	usize size1 = nlen(buf1);
+	usize size2 = nlen(buf2);
+
+	if (buf1->_data == buf2->_data && size1 == size2)
 		return 0;
 
 	/*
-	 * Extra byte because the two buffers might be of different size
-	 * (one of the reasons nbuf_create() allocates 4 bytes more than needed)
+	 * If one buffer is a prefix of the other one, the shorter one is less.
+	 * We can't just compare one extra byte and rely on the padding added
+	 * by nbuf_create() here, because the other buffer might contain NUL
+	 * bytes itself and buffers created by nbuf_from_nstr() don't have any
+	 * padding beyond the string's own terminator.
+	 */
+	int diff = memcmp(&buf1->_data[0], &buf2->_data[0], nmin(size1, size2));
+	if (diff != 0)
+		return diff;
+	return (size1 > size2) - (size1 < size2);
+}
+
+/*
+ * The seed is the same for all buffers, because the whole point of memoizing
+ * the hash is to reuse it across unrelated tables.  Hash tables mix it with
+ * their own per-table seed before use.
+ */
+static u64 nbuf_hash_seed;
+
+u64 nbuf_hash(const nbuf_t *buf, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "Buffer is nil");
+		return 0;
+	}
+
+	neat(err);
+
+	u64 hash = __atomic_load_n(&buf->_hash, __ATOMIC_RELAXED);
+	if (hash != 0)
+		return hash;
+
+	u64 seed = __atomic_load_n(&nbuf_hash_seed, __ATOMIC_RELAXED);
+	if (seed == 0) {
+		u64 expected = 0;
+		seed = nhash_random_seed() | 1;
+		if (!__atomic_compare_exchange_n(&nbuf_hash_seed, &expected, seed, false,
+						 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			seed = expected;
+	}
+
+	/* 0 means "not computed yet", so we have to avoid that one */
+	hash = nhash(buf->_data, nlen(buf), seed);
+	if (hash == 0)
+		hash = 1;
+
+	/*
+	 * Racing threads compute the same value, so it doesn't matter who wins.
+	 * The buffer is logically const, the cache is an implementation detail.
 	 */
-	usize maxbytes = nmin(nlen(buf1), nlen(buf2)) + 1;
-	return memcmp(&buf1->_data[0], &buf2->_data[0], maxbytes);
+	__atomic_store_n(&((nbuf_t *)buf)->_hash, hash, __ATOMIC_RELAXED);
+	return hash;
 }
 
 /*
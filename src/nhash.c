@@ -0,0 +1,294 @@
+/** See the end of this file for copyright and license terms. */
+
+/*
+ * nhash() is based on wyhash by Wang Yi, which is released into the public
+ * domain (The Unlicense).  For the original, see
+ * <https://github.com/wangyi-fudan/wyhash/blob/ea3b25e1aef55d90f707c3a292eeb9162e2615d8/wyhash.h>
+ *
+ * nsiphash() is a straightforward implementation of SipHash-2-4 as described
+ * in "SipHash: a fast short-input PRF" by Jean-Philippe Aumasson and Daniel
+ * J. Bernstein, see <https://www.aumasson.jp/siphash/siphash.pdf>.
+ */
+
+/* O_CLOEXEC, clock_gettime */
+#define _POSIX_C_SOURCE 200809L
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "neo/_stddef.h"
+#include "neo/_toolchain.h"
+#include "neo/_types.h"
+#include "neo/nhash.h"
+
+/*
+ * Unaligned little endian loads.  memcpy is optimized away by the compiler
+ * on any architecture that supports unaligned access.
+ */
+
+static inline u64 read64(const u8 *p)
+{
+	u64 v;
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap64(v);
+#endif
+	return v;
+}
+
+static inline u64 read32(const u8 *p)
+{
+	u32 v;
+	memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	v = __builtin_bswap32(v);
+#endif
+	return v;
+}
+
+/** read 1 to 3 bytes */
+static inline u64 read_small(const u8 *p, usize size)
+{
+	return ((u64)p[0] << 16) | ((u64)p[size >> 1] << 8) | p[size - 1];
+}
+
+/** 64x64 -> 128 bit multiplication, returns the low half in a and high in b */
+static inline void mum(u64 *a, u64 *b)
+{
+#ifdef __SIZEOF_INT128__
+	__uint128_t r = (__uint128_t)*a * *b;
+	*a = (u64)r;
+	*b = (u64)(r >> 64);
+#else
+	u64 ha = *a >> 32, hb = *b >> 32, la = (u32)*a, lb = (u32)*b;
+	u64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	u64 t = rl + (rm0 << 32);
+	u64 c = t < rl;
+	u64 lo = t + (rm1 << 32);
+	c += lo < t;
+	u64 hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	*a = lo;
+	*b = hi;
+#endif
+}
+
+static inline u64 mix(u64 a, u64 b)
+{
+	mum(&a, &b);
+	return a ^ b;
+}
+
+static const u64 wyp[4] = {
+	0xa0761d6478bd642full, 0xe7037ed1a0b428dbull,
+	0x8ebc6af09c88c6e3ull, 0x589965cc75374cc3ull,
+};
+
+u64 nhash(const void *restrict data, usize size, u64 seed)
+{
+	const u8 *p = data;
+	u64 a, b;
+
+	seed ^= mix(seed ^ wyp[0], wyp[1]);
+
+	if (size <= 16) {
+		if (size >= 4) {
+			/* two (possibly overlapping) 4-byte reads per half */
+			usize off = (size >> 3) << 2;
+			a = (read32(p) << 32) | read32(p + off);
+			b = (read32(p + size - 4) << 32) | read32(p + size - 4 - off);
+		} else if (size > 0) {
+			a = read_small(p, size);
+			b = 0;
+		} else {
+			a = b = 0;
+		}
+	} else {
+		usize i = size;
+		if (i > 48) {
+			/* three independent lanes of 16 bytes each */
+			u64 seed1 = seed, seed2 = seed;
+			do {
+				seed = mix(read64(p) ^ wyp[1], read64(p + 8) ^ seed);
+				seed1 = mix(read64(p + 16) ^ wyp[2], read64(p + 24) ^ seed1);
+				seed2 = mix(read64(p + 32) ^ wyp[3], read64(p + 40) ^ seed2);
+				p += 48;
+				i -= 48;
+			} while (i > 48);
+			seed ^= seed1 ^ seed2;
+		}
+		while (i > 16) {
+			seed = mix(read64(p) ^ wyp[1], read64(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		/* the last 16 bytes, possibly overlapping with the previous ones */
+		a = read64(p + i - 16);
+		b = read64(p + i - 8);
+	}
+
+	a ^= wyp[1];
+	b ^= seed;
+	mum(&a, &b);
+	return mix(a ^ wyp[0] ^ size, b ^ wyp[1]);
+}
+
+#define rotl(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+#define sipround(v0, v1, v2, v3) ({					\
+	v0 += v1; v1 = rotl(v1, 13); v1 ^= v0; v0 = rotl(v0, 32);	\
+	v2 += v3; v3 = rotl(v3, 16); v3 ^= v2;				\
+	v0 += v3; v3 = rotl(v3, 21); v3 ^= v0;				\
+	v2 += v1; v1 = rotl(v1, 17); v1 ^= v2; v2 = rotl(v2, 32);	\
+})
+
+u64 nsiphash(const void *restrict data, usize size, const struct nhash_key *key)
+{
+	const u8 *p = data;
+	u64 v0 = key->k0 ^ 0x736f6d6570736575ull;
+	u64 v1 = key->k1 ^ 0x646f72616e646f6dull;
+	u64 v2 = key->k0 ^ 0x6c7967656e657261ull;
+	u64 v3 = key->k1 ^ 0x7465646279746573ull;
+
+	const u8 *end = p + (size & ~(usize)7);
+	for (; p != end; p += 8) {
+		u64 m = read64(p);
+		v3 ^= m;
+		sipround(v0, v1, v2, v3);
+		sipround(v0, v1, v2, v3);
+		v0 ^= m;
+	}
+
+	/* the last block contains the remaining bytes and the size's LSB */
+	u64 m = (u64)size << 56;
+	switch (size & 7) {
+	case 7:
+		m |= (u64)p[6] << 48;
+		/* fall through */
+	case 6:
+		m |= (u64)p[5] << 40;
+		/* fall through */
+	case 5:
+		m |= (u64)p[4] << 32;
+		/* fall through */
+	case 4:
+		m |= (u64)p[3] << 24;
+		/* fall through */
+	case 3:
+		m |= (u64)p[2] << 16;
+		/* fall through */
+	case 2:
+		m |= (u64)p[1] << 8;
+		/* fall through */
+	case 1:
+		m |= (u64)p[0];
+		break;
+	}
+	v3 ^= m;
+	sipround(v0, v1, v2, v3);
+	sipround(v0, v1, v2, v3);
+	v0 ^= m;
+
+	v2 ^= 0xff;
+	sipround(v0, v1, v2, v3);
+	sipround(v0, v1, v2, v3);
+	sipround(v0, v1, v2, v3);
+	sipround(v0, v1, v2, v3);
+
+	return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/*
+ * Random seeds are generated by running a global counter through splitmix64.
+ * The counter is initialized from /dev/urandom on startup, so seeds are both
+ * unpredictable and unique without needing a system call every time.
+ *
+ * splitmix64 is invertible though, so anyone who learns a single seed can
+ * compute all others.  That's fine for nhash(), which isn't meant to resist
+ * attacks anyway, but not for the keys of nsiphash().  Those are the output
+ * of SipHash itself over a separate counter, keyed with a separate secret
+ * from /dev/urandom.  SipHash is a PRF, so knowing any number of keys (or
+ * seeds) doesn't reveal anything about the others.
+ */
+
+static _Atomic u64 seed_state;
+static _Atomic u64 key_counter;
+static struct nhash_key key_secret;
+
+static inline u64 splitmix64(u64 x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ull;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebull;
+	x ^= x >> 31;
+	return x;
+}
+
+u64 nhash_random_seed(void)
+{
+	return splitmix64(atomic_fetch_add(&seed_state, 0x9e3779b97f4a7c15ull));
+}
+
+struct nhash_key nhash_random_key(void)
+{
+	u64 counter = atomic_fetch_add(&key_counter, 2);
+	u64 in0 = counter;
+	u64 in1 = counter + 1;
+	struct nhash_key key = {
+		.k0 = nsiphash(&in0, sizeof(in0), &key_secret),
+		.k1 = nsiphash(&in1, sizeof(in1), &key_secret),
+	};
+	return key;
+}
+
+/** fill `buf` from /dev/urandom, returns false if that didn't work */
+static bool read_urandom(void *buf, usize size)
+{
+	ssize_t ret = -1;
+
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		ret = read(fd, buf, size);
+		close(fd);
+	}
+
+	return ret == (ssize_t)size;
+}
+
+static void nhash_init(void)
+{
+	u64 state = 0;
+	struct nhash_key secret;
+
+	if (!read_urandom(&state, sizeof(state))
+	    || !read_urandom(&secret, sizeof(secret))) {
+		/* better than nothing */
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		state = (u64)ts.tv_nsec ^ ((u64)ts.tv_sec << 32)
+			^ (u64)getpid() ^ (u64)(usize)&state;
+		secret.k0 = splitmix64(state ^ 0x736f6d6570736575ull);
+		secret.k1 = splitmix64(secret.k0 ^ 0x646f72616e646f6dull);
+	}
+
+	key_secret = secret;
+	atomic_init(&key_counter, 0);
+	atomic_init(&seed_state, state);
+}
+__neo_init(nhash_init);
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,294 @@
+/** See the end of this file for copyright and license terms. */
+
+/*
+ * Small objects are served from a fixed set of size classes.  Every thread
+ * has its own free list for each class, so the common case of allocating
+ * and releasing objects doesn't need any locks or atomics at all.  When a
+ * thread's free list runs empty, it grabs a batch of objects from the global
+ * depot for that class, which in turn carves them out of large slabs that are
+ * allocated with nalloc().  Likewise, if a free list grows too long, a batch
+ * is returned to the depot so that memory freed by one thread can be reused
+ * by others.  Threads hand all of their cached objects back when they exit.
+ *
+ * Slabs are never released, so the pool only ever grows up to the peak number
+ * of objects that were alive at the same time.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+
+#include "neo/_error.h"
+#include "neo/_nalloc.h"
+#include "neo/_stddef.h"
+#include "neo/_toolchain.h"
+#include "neo/_types.h"
+
+/*
+ * Pooled memory is invisible to AddressSanitizer, so use-after-free bugs and
+ * leaks would go unnoticed.  We'd rather have it catch those, so just forward
+ * everything to nalloc() and nfree() in that case.
+ */
+#if defined(__SANITIZE_ADDRESS__)
+#	define NPOOL_PASSTHROUGH
+#elif defined(__has_feature)
+#	if __has_feature(address_sanitizer)
+#		define NPOOL_PASSTHROUGH
+#	endif
+#endif
+
+#define NPOOL_CLASSES		8
+#define NPOOL_MAX_SIZE		256
+/** Size of the chunks we carve objects out of */
+#define NPOOL_SLAB_SIZE		(64 * 1024)
+/** Number of objects moved between thread caches and the depot at once */
+#define NPOOL_BATCH		32
+
+#ifndef NPOOL_PASSTHROUGH
+
+static const u16 class_sizes[NPOOL_CLASSES] = {
+	16, 32, 48, 64, 96, 128, 192, 256,
+};
+
+/** Size class index for each multiple of 16 bytes, rounded up */
+static const u8 class_index[NPOOL_MAX_SIZE / 16 + 1] = {
+	0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7,
+};
+
+static inline unsigned int size_class(usize size)
+{
+	return class_index[(size + 15) / 16];
+}
+
+struct npool_obj {
+	struct npool_obj *next;
+};
+
+struct npool_slab {
+	struct npool_slab *next;
+};
+
+struct npool_depot {
+	pthread_mutex_t lock;
+	struct npool_obj *free;
+	/** the unused rest of the most recently allocated slab */
+	u8 *slab_pos;
+	u8 *slab_end;
+	/** all slabs, just so they remain reachable for leak checkers */
+	struct npool_slab *slabs;
+};
+
+static struct npool_depot depots[NPOOL_CLASSES] = {
+	[0 ... NPOOL_CLASSES - 1] = {
+		.lock = PTHREAD_MUTEX_INITIALIZER,
+	},
+};
+
+struct npool_cache {
+	struct npool_obj *free;
+	u32 len;
+};
+
+enum caches_state {
+	CACHES_UNREGISTERED = 0,
+	CACHES_REGISTERED,
+	/**
+	 * The destructor has already run, but destructors of other libraries'
+	 * thread specific data might still use the pool.  Objects must not
+	 * stay in the cache anymore because nothing would return them.
+	 */
+	CACHES_RELEASED,
+};
+
+static _Thread_local struct npool_cache caches[NPOOL_CLASSES];
+static _Thread_local enum caches_state caches_state;
+static pthread_key_t caches_key;
+static bool caches_key_valid;
+static pthread_once_t caches_key_once = PTHREAD_ONCE_INIT;
+
+/** Move up to `count` objects from a free list to the depot. */
+static void depot_put(struct npool_depot *depot, struct npool_cache *cache, u32 count)
+{
+	if (cache->free == nil)
+		return;
+
+	struct npool_obj *first = cache->free;
+	struct npool_obj *last = first;
+	u32 moved = 1;
+	while (moved < count && last->next != nil) {
+		last = last->next;
+		moved++;
+	}
+	cache->free = last->next;
+	cache->len -= moved;
+
+	pthread_mutex_lock(&depot->lock);
+	last->next = depot->free;
+	depot->free = first;
+	pthread_mutex_unlock(&depot->lock);
+}
+
+/** Refill an empty thread cache with a batch of objects from the depot. */
+static void depot_get(struct npool_depot *depot, struct npool_cache *cache,
+		      usize obj_size, error *err)
+{
+	pthread_mutex_lock(&depot->lock);
+
+	while (cache->len < NPOOL_BATCH && depot->free != nil) {
+		struct npool_obj *obj = depot->free;
+		depot->free = obj->next;
+		obj->next = cache->free;
+		cache->free = obj;
+		cache->len++;
+	}
+
+	if (cache->len == 0) {
+		if (depot->slab_pos == depot->slab_end) {
+			/*
+			 * slabs are shared by all threads, so they must not
+			 * come from the calling thread's scoped backend
+			 */
+			const struct nalloc_backend *scope = nalloc_scope_enter(nil);
+			struct npool_slab *slab = nalloc(NPOOL_SLAB_SIZE, err);
+			nalloc_scope_exit(scope);
+			catch(err) {
+				pthread_mutex_unlock(&depot->lock);
+				return;
+			}
+			/* slabs are never released, so they aren't leaks either */
+			_neo_nalloc_permanent(slab);
+			slab->next = depot->slabs;
+			depot->slabs = slab;
+			/* the slab header takes up the first object slot */
+			depot->slab_pos = (u8 *)slab + nmax(obj_size, sizeof(*slab));
+			depot->slab_end = depot->slab_pos
+				+ (NPOOL_SLAB_SIZE - nmax(obj_size, sizeof(*slab)))
+				/ obj_size * obj_size;
+		}
+
+		while (cache->len < NPOOL_BATCH && depot->slab_pos != depot->slab_end) {
+			struct npool_obj *obj = (struct npool_obj *)depot->slab_pos;
+			depot->slab_pos += obj_size;
+			obj->next = cache->free;
+			cache->free = obj;
+			cache->len++;
+		}
+	}
+
+	pthread_mutex_unlock(&depot->lock);
+	neat(err);
+}
+
+static void caches_release(void *ptr)
+{
+	struct npool_cache *thread_caches = ptr;
+	for (unsigned int i = 0; i < NPOOL_CLASSES; i++)
+		depot_put(&depots[i], &thread_caches[i], thread_caches[i].len);
+	caches_state = CACHES_RELEASED;
+}
+
+static void caches_key_create(void)
+{
+	caches_key_valid = pthread_key_create(&caches_key, caches_release) == 0;
+}
+
+/*
+ * Constructors of other libraries (and our own) might allocate from the pool
+ * before npool_init() runs, so the key is created on first use.  The
+ * constructor just makes sure that doesn't happen later in some hot path.
+ */
+static void npool_init(void)
+{
+	pthread_once(&caches_key_once, caches_key_create);
+}
+__neo_init(npool_init);
+
+static inline struct npool_cache *cache_get(unsigned int class)
+{
+	if (caches_state == CACHES_UNREGISTERED) {
+		/* make sure the cache is flushed when the thread exits */
+		pthread_once(&caches_key_once, caches_key_create);
+		if (caches_key_valid)
+			pthread_setspecific(caches_key, caches);
+		caches_state = CACHES_REGISTERED;
+	}
+	return &caches[class];
+}
+
+/** return everything to the depot if the thread is about to exit */
+static inline void cache_flush_released(unsigned int class, struct npool_cache *cache)
+{
+	if (caches_state == CACHES_RELEASED)
+		depot_put(&depots[class], cache, cache->len);
+}
+
+#endif /* NPOOL_PASSTHROUGH */
+
+void *npool_alloc(usize size, error *err)
+{
+#ifndef NPOOL_PASSTHROUGH
+	if (size == 0) {
+		yeet(err, EINVAL, "Requested memory size is 0");
+		return nil;
+	}
+	if (size > NPOOL_MAX_SIZE)
+		return nalloc(size, err);
+
+	unsigned int class = size_class(size);
+	struct npool_cache *cache = cache_get(class);
+	if (cache->free == nil) {
+		depot_get(&depots[class], cache, class_sizes[class], err);
+		catch(err) {
+			return nil;
+		}
+	}
+
+	struct npool_obj *obj = cache->free;
+	cache->free = obj->next;
+	cache->len--;
+	cache_flush_released(class, cache);
+
+	neat(err);
+	return obj;
+#else
+	return nalloc(size, err);
+#endif
+}
+
+void npool_free(void *ptr, usize size)
+{
+#ifndef NPOOL_PASSTHROUGH
+	if (ptr == nil)
+		return;
+	if (size > NPOOL_MAX_SIZE) {
+		nfree(ptr);
+		return;
+	}
+
+	unsigned int class = size_class(size);
+	struct npool_cache *cache = cache_get(class);
+	struct npool_obj *obj = ptr;
+	obj->next = cache->free;
+	cache->free = obj;
+	cache->len++;
+
+	if (cache->len >= 2 * NPOOL_BATCH)
+		depot_put(&depots[class], cache, NPOOL_BATCH);
+	cache_flush_released(class, cache);
+#else
+	(void)size;
+	nfree(ptr);
+#endif
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -2,32 +2,427 @@
 
 #include <stdatomic.h>
 
+#include "neo/_error.h"
+#include "neo/_nalloc.h"
 #include "neo/_nref.h"
+#include "neo/_stddef.h"
 #include "neo/_types.h"
 
+/*
+ * Biased reference counting, loosely based on "Biased Reference Counting:
+ * Minimizing Atomic Operations in Garbage Collection" by Jiho Choi, Thomas
+ * Shull and Josep Torrellas (PACT '18).  The owning thread counts its own
+ * references in the non-atomic _local field of the extension block, and all
+ * other threads use the atomic _count.  While the owner holds any references
+ * at all, _count is offset by BIAS so that other threads dropping references
+ * they got from the owner can't make it reach zero.  When _local drops to
+ * zero, the owner gives up ownership and subtracts BIAS, which turns the
+ * structure into a regular atomically counted one.
+ *
+ * References can also be taken by the owner and dropped by another thread,
+ * which means _local might never reach zero.  The owner therefore checks
+ * the sum of both counters whenever it drops a reference.  If that is zero,
+ * nobody else holds a reference that they could pass on, so it is safe to
+ * destroy the structure right away.  Other threads can't do the same because
+ * they can't read _local, which is why the paper uses a queue for merging
+ * and we require the owner to call nref_unbias() instead.
+ */
+#define BIAS 0x10000000
+
+/* C++ code uses std::atomic<int> for the count, see neo/_types.h */
+_Static_assert(sizeof(_Atomic int) == sizeof(int) && _Alignof(_Atomic int) == _Alignof(int)
+	       && ATOMIC_INT_LOCK_FREE == 2,
+	       "_Atomic int must be lock-free and have the layout of int");
+
+/* everything optional lives in struct _neo_nref_ext, see neo/_types.h */
+_Static_assert(sizeof(struct _neo_nref) <= 2 * sizeof(void *) + 2 * sizeof(int),
+	       "struct _neo_nref must not grow, put new fields in _neo_nref_ext");
+
+/* the address of this identifies the current thread, see thread_token() */
+static _Thread_local char thread_token_anchor;
+
+static inline usize thread_token(void)
+{
+	return (usize)&thread_token_anchor;
+}
+
+/*
+ * The extension block is only allocated for biased counts and weakly
+ * referenced objects.  Once installed, it stays until the object is destroyed.
+ * It is published with a release store (or CAS), so anyone who sees the
+ * pointer also sees its initialized contents.
+ */
+
+static inline struct _neo_nref_ext *ext_get(const struct _neo_nref *ref)
+{
+	return __atomic_load_n(&ref->_ext, __ATOMIC_ACQUIRE);
+}
+
+/** check whether the count is biased towards the calling thread */
+static inline struct _neo_nref_ext *ext_owned(const struct _neo_nref *ref)
+{
+	struct _neo_nref_ext *ext = ext_get(ref);
+	if (ext != nil && __atomic_load_n(&ext->_owner, __ATOMIC_RELAXED) == thread_token())
+		return ext;
+	return nil;
+}
+
+static struct _neo_nref_ext *ext_alloc(usize owner, int local, error *err)
+{
+	struct _neo_nref_ext *ext = npool_alloc(sizeof(*ext), err);
+	catch(err) {
+		return nil;
+	}
+	ext->_owner = owner;
+	ext->_local = local;
+	ext->_weak = nil;
+	return ext;
+}
+
+/** get the extension block, or install a new unbiased one if there is none */
+static struct _neo_nref_ext *ext_install(struct _neo_nref *ref, error *err)
+{
+	struct _neo_nref_ext *ext = ext_get(ref);
+	if (ext != nil) {
+		neat(err);
+		return ext;
+	}
+
+	ext = ext_alloc(0, 0, err);
+	catch(err) {
+		return nil;
+	}
+
+	struct _neo_nref_ext *expected = nil;
+	if (!__atomic_compare_exchange_n(&ref->_ext, &expected, ext, false,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		/* another thread was faster */
+		npool_free(ext, sizeof(*ext));
+		ext = expected;
+	}
+	return ext;
+}
+
+/*
+ * Weak references are a separately allocated control block that the object
+ * holds a reference to.  When the object is about to be destroyed, its
+ * control block's target is cleared while holding the lock, and upgrading
+ * only increments the count under the same lock and if it isn't zero yet.
+ * So once the count has reached zero, nobody can bring it back to life, and
+ * the memory can't be released while someone is in the middle of trying.
+ */
+
+static inline void weak_lock(nweak_t *weak)
+{
+	/* the lock is only ever held for a couple of instructions */
+	while (__atomic_test_and_set(&weak->_lock, __ATOMIC_ACQUIRE)) {
+		while (__atomic_load_n(&weak->_lock, __ATOMIC_RELAXED))
+			continue;
+	}
+}
+
+static inline void weak_unlock(nweak_t *weak)
+{
+	__atomic_clear(&weak->_lock, __ATOMIC_RELEASE);
+}
+
+static void weak_destroy(nweak_t *weak)
+{
+	npool_free(weak, sizeof(*weak));
+}
+
+/*
+ * Deferred release.  Structures in the reclamation queues are dead already,
+ * so the space of their extension block pointer (which is released before
+ * they are queued) is reused to link them together.  Every thread has its
+ * own queue, and the shared one is a lock-free stack of entire queues that
+ * were handed off by nref_reclaim_handoff().
+ */
+
+struct reclaim_queue {
+	struct _neo_nref *head;
+	struct _neo_nref *tail;
+};
+
+static _Thread_local struct reclaim_queue local_queue;
+static _Thread_local bool defer_release;
+
+/* only head is used, tail of the first batch points to the next batch */
+static struct _neo_nref *shared_queue;
+
+static inline void call_destroy(struct _neo_nref *ref)
+{
+	void *container = (void *)ref - ref->_offset;
+	ref->_destroy(container);
+}
+
+static inline void destroy(struct _neo_nref *ref)
+{
+	struct _neo_nref_ext *ext = ext_get(ref);
+	if (ext != nil) {
+		nweak_t *weak = __atomic_load_n(&ext->_weak, __ATOMIC_ACQUIRE);
+		if (weak != nil) {
+			weak_lock(weak);
+			weak->_target = nil;
+			weak_unlock(weak);
+			nput(weak);
+		}
+		npool_free(ext, sizeof(*ext));
+		ref->_ext = nil;
+	}
+
+	if (defer_release) {
+		ref->_next_deferred = nil;
+		if (local_queue.tail != nil)
+			local_queue.tail->_next_deferred = ref;
+		else
+			local_queue.head = ref;
+		local_queue.tail = ref;
+	} else {
+		call_destroy(ref);
+	}
+}
+
+void nref_defer_release(bool enable)
+{
+	defer_release = enable;
+}
+
+usize nref_reclaim(usize max)
+{
+	usize count = 0;
+
+	while (local_queue.head != nil && (max == 0 || count < max)) {
+		struct _neo_nref *ref = local_queue.head;
+		local_queue.head = ref->_next_deferred;
+		if (local_queue.head == nil)
+			local_queue.tail = nil;
+		/* might append to the queue if deferred release is enabled */
+		call_destroy(ref);
+		count++;
+	}
+
+	return count;
+}
+
+void nref_reclaim_handoff(void)
+{
+	struct _neo_nref *head = local_queue.head;
+	struct _neo_nref *tail = local_queue.tail;
+	if (head == nil)
+		return;
+	local_queue.head = nil;
+	local_queue.tail = nil;
+
+	struct _neo_nref *old = __atomic_load_n(&shared_queue, __ATOMIC_RELAXED);
+	do {
+		tail->_next_deferred = old;
+	} while (!__atomic_compare_exchange_n(&shared_queue, &old, head, true,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+usize nref_reclaim_shared(void)
+{
+	usize count = 0;
+
+	/* take everything at once, so there is no ABA problem */
+	struct _neo_nref *ref = __atomic_exchange_n(&shared_queue, nil, __ATOMIC_ACQUIRE);
+	while (ref != nil) {
+		struct _neo_nref *next = ref->_next_deferred;
+		call_destroy(ref);
+		count++;
+		ref = next;
+	}
+
+	return count;
+}
+
 void _neo_nref_init(struct _neo_nref *ref, void (*destroy)(void *ptr), usize offset)
 {
 	ref->_destroy = destroy;
-	ref->_offset = offset;
+	ref->_offset = (u32)offset;
+	ref->_ext = nil;
 	atomic_init(&ref->_count, 1);
 }
 
+void _neo_nref_init_biased(struct _neo_nref *ref, void (*destroy)(void *ptr), usize offset)
+{
+	_neo_nref_init(ref, destroy, offset);
+
+	/* biasing is just an optimization, so we can live without it */
+	error err;
+	struct _neo_nref_ext *ext = ext_alloc(thread_token(), 1, &err);
+	catch(&err) {
+		errput(&err);
+		return;
+	}
+	ref->_ext = ext;
+	atomic_init(&ref->_count, BIAS);
+}
+
+void _neo_nref_unbias(struct _neo_nref *ref)
+{
+	struct _neo_nref_ext *ext = ext_owned(ref);
+	if (ext == nil)
+		return;
+
+	__atomic_store_n(&ext->_owner, 0, __ATOMIC_RELAXED);
+	int local = ext->_local;
+	ext->_local = 0;
+	int old = atomic_fetch_add(&ref->_count, local - BIAS);
+	if (old + local - BIAS == 0)
+		destroy(ref);
+}
+
+void _neo_nref_make_immortal(struct _neo_nref *ref)
+{
+	struct _neo_nref_ext *ext = ext_get(ref);
+	if (ext != nil)
+		__atomic_store_n(&ext->_owner, 0, __ATOMIC_RELAXED);
+	atomic_store_explicit(&ref->_count, _NEO_NREF_IMMORTAL, memory_order_relaxed);
+}
+
+int _neo_nref_count(const struct _neo_nref *ref)
+{
+	int count = atomic_load_explicit(&ref->_count, memory_order_relaxed);
+	/* only the owner may read _local, everybody else just gets a guess */
+	struct _neo_nref_ext *ext = ext_owned(ref);
+	if (ext != nil)
+		count += ext->_local - BIAS;
+	return count;
+}
+
 int _neo_nget(struct _neo_nref *ref)
 {
+	/*
+	 * Immortal objects might be in read-only memory, and even if they
+	 * aren't, not writing to them means the cache line can stay shared.
+	 */
+	int count = atomic_load_explicit(&ref->_count, memory_order_relaxed);
+	if (_neo_nref_is_immortal(count))
+		return count;
+
+	struct _neo_nref_ext *ext = ext_owned(ref);
+	if (ext != nil)
+		return ++ext->_local;
+
 	int old = atomic_fetch_add(&ref->_count, 1);
 	return old + 1;
 }
 
+/** drop a reference owned by the thread the count is biased towards */
+static int nput_biased(struct _neo_nref *ref, struct _neo_nref_ext *ext)
+{
+	int local = --ext->_local;
+
+	if (local != 0) {
+		/*
+		 * Setting the count to zero ensures nweak_upgrade() can't
+		 * resurrect the object between our check and destroying it.
+		 */
+		int shared = atomic_load_explicit(&ref->_count, memory_order_acquire);
+		while (local + shared - BIAS == 0) {
+			if (atomic_compare_exchange_weak(&ref->_count, &shared, 0)) {
+				destroy(ref);
+				return 0;
+			}
+		}
+		return local + shared - BIAS;
+	}
+
+	/* no other thread ever compares _owner to our token, so relaxed is fine */
+	__atomic_store_n(&ext->_owner, 0, __ATOMIC_RELAXED);
+	int old = atomic_fetch_sub(&ref->_count, BIAS);
+	if (old == BIAS)
+		destroy(ref);
+	return old - BIAS;
+}
+
 int _neo_nput(struct _neo_nref *ref)
 {
+	int count = atomic_load_explicit(&ref->_count, memory_order_relaxed);
+	if (_neo_nref_is_immortal(count))
+		return count;
+
+	struct _neo_nref_ext *ext = ext_owned(ref);
+	if (ext != nil)
+		return nput_biased(ref, ext);
+
 	int old = atomic_fetch_sub(&ref->_count, 1);
+	if (old == 1)
+		destroy(ref);
+	return old - 1;
+}
+
+nweak_t *_neo_nweak(struct _neo_nref *ref, error *err)
+{
+	struct _neo_nref_ext *ext = ext_get(ref);
+	nweak_t *weak = ext != nil ? __atomic_load_n(&ext->_weak, __ATOMIC_ACQUIRE) : nil;
+	if (weak != nil) {
+		nget(weak);
+		neat(err);
+		return weak;
+	}
 
-	if (old == 1) {
-		void *container = (void *)ref - ref->_offset;
-		ref->_destroy(container);
+	weak = npool_alloc(sizeof(*weak), err);
+	catch(err) {
+		return nil;
 	}
+	nref_init(weak, weak_destroy);
+	weak->_target = ref;
+	weak->_lock = false;
 
-	return old - 1;
+	/*
+	 * Immortal objects are never destroyed and might be read-only, so we
+	 * just hand out a control block that is never cleared.
+	 */
+	if (_neo_nref_is_immortal(atomic_load_explicit(&ref->_count, memory_order_relaxed))) {
+		neat(err);
+		return weak;
+	}
+
+	ext = ext_install(ref, err);
+	catch(err) {
+		npool_free(weak, sizeof(*weak));
+		return nil;
+	}
+
+	/* the object holds the initial reference, and the caller gets another */
+	nweak_t *expected = nil;
+	if (!__atomic_compare_exchange_n(&ext->_weak, &expected, weak, false,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		/* another thread was faster */
+		npool_free(weak, sizeof(*weak));
+		weak = expected;
+	}
+	nget(weak);
+
+	neat(err);
+	return weak;
+}
+
+void *nweak_upgrade(nweak_t *weak)
+{
+	if (weak == nil)
+		return nil;
+
+	weak_lock(weak);
+	nref_t *ref = weak->_target;
+	if (ref != nil) {
+		int count = atomic_load_explicit(&ref->_count, memory_order_relaxed);
+		while (!_neo_nref_is_immortal(count)) {
+			if (count == 0) {
+				/* the last nput() is waiting for our lock */
+				ref = nil;
+				break;
+			}
+			if (atomic_compare_exchange_weak(&ref->_count, &count, count + 1))
+				break;
+		}
+	}
+	weak_unlock(weak);
+
+	return ref != nil ? (void *)ref - ref->_offset : nil;
 }
 
 /*
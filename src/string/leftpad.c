@@ -19,31 +19,24 @@ static inline nstr_t *leftpad_unsafe(const nstr_t *s, usize len, nchar fillchr,
 	}
 
 	usize extra_chars = len - s->_len;
-	/*
-	 * This is actually three bytes larger than the actual size because neo
-	 * strings are terminated with four NUL characters rather than just one,
-	 * but that's okay because if we don't even have enough memory for three
-	 * extra bytes we are screwed anyway.
-	 */
-	usize size_now = s->_size;
-	usize size_after = size_now + (extra_chars * fillchr_size);
-	char *dest = nalloc(size_after, err);
+	usize s_size = _neo_nstr_size(s);
+	if (extra_chars > ((usize)-1 - s_size) / fillchr_size) {
+		yeet(err, ERANGE, "String is too long");
+		return nil;
+	}
+
+	nstr_t *padded = _neo_nstr_alloc(s_size + extra_chars * fillchr_size, len, err);
 	catch(err) {
-		return 0;
+		return nil;
 	}
 
-	char *pos = dest;
+	char *pos = (char *)padded->_data;
 	while (extra_chars-- > 0) {
 		for (int i = 0; i < fillchr_size; i++)
 			*pos++ = utf8_fillchr[i];
 	}
-	strcpy(pos, s->_data);
+	memcpy(pos, s->_data, s_size);
 
-	nstr_t *padded = nstr(dest, err);
-	catch(err) {
-		padded = nil;
-	}
-	nfree(dest);
 	return padded;
 }
 
@@ -59,6 +52,9 @@ nstr_t *leftpad(nstr_t *s, usize len, nchar fillchr, error *err)
 	if (len < nlen(s)) {
 		yeet(err, ERANGE, "String is longer than requested length");
 		padded = nil;
+	} else if (fillchr == '\0') {
+		yeet(err, EINVAL, "Cannot pad with NUL characters");
+		padded = nil;
 	} else if (nlen(s) == len) {
 		padded = nstrdup(s, err);
 	} else {
@@ -0,0 +1,517 @@
+/** See the end of this file for copyright and license terms. */
+
+/*
+ * Ropes are AVL trees whose leaves are windows into regular strings.  Nodes
+ * are immutable and refcounted, so every operation builds new nodes along
+ * the path it modifies and shares everything else with the original rope.
+ *
+ * Most internal helpers *consume* the references to the ropes they are passed,
+ * i.e. they take over the caller's reference and release it when they are
+ * done (also on errors).  This keeps the refcounting in the rebalancing code
+ * manageable.  The public functions take borrowed references instead.
+ *
+ * Large strings are split into leaves of at most NROPE_LEAF_MAX bytes when
+ * they are converted to a rope, and concatenating small leaves merges them
+ * into a new string of up to NROPE_LEAF_MERGE bytes.  This keeps leaves small
+ * enough that scanning a single one for a character index is cheap, and stops
+ * ropes built one character at a time from degenerating to one node per
+ * character.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "neo/_error.h"
+#include "neo/_nalloc.h"
+#include "neo/_nref.h"
+#include "neo/_nstr.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+#include "neo/nrope.h"
+#include "neo/utf.h"
+
+#define NROPE_LEAF_MAX		1024
+#define NROPE_LEAF_MERGE	128
+
+static inline bool is_leaf(const nrope_t *rope)
+{
+	return rope->_left == nil;
+}
+
+static void nrope_destroy(nrope_t *rope)
+{
+	if (is_leaf(rope)) {
+		if (rope->_str != nil)
+			nput(rope->_str);
+	} else {
+		nput(rope->_left);
+		nput(rope->_right);
+	}
+	npool_free(rope, sizeof(*rope));
+}
+
+/** Count the characters in `size` bytes of valid UTF-8. */
+static usize utf8_count(const char *data, usize size)
+{
+	usize len = 0;
+	for (usize i = 0; i < size; i++)
+		len += (data[i] & 0xc0) != 0x80;
+	return len;
+}
+
+/** Get the byte offset of the character at `index` in valid UTF-8 data. */
+static usize utf8_offset(const char *data, usize index)
+{
+	usize offset = 0;
+	while (index != 0) {
+		offset++;
+		index -= (data[offset] & 0xc0) != 0x80;
+	}
+	return offset;
+}
+
+/** Create a new leaf borrowing `str`, which may be `nil` for empty leaves. */
+static nrope_t *leaf_new(nstr_t *str, const char *data, usize size, usize len, error *err)
+{
+	nrope_t *leaf = npool_alloc(sizeof(*leaf), err);
+	catch(err) {
+		return nil;
+	}
+
+	if (str != nil)
+		nget(str);
+	leaf->_str = str;
+	leaf->_data = data;
+	leaf->_size = size;
+	leaf->_len = len;
+	leaf->_height = 0;
+	leaf->_left = nil;
+	leaf->_right = nil;
+	nref_init(leaf, nrope_destroy);
+	return leaf;
+}
+
+/** Create a new inner node.  Consumes `left` and `right`. */
+static nrope_t *node_new(nrope_t *left, nrope_t *right, error *err)
+{
+	nrope_t *node = npool_alloc(sizeof(*node), err);
+	catch(err) {
+		nput(left);
+		nput(right);
+		return nil;
+	}
+
+	node->_str = nil;
+	node->_data = nil;
+	node->_size = left->_size + right->_size;
+	node->_len = left->_len + right->_len;
+	node->_height = nmax(left->_height, right->_height) + 1;
+	node->_left = left;
+	node->_right = right;
+	nref_init(node, nrope_destroy);
+	return node;
+}
+
+/** Get a new reference to a child of `node`. */
+static inline nrope_t *child(nrope_t *node)
+{
+	nget(node);
+	return node;
+}
+
+/**
+ * Create a new inner node and rotate it if necessary.  The heights of `left`
+ * and `right` must differ by at most 2.  Consumes `left` and `right`.
+ */
+static nrope_t *balance(nrope_t *left, nrope_t *right, error *err)
+{
+	if (right->_height > left->_height + 1) {
+		nrope_t *rl = child(right->_left);
+		nrope_t *rr = child(right->_right);
+		nput(right);
+		if (rl->_height > rr->_height) {
+			nrope_t *rll = child(rl->_left);
+			nrope_t *rlr = child(rl->_right);
+			nput(rl);
+			nrope_t *new_left = node_new(left, rll, err);
+			catch(err) {
+				nput(rlr);
+				nput(rr);
+				return nil;
+			}
+			nrope_t *new_right = node_new(rlr, rr, err);
+			catch(err) {
+				nput(new_left);
+				return nil;
+			}
+			return node_new(new_left, new_right, err);
+		} else {
+			nrope_t *new_left = node_new(left, rl, err);
+			catch(err) {
+				nput(rr);
+				return nil;
+			}
+			return node_new(new_left, rr, err);
+		}
+	}
+
+	if (left->_height > right->_height + 1) {
+		nrope_t *ll = child(left->_left);
+		nrope_t *lr = child(left->_right);
+		nput(left);
+		if (lr->_height > ll->_height) {
+			nrope_t *lrl = child(lr->_left);
+			nrope_t *lrr = child(lr->_right);
+			nput(lr);
+			nrope_t *new_left = node_new(ll, lrl, err);
+			catch(err) {
+				nput(lrr);
+				nput(right);
+				return nil;
+			}
+			nrope_t *new_right = node_new(lrr, right, err);
+			catch(err) {
+				nput(new_left);
+				return nil;
+			}
+			return node_new(new_left, new_right, err);
+		} else {
+			nrope_t *new_right = node_new(lr, right, err);
+			catch(err) {
+				nput(ll);
+				return nil;
+			}
+			return node_new(ll, new_right, err);
+		}
+	}
+
+	return node_new(left, right, err);
+}
+
+/** Copy two small leaves into a single new one.  Consumes both. */
+static nrope_t *leaf_merge(nrope_t *left, nrope_t *right, error *err)
+{
+	nstr_t *str = _neo_nstr_alloc(left->_size + right->_size,
+				      left->_len + right->_len, err);
+	catch(err) {
+		nput(left);
+		nput(right);
+		return nil;
+	}
+
+	char *data = (char *)str->_data;
+	memcpy(data, left->_data, left->_size);
+	memcpy(data + left->_size, right->_data, right->_size);
+	nput(left);
+	nput(right);
+
+	nrope_t *leaf = leaf_new(str, str->_data, _neo_nstr_size(str), str->_len, err);
+	nput(str);
+	return leaf;
+}
+
+/** Concatenate two balanced ropes of arbitrary height.  Consumes both. */
+static nrope_t *join(nrope_t *left, nrope_t *right, error *err)
+{
+	if (left->_size == 0) {
+		nput(left);
+		neat(err);
+		return right;
+	}
+	if (right->_size == 0) {
+		nput(right);
+		neat(err);
+		return left;
+	}
+
+	if (is_leaf(left) && is_leaf(right)
+	    && left->_size + right->_size <= NROPE_LEAF_MERGE)
+		return leaf_merge(left, right, err);
+
+	/*
+	 * If one side is much higher than the other, we descend along its
+	 * inner spine until we find a subtree of about the same height as the
+	 * other side, and rebalance on the way back up.
+	 */
+	if (left->_height > right->_height + 1) {
+		nrope_t *ll = child(left->_left);
+		nrope_t *lr = child(left->_right);
+		nput(left);
+		nrope_t *joined = join(lr, right, err);
+		catch(err) {
+			nput(ll);
+			return nil;
+		}
+		return balance(ll, joined, err);
+	}
+
+	if (right->_height > left->_height + 1) {
+		nrope_t *rl = child(right->_left);
+		nrope_t *rr = child(right->_right);
+		nput(right);
+		nrope_t *joined = join(left, rl, err);
+		catch(err) {
+			nput(rr);
+			return nil;
+		}
+		return balance(joined, rr, err);
+	}
+
+	return node_new(left, right, err);
+}
+
+/** Build a balanced rope from a string.  Returns a new reference. */
+static nrope_t *build(nstr_t *str, const char *data, usize size, error *err)
+{
+	if (size <= NROPE_LEAF_MAX)
+		return leaf_new(str, data, size, utf8_count(data, size), err);
+
+	/* split in the middle, but not within a multibyte sequence */
+	usize mid = size / 2;
+	while ((data[mid] & 0xc0) == 0x80)
+		mid++;
+
+	nrope_t *left = build(str, data, mid, err);
+	catch(err) {
+		return nil;
+	}
+	nrope_t *right = build(str, data + mid, size - mid, err);
+	catch(err) {
+		nput(left);
+		return nil;
+	}
+	return join(left, right, err);
+}
+
+/** Get a slice of a rope.  Returns a new reference. */
+static nrope_t *slice(nrope_t *rope, usize start, usize len, error *err)
+{
+	if (start == 0 && len == rope->_len) {
+		nget(rope);
+		neat(err);
+		return rope;
+	}
+
+	if (is_leaf(rope)) {
+		usize begin = utf8_offset(rope->_data, start);
+		usize end = len == rope->_len - start
+			? rope->_size
+			: begin + utf8_offset(rope->_data + begin, len);
+		return leaf_new(len == 0 ? nil : rope->_str,
+				len == 0 ? "" : rope->_data + begin,
+				end - begin, len, err);
+	}
+
+	usize left_len = rope->_left->_len;
+	if (start + len <= left_len)
+		return slice(rope->_left, start, len, err);
+	if (start >= left_len)
+		return slice(rope->_right, start - left_len, len, err);
+
+	nrope_t *left = slice(rope->_left, start, left_len - start, err);
+	catch(err) {
+		return nil;
+	}
+	nrope_t *right = slice(rope->_right, 0, len - (left_len - start), err);
+	catch(err) {
+		nput(left);
+		return nil;
+	}
+	return join(left, right, err);
+}
+
+nrope_t *nrope_from_nstr(nstr_t *s, error *err)
+{
+	if (s == nil) {
+		yeet(err, EFAULT, "String is nil");
+		return nil;
+	}
+
+	return build(s, s->_data, _neo_nstr_size(s), err);
+}
+
+nrope_t *nrope_cat(nrope_t *r1, nrope_t *r2, error *err)
+{
+	if (r1 == nil) {
+		yeet(err, EFAULT, "First rope is nil");
+		return nil;
+	}
+	if (r2 == nil) {
+		yeet(err, EFAULT, "Second rope is nil");
+		return nil;
+	}
+
+	nget(r1);
+	nget(r2);
+	return join(r1, r2, err);
+}
+
+nrope_t *nrope_slice(nrope_t *rope, usize start, usize len, error *err)
+{
+	if (rope == nil) {
+		yeet(err, EFAULT, "Rope is nil");
+		return nil;
+	}
+	if (start > rope->_len || len > rope->_len - start) {
+		yeet(err, ERANGE, "Slice out of bounds");
+		return nil;
+	}
+
+	return slice(rope, start, len, err);
+}
+
+nrope_t *nrope_insert(nrope_t *rope, usize index, nrope_t *other, error *err)
+{
+	if (rope == nil || other == nil) {
+		yeet(err, EFAULT, "Rope is nil");
+		return nil;
+	}
+	if (index > rope->_len) {
+		yeet(err, ERANGE, "Rope index out of bounds");
+		return nil;
+	}
+
+	nrope_t *head = slice(rope, 0, index, err);
+	catch(err) {
+		return nil;
+	}
+	nrope_t *tail = slice(rope, index, rope->_len - index, err);
+	catch(err) {
+		nput(head);
+		return nil;
+	}
+
+	nget(other);
+	head = join(head, other, err);
+	catch(err) {
+		nput(tail);
+		return nil;
+	}
+	return join(head, tail, err);
+}
+
+nchar nrope_chrat(const nrope_t *rope, usize index, error *err)
+{
+	if (rope == nil) {
+		yeet(err, EFAULT, "Rope is nil");
+		return '\0';
+	}
+	if (index >= rope->_len) {
+		yeet(err, ERANGE, "Rope index out of bounds");
+		return '\0';
+	}
+
+	while (!is_leaf(rope)) {
+		if (index < rope->_left->_len) {
+			rope = rope->_left;
+		} else {
+			index -= rope->_left->_len;
+			rope = rope->_right;
+		}
+	}
+
+	nchar c;
+	utf8_to_nchr(&c, rope->_data + utf8_offset(rope->_data, index), err);
+	return c;
+}
+
+u8 nrope_byteat(const nrope_t *rope, usize offset, error *err)
+{
+	if (rope == nil) {
+		yeet(err, EFAULT, "Rope is nil");
+		return 0;
+	}
+	if (offset >= rope->_size) {
+		yeet(err, ERANGE, "Rope offset out of bounds");
+		return 0;
+	}
+
+	while (!is_leaf(rope)) {
+		if (offset < rope->_left->_size) {
+			rope = rope->_left;
+		} else {
+			offset -= rope->_left->_size;
+			rope = rope->_right;
+		}
+	}
+
+	neat(err);
+	return (u8)rope->_data[offset];
+}
+
+nstr_t *nrope_flatten(const nrope_t *rope, error *err)
+{
+	if (rope == nil) {
+		yeet(err, EFAULT, "Rope is nil");
+		return nil;
+	}
+
+	nstr_t *str = _neo_nstr_alloc(rope->_size, rope->_len, err);
+	catch(err) {
+		return nil;
+	}
+
+	char *pos = (char *)str->_data;
+	const nrope_t *stack[_NEO_NROPE_MAX_HEIGHT];
+	unsigned int depth = 0;
+	stack[depth++] = rope;
+	while (depth != 0) {
+		const nrope_t *node = stack[--depth];
+		while (!is_leaf(node)) {
+			stack[depth++] = node->_right;
+			node = node->_left;
+		}
+		memcpy(pos, node->_data, node->_size);
+		pos += node->_size;
+	}
+
+	return str;
+}
+
+nrope_iter_t nrope_iter(const nrope_t *rope)
+{
+	nrope_iter_t iter;
+	iter._depth = 0;
+	iter._pos = nil;
+	iter._end = nil;
+	if (rope != nil)
+		iter._stack[iter._depth++] = rope;
+	return iter;
+}
+
+bool nrope_iter_next(nrope_iter_t *iter, nchar *c, error *err)
+{
+	while (iter->_pos == iter->_end) {
+		if (iter->_depth == 0) {
+			neat(err);
+			return false;
+		}
+
+		const nrope_t *node = iter->_stack[--iter->_depth];
+		while (!is_leaf(node)) {
+			iter->_stack[iter->_depth++] = node->_right;
+			node = node->_left;
+		}
+		iter->_pos = node->_data;
+		iter->_end = node->_data + node->_size;
+	}
+
+	iter->_pos += utf8_to_nchr(c, iter->_pos, err);
+	catch(err) {
+		return false;
+	}
+	return true;
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -12,22 +12,44 @@
 #include "neo/_nstr.h"
 #include "neo/_toolchain.h"
 #include "neo/_types.h"
+#include "neo/_utf8.h"
+#include "neo/narena.h"
 #include "neo/utf.h"
 
+/*
+ * nchrat() builds an index of the byte offset of every INDEX_STRIDE-th
+ * character for strings with at least INDEX_MIN characters that are not
+ * pure ASCII, so it only has to scan at most INDEX_STRIDE - 1 characters.
+ */
+#define INDEX_STRIDE	64
+#define INDEX_MIN	(4 * INDEX_STRIDE)
+
 void _neo_nstr_destroy(nstr_t *str)
 {
 	if (str->_borrow != nil)
 		_neo_nput(str->_borrow);
+	if (str->_index != nil)
+		nfree((usize *)str->_index);
 	nfree(str);
 }
 
-static nstr_t *nstr_unsafe(const char *s, usize size_without_nul, error *err)
+void _neo_nstr_destroy_borrowed(nstr_t *str)
 {
-	usize len = utf8_ncheck(s, size_without_nul, err);
-	catch(err) {
-		return nil;
-	}
+	_neo_nput(str->_borrow);
+	if (str->_index != nil)
+		nfree((usize *)str->_index);
+	npool_free(str, sizeof(*str));
+}
+
+/** arena strings are released along with their arena, see narena.c */
+static void nstr_destroy_arena(nstr_t *str)
+{
+	(void)str;
+}
 
+/** if `arena` is `nil`, the string is allocated with nalloc() */
+static nstr_t *nstr_alloc_in(narena_t *arena, usize size_without_nul, usize len, error *err)
+{
 	/*
 	 * neo strings are terminated by four NUL characters rather than just
 	 * one.  We do this to make sure nothing bad can happen if some stupid
@@ -41,7 +63,16 @@ static nstr_t *nstr_unsafe(const char *s, usize size_without_nul, error *err)
 	 * Yeah, this is definitely never gonna break my legs.
 	 */
 
-	nstr_t *str = nalloc(sizeof(*str) + size_without_nul + 4, err);
+	if (size_without_nul > (usize)-1 - sizeof(nstr_t) - 4) {
+		yeet(err, ERANGE, "String is too long");
+		return nil;
+	}
+
+	nstr_t *str;
+	if (arena == nil)
+		str = nalloc(sizeof(*str) + size_without_nul + 4, err);
+	else
+		str = narena_alloc(arena, sizeof(*str) + size_without_nul + 4, err);
 	catch(err) {
 		return nil;
 	}
@@ -52,19 +83,43 @@ static nstr_t *nstr_unsafe(const char *s, usize size_without_nul, error *err)
 	 * additional memory allocation.
 	 */
 	char *data = (char *)str + sizeof(*str);
-	memcpy(data, s, size_without_nul);
 	for (unsigned int i = 0; i < 4; i++)
 		data[size_without_nul + i] = '\0';
 
 	str->_data = data;
 	str->_len = len;
 	str->_borrow = nil;
+	str->_index = nil;
 	str->_size = size_without_nul + 4;
-	nref_init(str, _neo_nstr_destroy);
+	if (arena == nil)
+		nref_init(str, _neo_nstr_destroy);
+	else
+		nref_init(str, nstr_destroy_arena);
 
 	return str;
 }
 
+nstr_t *_neo_nstr_alloc(usize size_without_nul, usize len, error *err)
+{
+	return nstr_alloc_in(nil, size_without_nul, len, err);
+}
+
+static nstr_t *nstr_unsafe(narena_t *arena, const char *s, usize size_without_nul, error *err)
+{
+	usize len = _neo_utf8_validate(s, size_without_nul, err);
+	catch(err) {
+		return nil;
+	}
+
+	nstr_t *str = nstr_alloc_in(arena, size_without_nul, len, err);
+	catch(err) {
+		return nil;
+	}
+
+	memcpy((char *)str->_data, s, size_without_nul);
+	return str;
+}
+
 nstr_t *nstr(const char *restrict s, error *err)
 {
 	if (s == nil) {
@@ -73,7 +128,22 @@ nstr_t *nstr(const char *restrict s, error *err)
 	}
 
 	usize size_without_nul = strlen(s);
-	return nstr_unsafe(s, size_without_nul, err);
+	return nstr_unsafe(nil, s, size_without_nul, err);
+}
+
+nstr_t *nstr_in(narena_t *arena, const char *restrict s, error *err)
+{
+	if (arena == nil) {
+		yeet(err, EFAULT, "Arena is nil");
+		return nil;
+	}
+	if (s == nil) {
+		yeet(err, EFAULT, "String is nil");
+		return nil;
+	}
+
+	usize size_without_nul = strlen(s);
+	return nstr_unsafe(arena, s, size_without_nul, err);
 }
 
 nstr_t *nnstr(const char *restrict s, usize maxsize, error *err)
@@ -84,7 +154,70 @@ nstr_t *nnstr(const char *restrict s, usize maxsize, error *err)
 	}
 
 	usize size_without_nul = strnlen(s, maxsize);
-	return nstr_unsafe(s, size_without_nul, err);
+	return nstr_unsafe(nil, s, size_without_nul, err);
+}
+
+/**
+ * Get the index of `s`, or build it if it doesn't exist yet.
+ * Returns `nil` if the index couldn't be allocated.
+ */
+static const usize *get_index(nstr_t *s)
+{
+	const usize *index = __atomic_load_n(&s->_index, __ATOMIC_ACQUIRE);
+	if (index != nil)
+		return index;
+
+	/* arena strings are never destroyed, so the index would leak */
+	if (s->__neo_nref._destroy == (void (*)(void *))nstr_destroy_arena)
+		return nil;
+	/* same for immortal strings, which might also be read-only */
+	if (nref_is_immortal(s))
+		return nil;
+
+	error err;
+	usize entries = (nlen(s) + INDEX_STRIDE - 1) / INDEX_STRIDE;
+	usize *new_index = nalloc(entries * sizeof(*new_index), &err);
+	catch(&err) {
+		errput(&err);
+		return nil;
+	}
+
+	usize entry = 0;
+	usize chars = 0;
+	for (usize pos = 0; entry < entries; pos++) {
+		if ((s->_data[pos] & 0xc0) != 0x80) {
+			if (chars++ % INDEX_STRIDE == 0)
+				new_index[entry++] = pos;
+		}
+	}
+
+	/* another thread might have been faster, in which case we use theirs */
+	const usize *expected = nil;
+	if (__atomic_compare_exchange_n(&s->_index, &expected, new_index, false,
+					__ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return new_index;
+	nfree(new_index);
+	return expected;
+}
+
+const char *_neo_nstr_char_ptr(const nstr_t *s, usize index)
+{
+	if (_neo_nstr_is_ascii(s))
+		return &s->_data[index];
+	/* the index has no entry for the end if the length is a multiple of 64 */
+	if (index == nlen(s))
+		return &s->_data[_neo_nstr_size(s)];
+
+	const char *ptr = s->_data;
+	if (nlen(s) >= INDEX_MIN) {
+		/* the index is only a cache, so this doesn't really modify s */
+		const usize *chr_index = get_index((nstr_t *)s);
+		if (chr_index != nil) {
+			ptr += chr_index[index / INDEX_STRIDE];
+			index %= INDEX_STRIDE;
+		}
+	}
+	return _neo_utf8_skip(ptr, index);
 }
 
 nchar nchrat(const nstr_t *s, usize index, error *err)
@@ -99,10 +232,12 @@ nchar nchrat(const nstr_t *s, usize index, error *err)
 		return '\0';
 	}
 
-	const char *ptr = s->_data;
-	while (index != 0)
-		index -= (*ptr++ & 0xc0) != 0x80;
-	ptr--;
+	if (_neo_nstr_is_ascii(s)) {
+		neat(err);
+		return (nchar)s->_data[index];
+	}
+
+	const char *ptr = _neo_nstr_char_ptr(s, index);
 
 	nchar ret;
 	utf8_to_nchr(&ret, ptr, err);
@@ -119,6 +254,8 @@ void _neo_nstr_init_array(void)
 	struct _neo_nstr_init_info *ptr = &__neo_nstr_array_start;
 	while (ptr != &__neo_nstr_array_end) {
 		*ptr->dest = nstr(ptr->data, nil);
+		nref_make_immortal(*ptr->dest);
+		_neo_nalloc_permanent(*ptr->dest);
 		ptr++;
 	}
 }
@@ -0,0 +1,245 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <errno.h>
+#include <string.h>
+
+#include "neo/_error.h"
+#include "neo/_nalloc.h"
+#include "neo/_nref.h"
+#include "neo/_nstr.h"
+#include "neo/_stddef.h"
+#include "neo/_types.h"
+#include "neo/_utf8.h"
+#include "neo/_x2nstr.h"
+#include "neo/nstrbuf.h"
+#include "neo/utf.h"
+
+#define NSTRBUF_DEFAULT_CAPACITY 64
+/** don't bother trimming the final string if less than this is unused */
+#define NSTRBUF_MAX_SLACK 64
+
+/*
+ * The buffer is laid out exactly like a string created by nstr(), i.e. the
+ * header is immediately followed by the data and four NUL terminators.
+ * This is what allows nstrbuf_finish() to just fill in the header.
+ */
+static inline char *buf_data(nstrbuf_t *buf)
+{
+	return (char *)buf->_str + sizeof(nstr_t);
+}
+
+static void buf_resize(nstrbuf_t *buf, usize capacity, error *err)
+{
+	if (capacity > (usize)-1 - sizeof(nstr_t) - 4) {
+		yeet(err, ERANGE, "String is too long");
+		return;
+	}
+
+	nstr_t *str = nrealloc(buf->_str, sizeof(nstr_t) + capacity + 4, err);
+	catch(err) {
+		return;
+	}
+
+	buf->_str = str;
+	buf->_capacity = capacity;
+}
+
+/** Make sure there is room for `size` more bytes. */
+static inline void buf_reserve(nstrbuf_t *buf, usize size, error *err)
+{
+	if (buf->_capacity - buf->_size >= size) {
+		neat(err);
+		return;
+	}
+
+	if (size > (usize)-1 - buf->_size) {
+		yeet(err, ERANGE, "String is too long");
+		return;
+	}
+	usize capacity = nmax(buf->_size + size, 2 * buf->_capacity);
+	buf_resize(buf, capacity, err);
+}
+
+/** Append `size` bytes making up `len` valid UTF-8 characters. */
+static void buf_append(nstrbuf_t *buf, const char *s, usize size, usize len, error *err)
+{
+	buf_reserve(buf, size, err);
+	catch(err) {
+		return;
+	}
+
+	memcpy(buf_data(buf) + buf->_size, s, size);
+	buf->_size += size;
+	buf->_len += len;
+}
+
+void nstrbuf_init(nstrbuf_t *buf, usize capacity, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "String builder is nil");
+		return;
+	}
+
+	if (capacity == 0)
+		capacity = NSTRBUF_DEFAULT_CAPACITY;
+
+	buf->_str = nil;
+	buf->_size = 0;
+	buf->_len = 0;
+	buf->_capacity = 0;
+	buf_resize(buf, capacity, err);
+}
+
+void nstrbuf_destroy(nstrbuf_t *buf)
+{
+	if (buf == nil)
+		return;
+
+	nfree(buf->_str);
+	buf->_str = nil;
+	buf->_size = 0;
+	buf->_len = 0;
+	buf->_capacity = 0;
+}
+
+nstr_t *nstrbuf_finish(nstrbuf_t *buf, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "String builder is nil");
+		return nil;
+	}
+	if (buf->_str == nil) {
+		yeet(err, EINVAL, "String builder is not initialized");
+		return nil;
+	}
+
+	if (buf->_capacity - buf->_size > NSTRBUF_MAX_SLACK) {
+		error resize_err;
+		buf_resize(buf, buf->_size, &resize_err);
+		/* if trimming fails, the string is just a little larger */
+		catch(&resize_err) {
+			errput(&resize_err);
+		}
+	}
+
+	nstr_t *str = buf->_str;
+	char *data = buf_data(buf);
+	for (unsigned int i = 0; i < 4; i++)
+		data[buf->_size + i] = '\0';
+
+	str->_data = data;
+	str->_len = buf->_len;
+	str->_borrow = nil;
+	str->_index = nil;
+	str->_size = buf->_size + 4;
+	nref_init(str, _neo_nstr_destroy);
+
+	buf->_str = nil;
+	nstrbuf_destroy(buf);
+	neat(err);
+	return str;
+}
+
+void nstrbuf_append(nstrbuf_t *buf, const nstr_t *s, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "String builder is nil");
+		return;
+	}
+	if (s == nil) {
+		yeet(err, EFAULT, "String is nil");
+		return;
+	}
+
+	buf_append(buf, s->_data, _neo_nstr_size(s), s->_len, err);
+}
+
+void nstrbuf_append_cstr(nstrbuf_t *buf, const char *restrict s, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "String builder is nil");
+		return;
+	}
+	if (s == nil) {
+		yeet(err, EFAULT, "String is nil");
+		return;
+	}
+
+	usize size = strlen(s);
+	usize len = _neo_utf8_validate(s, size, err);
+	catch(err) {
+		return;
+	}
+
+	buf_append(buf, s, size, len, err);
+}
+
+void nstrbuf_append_chr(nstrbuf_t *buf, nchar c, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "String builder is nil");
+		return;
+	}
+	if (c == '\0') {
+		yeet(err, EINVAL, "Cannot append NUL characters");
+		return;
+	}
+
+	char s[5];
+	usize size = utf8_from_nchr(&s[0], c, err);
+	catch(err) {
+		return;
+	}
+
+	buf_append(buf, &s[0], size, 1, err);
+}
+
+void nstrbuf_append_u(nstrbuf_t *buf, u64 u, int radix, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "String builder is nil");
+		return;
+	}
+
+	char s[65];
+	char *digits = _neo_unsigned_convert(&s[64], u, radix, err);
+	catch(err) {
+		return;
+	}
+
+	usize size = (usize)(&s[64] - digits);
+	buf_append(buf, digits, size, size, err);
+}
+
+void nstrbuf_append_i(nstrbuf_t *buf, i64 i, int radix, error *err)
+{
+	if (buf == nil) {
+		yeet(err, EFAULT, "String builder is nil");
+		return;
+	}
+
+	char s[66];
+	u64 magnitude = i < 0 ? -(u64)i : (u64)i;
+	char *digits = _neo_unsigned_convert(&s[65], magnitude, radix, err);
+	catch(err) {
+		return;
+	}
+	if (i < 0)
+		*(--digits) = '-';
+
+	usize size = (usize)(&s[65] - digits);
+	buf_append(buf, digits, size, size, err);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -1,8 +1,5 @@
 /** See the end of this file for copyright and license terms. */
 
-/* strnlen */
-#define _POSIX_C_SOURCE 200809L
-
 #include <errno.h>
 #include <string.h>
 
@@ -24,21 +21,23 @@ nstr_t *nstrcat(const nstr_t *s1, const nstr_t *s2, error *err)
 		return nil;
 	}
 
-	usize s1_size_without_nul = strlen(s1->_data);
-	usize s2_size_without_nul = strlen(s2->_data);
-	usize cat_size = s1_size_without_nul + s2_size_without_nul + 1;
-	char *cat = nalloc(cat_size, err);
-	catch(err) {
+	usize s1_size = _neo_nstr_size(s1);
+	usize s2_size = _neo_nstr_size(s2);
+	if (s2_size > (usize)-1 - s1_size) {
+		yeet(err, ERANGE, "String is too long");
 		return nil;
 	}
 
-	memcpy(cat, s1->_data, s1_size_without_nul);
-	memcpy(cat + s1_size_without_nul, s2->_data, s2_size_without_nul);
-	cat[s1_size_without_nul + s2_size_without_nul] = '\0';
+	/* both strings are valid already, so we can skip the UTF-8 check */
+	nstr_t *cat = _neo_nstr_alloc(s1_size + s2_size, s1->_len + s2->_len, err);
+	catch(err) {
+		return nil;
+	}
 
-	nstr_t *ret = nstr(cat, err);
-	nfree(cat);
-	return ret;
+	char *data = (char *)cat->_data;
+	memcpy(data, s1->_data, s1_size);
+	memcpy(data + s1_size, s2->_data, s2_size);
+	return cat;
 }
 
 nstr_t *nstrcat_put(nstr_t *s1, nstr_t *s2, error *err)
@@ -28,15 +28,18 @@ int nstrcmp(const nstr_t *s1, const nstr_t *s2, error *err)
 		return 1;
 	}
 
-	int ret;
-
-	usize maxbytes;
-	if (s1->_size > s2->_size)
-		maxbytes = s2->_size;
-	else
-		maxbytes = s1->_size;
+	/*
+	 * We can't rely on the NUL terminator to stop the comparison because
+	 * slices don't have one.  Comparing the shared prefix and then the
+	 * sizes gives the same result, because UTF-8 preserves code point
+	 * order when compared byte by byte.
+	 */
+	usize size1 = _neo_nstr_size(s1);
+	usize size2 = _neo_nstr_size(s2);
+	int ret = memcmp(s1->_data, s2->_data, nmin(size1, size2));
+	if (ret == 0)
+		ret = (size1 > size2) - (size1 < size2);
 
-	ret = strncmp(s1->_data, s2->_data, maxbytes);
 	neat(err);
 	return ret;
 }
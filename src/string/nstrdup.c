@@ -15,7 +15,8 @@ nstr_t *nstrdup(nstr_t *s, error *err)
 		return nil;
 	}
 
-	nstr_t *copy = nalloc(sizeof(*copy), err);
+	/* copies only consist of the header, which is a perfect fit for pools */
+	nstr_t *copy = npool_alloc(sizeof(*copy), err);
 	catch(err) {
 		return nil;
 	}
@@ -26,7 +27,8 @@ nstr_t *nstrdup(nstr_t *s, error *err)
 	copy->_size = s->_size;
 	copy->_borrow = &s->__neo_nref;
 	copy->_data = s->_data;
-	nref_init(copy, _neo_nstr_destroy);
+	copy->_index = nil;
+	nref_init(copy, _neo_nstr_destroy_borrowed);
 	return copy;
 }
 
@@ -22,21 +22,24 @@ nstr_t *nstrmul(nstr_t *s, usize n, error *err)
 	if (n == 1)
 		return nstrdup(s, err);
 
-	usize s_size = strlen(s->_data);
-	char *multiplied = nalloc(s_size * n + 1, err);
+	usize s_size = _neo_nstr_size(s);
+	if (s_size > (usize)-1 / n) {
+		yeet(err, ERANGE, "String is too long");
+		return nil;
+	}
+
+	nstr_t *multiplied = _neo_nstr_alloc(s_size * n, s->_len * n, err);
 	catch(err) {
 		return nil;
 	}
 
-	char *pos = multiplied;
+	char *pos = (char *)multiplied->_data;
 	while (n-- != 0) {
-		strcpy(pos, s->_data);
+		memcpy(pos, s->_data, s_size);
 		pos += s_size;
 	}
 
-	nstr_t *ret = nstr(multiplied, err);
-	nfree(multiplied);
-	return ret;
+	return multiplied;
 }
 
 nstr_t *nstrmul_put(nstr_t *s, usize n, error *err)
@@ -52,7 +55,8 @@ nstr_t *nstrmul_put(nstr_t *s, usize n, error *err)
 
 nstr_t *nchrmul(nchar c, usize n, error *err)
 {
-	if (n == 0)
+	/* neo strings can't contain NUL characters */
+	if (n == 0 || c == '\0')
 		return nstr("", err);
 
 	char s[5];
@@ -61,20 +65,24 @@ nstr_t *nchrmul(nchar c, usize n, error *err)
 		return nil;
 	}
 
-	char *multiplied = nalloc(s_size * n + 1, err);
+	if (s_size > (usize)-1 / n) {
+		yeet(err, ERANGE, "String is too long");
+		return nil;
+	}
+
+	/* the character was validated by utf8_from_nchr() */
+	nstr_t *multiplied = _neo_nstr_alloc(s_size * n, n, err);
 	catch(err) {
 		return nil;
 	}
 
-	char *pos = multiplied;
+	char *pos = (char *)multiplied->_data;
 	while (n-- != 0) {
 		memcpy(pos, &s[0], s_size);
 		pos += s_size;
 	}
 
-	nstr_t *ret = nstr(multiplied, err);
-	nfree(multiplied);
-	return ret;
+	return multiplied;
 }
 
 /*
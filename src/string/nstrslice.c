@@ -0,0 +1,78 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <errno.h>
+#include <string.h>
+
+#include "neo/_error.h"
+#include "neo/_nalloc.h"
+#include "neo/_nref.h"
+#include "neo/_nstr.h"
+#include "neo/_types.h"
+
+nstr_t *nstr_slice(nstr_t *s, usize start, usize len, error *err)
+{
+	if (s == nil) {
+		yeet(err, EFAULT, "String is nil");
+		return nil;
+	}
+	if (start > nlen(s) || len > nlen(s) - start) {
+		yeet(err, ERANGE, "Slice out of bounds");
+		return nil;
+	}
+
+	/* long strings have an index, so this doesn't scan from the start */
+	const char *begin = _neo_nstr_char_ptr(s, start);
+	const char *end = _neo_nstr_char_ptr(s, start + len);
+
+	/* views only consist of the header, just like copies from nstrdup() */
+	nstr_t *slice = npool_alloc(sizeof(*slice), err);
+	catch(err) {
+		return nil;
+	}
+
+	/* borrow from the owner of the memory directly to avoid long chains */
+	nref_t *owner = s->_borrow != nil ? s->_borrow : &s->__neo_nref;
+	_neo_nget(owner);
+
+	slice->_len = len;
+	slice->_size = (usize)(end - begin) + 4;
+	slice->_borrow = owner;
+	slice->_data = begin;
+	slice->_index = nil;
+	nref_init(slice, _neo_nstr_destroy_borrowed);
+	return slice;
+}
+
+nstr_t *nstr_terminate(nstr_t *s, error *err)
+{
+	if (s == nil) {
+		yeet(err, EFAULT, "String is nil");
+		return nil;
+	}
+
+	if (nstr_is_terminated(s)) {
+		nget(s);
+		neat(err);
+		return s;
+	}
+
+	nstr_t *copy = _neo_nstr_alloc(_neo_nstr_size(s), nlen(s), err);
+	catch(err) {
+		return nil;
+	}
+	memcpy((char *)copy->_data, s->_data, _neo_nstr_size(s));
+	return copy;
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
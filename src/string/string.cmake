@@ -3,8 +3,14 @@ target_sources(neo PRIVATE
     ./string/nstrcat.c
     ./string/nstrcmp.c
     ./string/nstrdup.c
+    ./string/nstrbuf.c
+    ./string/nrope.c
     ./string/nstrmul.c
+    ./string/nstrslice.c
     ./string/leftpad.c
     ./string/utf.c
+    ./string/utf8_stream.c
+    ./string/utf8_validate.c
+    ./string/utf_transcode.c
     ./string/x2nstr.c
 )
@@ -6,56 +6,32 @@
  * <https://github.com/skeeto/branchless-utf8/blob/f2d0e24c3864d726cd009901726df4778ad3e0d5/utf8.h>
  */
 
+/* strnlen */
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "neo/_error.h"
 #include "neo/_nalloc.h"
 #include "neo/_types.h"
+#include "neo/_utf8.h"
 #include "neo/utf.h"
 
 usize utf8_check(const char *restrict s, error *err)
 {
-	usize ret = 0;
-	nchar c;
-
-	while (*s != '\0') {
-		ret++;
-		s += utf8_to_nchr(&c, s, err);
-		catch(err) {
-			break;
-		}
-	}
-
-	return ret;
+	return _neo_utf8_validate(s, strlen(s), err);
 }
 
 usize utf8_ncheck(const char *restrict s, usize maxsize, error *err)
 {
-	usize ret = 0;
-	nchar c;
-
-	while (*s != '\0' && maxsize != 0) {
-		ret++;
-		usize size = utf8_to_nchr(&c, s, err);
-		s += size;
-		maxsize -= size;
-		catch(err) {
-			break;
-		}
-	}
-
-	return ret;
+	return _neo_utf8_validate(s, strnlen(s, maxsize), err);
 }
 
 usize utf8_strlen(const char *restrict s)
 {
-	usize len = 0;
-
-	while (*s != '\0')
-		len += (*s++ & 0xc0) != 0x80;
-
-	return len;
+	return _neo_utf8_count(s, strlen(s));
 }
 
 usize utf8_chrsize(nchar c, error *err)
@@ -149,7 +125,7 @@ usize utf8_to_nchr(nchar *dest, const char *restrict _utf8chr, error *err)
 	/* Minimum Unicode values per sequence length */
 	static const nchar        mins[]   = { 0x00, 0x00, 0x80, 0x800, 0x10000 };
 	/* Error bitmasks for (unused) bytes 2-4 per sequence length */
-	static const uint_fast8_t emasks[] = { 0x03, 0x03, 0x07,  0x3f,    0xff };
+	static const uint_fast8_t emasks[] = { 0x03, 0x03, 0x0f,  0x3f,    0xff };
 
 	/* signed bitshifts are a bad idea, trust me */
 	const u8 *restrict utf8chr = (const u8 *restrict)_utf8chr;
@@ -208,7 +184,10 @@ usize utf8_to_nchr(nchar *dest, const char *restrict _utf8chr, error *err)
 	eflags ^= 0xa8;
 	eflags &= emasks[len];
 
-	if (eflags != 0) {
+	/* surrogates and anything beyond U+10FFFF are not valid code points */
+	bool illegal = c > 0x10ffff || (c & 0xfffff800) == 0xd800;
+
+	if (eflags != 0 || illegal) {
 		/*
 		 * Errors are expected to be rare, so it's okay to use a bunch
 		 * of if statements in favor of accurate error descriptions
@@ -227,6 +206,9 @@ usize utf8_to_nchr(nchar *dest, const char *restrict _utf8chr, error *err)
 			yeet(err, EINVAL, "Byte 3 in UTF-8 sequence invalid: 0x%02x", utf8chr[2]);
 		} else if ((eflags & 0xc0) != 0) {
 			yeet(err, EINVAL, "Byte 4 in UTF-8 sequence invalid: 0x%02x", utf8chr[3]);
+		} else if (illegal) {
+			yeet(err, EINVAL, "Illegal Unicode code point in UTF-8 sequence: U+%04X",
+			     (unsigned int)c);
 		} else {
 			yeet(err, EINVAL, "Unexpected decoding error");
 		}
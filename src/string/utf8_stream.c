@@ -0,0 +1,210 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <errno.h>
+#include <string.h>
+
+#include "neo/_error.h"
+#include "neo/_types.h"
+#include "neo/_utf8.h"
+#include "neo/utf.h"
+
+/**
+ * Get the length of the sequence started by `lead`.  Invalid start bytes are
+ * treated as complete 1-byte sequences so `utf8_to_nchr()` rejects them.
+ */
+static inline unsigned int seq_len(u8 lead)
+{
+	if (lead < 0xc0)
+		return 1;
+	else if (lead < 0xe0)
+		return 2;
+	else if (lead < 0xf0)
+		return 3;
+	else if (lead < 0xf8)
+		return 4;
+	else
+		return 1;
+}
+
+/**
+ * Move as many bytes from `chunk` to the pending sequence as it needs.
+ * Returns the number of bytes taken from `chunk`.  If the sequence is
+ * complete afterwards, it is decoded into `c` and removed from the stream.
+ */
+static usize finish_pending(utf8_stream_t *stream, const char *chunk, usize size,
+			    nchar *c, error *err)
+{
+	unsigned int len = seq_len(stream->_pending[0]);
+	usize take = len - stream->_pending_size;
+	if (take > size)
+		take = size;
+
+	memcpy(&stream->_pending[stream->_pending_size], chunk, take);
+	stream->_pending_size += (u8)take;
+	if (stream->_pending_size < len) {
+		neat(err);
+		return take;
+	}
+
+	/* utf8_to_nchr() reads exactly `len` bytes, we have all of them now */
+	utf8_to_nchr(c, (const char *)stream->_pending, err);
+	catch(err) {
+		return take;
+	}
+	stream->_offset += len;
+	stream->_pending_size = 0;
+	return take;
+}
+
+/** store an incomplete sequence at the end of a chunk */
+static void set_pending(utf8_stream_t *stream, const char *rest, usize size)
+{
+	memcpy(stream->_pending, rest, size);
+	stream->_pending_size = (u8)size;
+}
+
+/** find the end of the last complete character in `chunk[start..size)` */
+static usize last_boundary(const char *chunk, usize start, usize size)
+{
+	for (usize back = 1; back <= 3 && back <= size - start; back++) {
+		u8 b = (u8)chunk[size - back];
+		if ((b & 0xc0) != 0x80) {
+			/* not a continuation byte, so this starts the last sequence */
+			return seq_len(b) > back ? size - back : size;
+		}
+	}
+	return size;
+}
+
+void utf8_stream_init(utf8_stream_t *stream)
+{
+	stream->_offset = 0;
+	stream->_pending_size = 0;
+}
+
+usize utf8_stream_feed(utf8_stream_t *stream, const char *chunk, usize size, error *err)
+{
+	if (stream == nil) {
+		yeet(err, EFAULT, "Stream is nil");
+		return 0;
+	}
+	if (chunk == nil && size != 0) {
+		yeet(err, EFAULT, "Chunk is nil");
+		return 0;
+	}
+	if (size == 0) {
+		neat(err);
+		return 0;
+	}
+
+	usize pos = 0;
+	if (stream->_pending_size != 0) {
+		nchar c;
+		pos = finish_pending(stream, chunk, size, &c, err);
+		catch(err) {
+			return 0;
+		}
+		if (stream->_pending_size != 0)
+			return 0;
+	}
+
+	usize start = pos;
+	usize end = last_boundary(chunk, start, size);
+	_neo_utf8_validate(&chunk[start], end - start, err);
+	catch(err) {
+		/*
+		 * Errors should be rare, so we can afford to decode everything
+		 * again just to find out where exactly it occurred.
+		 */
+		errput(err);
+		nchar c;
+		while (pos < end) {
+			usize len = _neo_utf8_decode_at(&c, chunk, pos, end, err);
+			catch(err) {
+				stream->_offset += pos - start;
+				return 0;
+			}
+			pos += len;
+		}
+		/* unreachable unless the two decoders disagree */
+		yeet(err, EINVAL, "Unexpected decoding error");
+		return 0;
+	}
+
+	stream->_offset += end - start;
+	set_pending(stream, &chunk[end], size - end);
+	return end;
+}
+
+bool utf8_stream_next(utf8_stream_t *stream, const char *chunk, usize size, usize *pos,
+		      nchar *c, error *err)
+{
+	if (stream == nil) {
+		yeet(err, EFAULT, "Stream is nil");
+		return false;
+	}
+	if ((chunk == nil && size != 0) || pos == nil) {
+		yeet(err, EFAULT, "Chunk is nil");
+		return false;
+	}
+
+	if (*pos >= size) {
+		neat(err);
+		return false;
+	}
+
+	if (stream->_pending_size != 0) {
+		*pos += finish_pending(stream, &chunk[*pos], size - *pos, c, err);
+		catch(err) {
+			return false;
+		}
+		return stream->_pending_size == 0;
+	}
+
+	unsigned int len = seq_len((u8)chunk[*pos]);
+	if (size - *pos < len) {
+		set_pending(stream, &chunk[*pos], size - *pos);
+		*pos = size;
+		neat(err);
+		return false;
+	}
+
+	/* utf8_to_nchr() doesn't read more than `len` bytes */
+	utf8_to_nchr(c, &chunk[*pos], err);
+	catch(err) {
+		return false;
+	}
+	*pos += len;
+	stream->_offset += len;
+	return true;
+}
+
+void utf8_stream_finish(utf8_stream_t *stream, error *err)
+{
+	if (stream == nil) {
+		yeet(err, EFAULT, "Stream is nil");
+		return;
+	}
+
+	if (stream->_pending_size != 0) {
+		/* same error as for other cut off sequences */
+		nchar c;
+		_neo_utf8_decode_at(&c, (const char *)stream->_pending, 0,
+				    stream->_pending_size, err);
+	} else {
+		neat(err);
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
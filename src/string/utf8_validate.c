@@ -0,0 +1,435 @@
+/** See the end of this file for copyright and license terms. */
+
+/*
+ * Bulk UTF-8 validation and code point counting.  Every string construction
+ * goes through here, so there are vectorized implementations for x86 that are
+ * selected at runtime depending on what the CPU supports, and a portable
+ * fallback that skips over ASCII eight bytes at a time.
+ *
+ * The vectorized validator is the "lookup" algorithm by John Keiser and
+ * Daniel Lemire, see <https://arxiv.org/abs/2010.03090>.  It classifies
+ * every byte by the high nibble of itself and the low and high nibble of the
+ * previous byte using three 16 entry lookup tables, which catches everything
+ * except missing or surplus continuation bytes after 3 and 4 byte sequence
+ * starts; those are checked separately by looking two and three bytes back.
+ * All of that only tells us *whether* the input is valid though, so as soon as
+ * a vector contains an error, we just run the scalar decoder over the whole
+ * string to get the same error message as before.
+ */
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#	include <immintrin.h>
+#	define UTF8_X86
+#endif
+
+#include "neo/_error.h"
+#include "neo/_types.h"
+#include "neo/_utf8.h"
+#include "neo/utf.h"
+
+static usize validate_scalar(const char *s, usize size, error *err)
+{
+	usize len = 0;
+	usize pos = 0;
+	nchar c;
+
+	/* the loop might not run at all for empty strings */
+	neat(err);
+	while (pos < size) {
+		len++;
+		pos += _neo_utf8_decode_at(&c, s, pos, size, err);
+		catch(err) {
+			break;
+		}
+	}
+
+	return len;
+}
+
+#define SWAR_HIGH_BITS	0x8080808080808080ull
+#define SWAR_LOW_BITS	0x0101010101010101ull
+
+static inline u64 swar_load(const char *s)
+{
+	u64 word;
+	memcpy(&word, s, sizeof(word));
+	return word;
+}
+
+static usize validate_swar(const char *s, usize size, error *err)
+{
+	usize len = 0;
+	usize pos = 0;
+	nchar c;
+
+	neat(err);
+	while (pos < size) {
+		if (size - pos >= 8 && (swar_load(&s[pos]) & SWAR_HIGH_BITS) == 0) {
+			pos += 8;
+			len += 8;
+			continue;
+		}
+
+		len++;
+		pos += _neo_utf8_decode_at(&c, s, pos, size, err);
+		catch(err) {
+			break;
+		}
+	}
+
+	return len;
+}
+
+static usize count_swar(const char *s, usize size)
+{
+	usize len = 0;
+	usize pos = 0;
+
+	for (; size - pos >= 8; pos += 8) {
+		u64 word = swar_load(&s[pos]);
+		/* bit 0 of every byte is set unless it is 0b10xxxxxx */
+		u64 starts = ((~word >> 7) | (word >> 6)) & SWAR_LOW_BITS;
+		len += (usize)__builtin_popcountll(starts);
+	}
+	for (; pos < size; pos++)
+		len += (s[pos] & 0xc0) != 0x80;
+
+	return len;
+}
+
+#ifdef UTF8_X86
+
+/*
+ * Error classes for the lookup tables.  A pair of bytes is invalid iff the
+ * three table entries for it have at least one bit in common.
+ */
+#define TOO_SHORT	(1 << 0) /* 11______ 0_______ or 11______ 11______ */
+#define TOO_LONG	(1 << 1) /* 0_______ 10______ */
+#define OVERLONG_3	(1 << 2) /* 11100000 100_____ */
+#define TOO_LARGE	(1 << 3) /* 11110100 1001____, 11110100 101_____, 11110101+ 10______ */
+#define SURROGATE	(1 << 4) /* 11101101 101_____ */
+#define OVERLONG_2	(1 << 5) /* 1100000_ 10______ */
+#define TOO_LARGE_1000	(1 << 6) /* 11110101+ 1000____ */
+#define OVERLONG_4	(1 << 6) /* 11110000 1000____ */
+#define TWO_CONTS	(1 << 7) /* 10______ 10______ */
+#define CARRY		(TOO_SHORT | TOO_LONG | TWO_CONTS)
+
+/** indexed by the high nibble of the previous byte */
+static const u8 byte_1_high_table[16] = {
+	/* 0_______ (ASCII) */
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+	/* 10______ (continuation) */
+	TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+	/* 1100____ */
+	TOO_SHORT | OVERLONG_2,
+	/* 1101____ */
+	TOO_SHORT,
+	/* 1110____ */
+	TOO_SHORT | OVERLONG_3 | SURROGATE,
+	/* 1111____ */
+	TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+};
+
+/** indexed by the low nibble of the previous byte */
+static const u8 byte_1_low_table[16] = {
+	/* ____0000 */
+	CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+	/* ____0001 */
+	CARRY | OVERLONG_2,
+	/* ____001_ */
+	CARRY,
+	CARRY,
+	/* ____0100 */
+	CARRY | TOO_LARGE,
+	/* ____0101 to ____1100 */
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	/* ____1101 */
+	CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+	/* ____111_ */
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+	CARRY | TOO_LARGE | TOO_LARGE_1000,
+};
+
+/** indexed by the high nibble of the current byte */
+static const u8 byte_2_high_table[16] = {
+	/* 0_______ (ASCII) */
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+	/* 1000____ */
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4,
+	/* 1001____ */
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE,
+	/* 101_____ */
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE,
+	/* 11______ */
+	TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+};
+
+/**
+ * Nonzero in the last three bytes if they start a sequence that doesn't fit
+ * into the vector, so the next one has to start with continuation bytes.
+ */
+static const u8 incomplete_table[32] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xf0 - 1, 0xe0 - 1, 0xc0 - 1,
+};
+
+__attribute__(( __target__("sse4.1") ))
+static inline __m128i sse41_check(__m128i input, __m128i prev_input)
+{
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i table1 = _mm_loadu_si128((const __m128i *)byte_1_high_table);
+	const __m128i table2 = _mm_loadu_si128((const __m128i *)byte_1_low_table);
+	const __m128i table3 = _mm_loadu_si128((const __m128i *)byte_2_high_table);
+
+	__m128i prev1 = _mm_alignr_epi8(input, prev_input, 15);
+	__m128i prev2 = _mm_alignr_epi8(input, prev_input, 14);
+	__m128i prev3 = _mm_alignr_epi8(input, prev_input, 13);
+
+	__m128i byte_1_high = _mm_shuffle_epi8(table1, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble));
+	__m128i byte_1_low = _mm_shuffle_epi8(table2, _mm_and_si128(prev1, nibble));
+	__m128i byte_2_high = _mm_shuffle_epi8(table3, _mm_and_si128(_mm_srli_epi16(input, 4), nibble));
+	__m128i special = _mm_and_si128(_mm_and_si128(byte_1_high, byte_1_low), byte_2_high);
+
+	/* the 2nd and 3rd byte after a 3 or 4 byte sequence start */
+	__m128i third = _mm_subs_epu8(prev2, _mm_set1_epi8((char)(0xe0 - 0x80)));
+	__m128i fourth = _mm_subs_epu8(prev3, _mm_set1_epi8((char)(0xf0 - 0x80)));
+	__m128i must_continue = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8((char)0x80));
+
+	return _mm_xor_si128(must_continue, special);
+}
+
+__attribute__(( __target__("sse4.1") ))
+static usize validate_sse41(const char *s, usize size, error *err)
+{
+	const __m128i max_incomplete = _mm_loadu_si128((const __m128i *)&incomplete_table[16]);
+	const __m128i last_cont = _mm_set1_epi8((char)0xbf);
+	__m128i prev_input = _mm_setzero_si128();
+	__m128i prev_incomplete = _mm_setzero_si128();
+	__m128i error = _mm_setzero_si128();
+	usize len = 0;
+	usize pos = 0;
+
+	/* the error check makes us bail out early for malformed strings */
+	for (; size - pos >= 16 && _mm_testz_si128(error, error); pos += 16) {
+		__m128i input = _mm_loadu_si128((const __m128i *)&s[pos]);
+		if (_mm_movemask_epi8(input) == 0) {
+			error = _mm_or_si128(error, prev_incomplete);
+			prev_incomplete = _mm_setzero_si128();
+			len += 16;
+		} else {
+			error = _mm_or_si128(error, sse41_check(input, prev_input));
+			prev_incomplete = _mm_subs_epu8(input, max_incomplete);
+			__m128i starts = _mm_cmpgt_epi8(input, last_cont);
+			len += (usize)__builtin_popcount((unsigned int)_mm_movemask_epi8(starts));
+		}
+		prev_input = input;
+	}
+	if (!_mm_testz_si128(error, error))
+		return validate_scalar(s, size, err);
+
+	if (pos < size) {
+		/* zero padding counts as ASCII, so a cut off sequence is TOO_SHORT */
+		char tail[16] = { 0 };
+		memcpy(tail, &s[pos], size - pos);
+		__m128i input = _mm_loadu_si128((const __m128i *)tail);
+		error = _mm_or_si128(error, sse41_check(input, prev_input));
+		__m128i starts = _mm_cmpgt_epi8(input, last_cont);
+		len += (usize)__builtin_popcount((unsigned int)_mm_movemask_epi8(starts));
+		len -= 16 - (size - pos);
+	} else {
+		error = _mm_or_si128(error, prev_incomplete);
+	}
+
+	if (!_mm_testz_si128(error, error))
+		return validate_scalar(s, size, err);
+
+	neat(err);
+	return len;
+}
+
+__attribute__(( __target__("sse4.1") ))
+static usize count_sse41(const char *s, usize size)
+{
+	const __m128i last_cont = _mm_set1_epi8((char)0xbf);
+	usize len = 0;
+	usize pos = 0;
+
+	for (; size - pos >= 16; pos += 16) {
+		__m128i input = _mm_loadu_si128((const __m128i *)&s[pos]);
+		__m128i starts = _mm_cmpgt_epi8(input, last_cont);
+		len += (usize)__builtin_popcount((unsigned int)_mm_movemask_epi8(starts));
+	}
+
+	return len + count_swar(&s[pos], size - pos);
+}
+
+/** shift `input` right by `n` bytes, shifting in the end of `prev` */
+#define avx2_prev(input, prev, n) \
+	_mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+__attribute__(( __target__("avx2") ))
+static inline __m256i avx2_check(__m256i input, __m256i prev_input)
+{
+	const __m256i nibble = _mm256_set1_epi8(0x0f);
+	const __m256i table1 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)byte_1_high_table));
+	const __m256i table2 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)byte_1_low_table));
+	const __m256i table3 = _mm256_broadcastsi128_si256(
+		_mm_loadu_si128((const __m128i *)byte_2_high_table));
+
+	__m256i prev1 = avx2_prev(input, prev_input, 1);
+	__m256i prev2 = avx2_prev(input, prev_input, 2);
+	__m256i prev3 = avx2_prev(input, prev_input, 3);
+
+	__m256i byte_1_high = _mm256_shuffle_epi8(table1, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble));
+	__m256i byte_1_low = _mm256_shuffle_epi8(table2, _mm256_and_si256(prev1, nibble));
+	__m256i byte_2_high = _mm256_shuffle_epi8(table3, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble));
+	__m256i special = _mm256_and_si256(_mm256_and_si256(byte_1_high, byte_1_low), byte_2_high);
+
+	__m256i third = _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xe0 - 0x80)));
+	__m256i fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xf0 - 0x80)));
+	__m256i must_continue = _mm256_and_si256(_mm256_or_si256(third, fourth),
+						 _mm256_set1_epi8((char)0x80));
+
+	return _mm256_xor_si256(must_continue, special);
+}
+
+__attribute__(( __target__("avx2") ))
+static usize validate_avx2(const char *s, usize size, error *err)
+{
+	const __m256i max_incomplete = _mm256_loadu_si256((const __m256i *)incomplete_table);
+	const __m256i last_cont = _mm256_set1_epi8((char)0xbf);
+	__m256i prev_input = _mm256_setzero_si256();
+	__m256i prev_incomplete = _mm256_setzero_si256();
+	__m256i error = _mm256_setzero_si256();
+	usize len = 0;
+	usize pos = 0;
+
+	for (; size - pos >= 32 && _mm256_testz_si256(error, error); pos += 32) {
+		__m256i input = _mm256_loadu_si256((const __m256i *)&s[pos]);
+		if (_mm256_movemask_epi8(input) == 0) {
+			error = _mm256_or_si256(error, prev_incomplete);
+			prev_incomplete = _mm256_setzero_si256();
+			len += 32;
+		} else {
+			error = _mm256_or_si256(error, avx2_check(input, prev_input));
+			prev_incomplete = _mm256_subs_epu8(input, max_incomplete);
+			__m256i starts = _mm256_cmpgt_epi8(input, last_cont);
+			len += (usize)__builtin_popcount((unsigned int)_mm256_movemask_epi8(starts));
+		}
+		prev_input = input;
+	}
+	if (!_mm256_testz_si256(error, error))
+		return validate_scalar(s, size, err);
+
+	if (pos < size) {
+		char tail[32] = { 0 };
+		memcpy(tail, &s[pos], size - pos);
+		__m256i input = _mm256_loadu_si256((const __m256i *)tail);
+		error = _mm256_or_si256(error, avx2_check(input, prev_input));
+		__m256i starts = _mm256_cmpgt_epi8(input, last_cont);
+		len += (usize)__builtin_popcount((unsigned int)_mm256_movemask_epi8(starts));
+		len -= 32 - (size - pos);
+	} else {
+		error = _mm256_or_si256(error, prev_incomplete);
+	}
+
+	if (!_mm256_testz_si256(error, error))
+		return validate_scalar(s, size, err);
+
+	neat(err);
+	return len;
+}
+
+__attribute__(( __target__("avx2") ))
+static usize count_avx2(const char *s, usize size)
+{
+	const __m256i last_cont = _mm256_set1_epi8((char)0xbf);
+	usize len = 0;
+	usize pos = 0;
+
+	for (; size - pos >= 32; pos += 32) {
+		__m256i input = _mm256_loadu_si256((const __m256i *)&s[pos]);
+		__m256i starts = _mm256_cmpgt_epi8(input, last_cont);
+		len += (usize)__builtin_popcount((unsigned int)_mm256_movemask_epi8(starts));
+	}
+
+	return len + count_swar(&s[pos], size - pos);
+}
+
+#endif /* UTF8_X86 */
+
+struct utf8_impl {
+	usize (*validate)(const char *s, usize size, error *err);
+	usize (*count)(const char *s, usize size);
+};
+
+static const struct utf8_impl swar_impl = { validate_swar, count_swar };
+#ifdef UTF8_X86
+static const struct utf8_impl sse41_impl = { validate_sse41, count_sse41 };
+static const struct utf8_impl avx2_impl = { validate_avx2, count_avx2 };
+#endif
+
+/*
+ * Strings are created during static initialization already (NSTR_DEFINE),
+ * so the implementation is selected on first use rather than in an init
+ * function.  Racing threads will just select the same thing twice.
+ */
+static const struct utf8_impl *utf8_impl = nil;
+
+static const struct utf8_impl *get_impl(void)
+{
+	const struct utf8_impl *impl = __atomic_load_n(&utf8_impl, __ATOMIC_RELAXED);
+	if (impl != nil)
+		return impl;
+
+	impl = &swar_impl;
+#ifdef UTF8_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		impl = &avx2_impl;
+	else if (__builtin_cpu_supports("sse4.1"))
+		impl = &sse41_impl;
+#endif
+
+	__atomic_store_n(&utf8_impl, impl, __ATOMIC_RELAXED);
+	return impl;
+}
+
+usize _neo_utf8_validate(const char *s, usize size, error *err)
+{
+	return get_impl()->validate(s, size, err);
+}
+
+usize _neo_utf8_count(const char *s, usize size)
+{
+	return get_impl()->count(s, size);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,436 @@
+/** See the end of this file for copyright and license terms. */
+
+/*
+ * Bulk conversion between UTF-8 and UTF-16/UTF-32.  Most text that crosses
+ * an API boundary is largely ASCII, so runs of ASCII characters are converted
+ * 16 at a time with SSE2 (which every x86_64 CPU has), and everything else
+ * goes through the scalar path one character at a time.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#	include <emmintrin.h>
+#	define UTF_SSE2
+#endif
+
+#include "neo/_error.h"
+#include "neo/_nbuf.h"
+#include "neo/_nref.h"
+#include "neo/_nstr.h"
+#include "neo/_types.h"
+#include "neo/_utf8.h"
+#include "neo/utf.h"
+
+static inline nchar load_unit(const u8 *p, unsigned int unit, enum utf_byteorder order)
+{
+	if (unit == 2) {
+		if (order == UTF_BE)
+			return (nchar)p[0] << 8 | (nchar)p[1];
+		else
+			return (nchar)p[1] << 8 | (nchar)p[0];
+	} else {
+		if (order == UTF_BE)
+			return (nchar)p[0] << 24 | (nchar)p[1] << 16 | (nchar)p[2] << 8 | (nchar)p[3];
+		else
+			return (nchar)p[3] << 24 | (nchar)p[2] << 16 | (nchar)p[1] << 8 | (nchar)p[0];
+	}
+}
+
+static inline void store_unit(u8 *p, nchar val, unsigned int unit, enum utf_byteorder order)
+{
+	for (unsigned int i = 0; i < unit; i++) {
+		unsigned int shift = order == UTF_BE ? 8 * (unit - 1 - i) : 8 * i;
+		p[i] = (u8)(val >> shift);
+	}
+}
+
+/** like `utf8_from_nchr()`, but `c` must be valid and there is no NUL terminator */
+static inline usize encode_utf8(char *dest, nchar c)
+{
+	if (c < 0x80) {
+		dest[0] = (char)c;
+		return 1;
+	} else if (c < 0x800) {
+		dest[0] = (char)(0xc0 | (c >> 6));
+		dest[1] = (char)(0x80 | (c & 0x3f));
+		return 2;
+	} else if (c < 0x10000) {
+		dest[0] = (char)(0xe0 | (c >> 12));
+		dest[1] = (char)(0x80 | ((c >> 6) & 0x3f));
+		dest[2] = (char)(0x80 | (c & 0x3f));
+		return 3;
+	} else {
+		dest[0] = (char)(0xf0 | (c >> 18));
+		dest[1] = (char)(0x80 | ((c >> 12) & 0x3f));
+		dest[2] = (char)(0x80 | ((c >> 6) & 0x3f));
+		dest[3] = (char)(0x80 | (c & 0x3f));
+		return 4;
+	}
+}
+
+/**
+ * Convert the ASCII prefix of the `n` bytes in `src` to `unit` byte code units.
+ * Only whole blocks of 16 characters are converted if SSE2 is available, the
+ * rest is left for the scalar path.  If `dest` is `nil`, nothing is written.
+ * Returns the number of characters converted.
+ */
+static usize ascii_widen(u8 *dest, const char *src, usize n, unsigned int unit,
+			 enum utf_byteorder order)
+{
+	usize pos = 0;
+
+#ifdef UTF_SSE2
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; n - pos >= 16; pos += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)&src[pos]);
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+		if (dest == nil)
+			continue;
+
+		/* interleaving with zeroes first or second decides the byte order */
+		__m128i w[2];
+		if (order == UTF_BE) {
+			w[0] = _mm_unpacklo_epi8(zero, v);
+			w[1] = _mm_unpackhi_epi8(zero, v);
+		} else {
+			w[0] = _mm_unpacklo_epi8(v, zero);
+			w[1] = _mm_unpackhi_epi8(v, zero);
+		}
+
+		__m128i *out = (__m128i *)&dest[pos * unit];
+		if (unit == 2) {
+			_mm_storeu_si128(&out[0], w[0]);
+			_mm_storeu_si128(&out[1], w[1]);
+		} else if (order == UTF_BE) {
+			_mm_storeu_si128(&out[0], _mm_unpacklo_epi16(zero, w[0]));
+			_mm_storeu_si128(&out[1], _mm_unpackhi_epi16(zero, w[0]));
+			_mm_storeu_si128(&out[2], _mm_unpacklo_epi16(zero, w[1]));
+			_mm_storeu_si128(&out[3], _mm_unpackhi_epi16(zero, w[1]));
+		} else {
+			_mm_storeu_si128(&out[0], _mm_unpacklo_epi16(w[0], zero));
+			_mm_storeu_si128(&out[1], _mm_unpackhi_epi16(w[0], zero));
+			_mm_storeu_si128(&out[2], _mm_unpacklo_epi16(w[1], zero));
+			_mm_storeu_si128(&out[3], _mm_unpackhi_epi16(w[1], zero));
+		}
+	}
+#else
+	for (; pos < n && (u8)src[pos] < 0x80; pos++) {
+		if (dest != nil)
+			store_unit(&dest[pos * unit], (nchar)src[pos], unit, order);
+	}
+#endif
+
+	return pos;
+}
+
+/**
+ * The opposite of `ascii_widen()`: convert the ASCII prefix of the `n` code
+ * units in `src` to single bytes.  Returns the number of code units converted.
+ */
+static usize ascii_narrow(char *dest, const u8 *src, usize n, unsigned int unit,
+			  enum utf_byteorder order)
+{
+	usize pos = 0;
+
+#ifdef UTF_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	/*
+	 * The vector lanes are always little endian, so in big endian data
+	 * the ASCII character is in the most significant byte of each lane.
+	 */
+	__m128i non_ascii;
+	if (unit == 2)
+		non_ascii = _mm_set1_epi16(order == UTF_BE ? (short)0x80ff : (short)0xff80);
+	else
+		non_ascii = _mm_set1_epi32(order == UTF_BE ? (int)0x80ffffff : (int)0xffffff80);
+
+	for (; n - pos >= 16; pos += 16) {
+		const __m128i *in = (const __m128i *)&src[pos * unit];
+		__m128i v[4];
+		__m128i bad = zero;
+		/* 16 code units are 2 vectors for UTF-16 and 4 for UTF-32 */
+		for (unsigned int i = 0; i < unit; i++) {
+			v[i] = _mm_loadu_si128(&in[i]);
+			bad = _mm_or_si128(bad, _mm_and_si128(v[i], non_ascii));
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(bad, zero)) != 0xffff)
+			break;
+		if (dest == nil)
+			continue;
+
+		__m128i packed;
+		if (unit == 2) {
+			if (order == UTF_BE) {
+				v[0] = _mm_srli_epi16(v[0], 8);
+				v[1] = _mm_srli_epi16(v[1], 8);
+			}
+			packed = _mm_packus_epi16(v[0], v[1]);
+		} else {
+			if (order == UTF_BE) {
+				for (unsigned int i = 0; i < 4; i++)
+					v[i] = _mm_srli_epi32(v[i], 24);
+			}
+			packed = _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]),
+						  _mm_packs_epi32(v[2], v[3]));
+		}
+		_mm_storeu_si128((__m128i *)&dest[pos], packed);
+	}
+#else
+	for (; pos < n; pos++) {
+		nchar c = load_unit(&src[pos * unit], unit, order);
+		if (c >= 0x80)
+			break;
+		if (dest != nil)
+			dest[pos] = (char)c;
+	}
+#endif
+
+	return pos;
+}
+
+static usize from_utf8(u8 *dest, usize dest_size, const char *src, usize src_size,
+		       unsigned int unit, enum utf_byteorder order, usize *errpos, error *err)
+{
+	usize in = 0;
+	usize out = 0;
+
+	if (src == nil) {
+		yeet(err, EFAULT, "Source is nil");
+		if (errpos != nil)
+			*errpos = 0;
+		return 0;
+	}
+
+	while (in < src_size) {
+		usize n = src_size - in;
+		if (dest != nil && n > (dest_size - out) / unit)
+			n = (dest_size - out) / unit;
+		usize ascii = ascii_widen(dest == nil ? nil : &dest[out], &src[in], n, unit, order);
+		in += ascii;
+		out += ascii * unit;
+		if (in == src_size)
+			break;
+
+		nchar c;
+		usize len;
+		if ((u8)src[in] < 0x80) {
+			c = (nchar)src[in];
+			len = 1;
+		} else {
+			len = _neo_utf8_decode_at(&c, src, in, src_size, err);
+			catch(err) {
+				break;
+			}
+		}
+
+		/* characters outside the BMP need a surrogate pair in UTF-16 */
+		usize size = unit == 2 && c > 0xffff ? 4 : unit;
+		if (dest != nil) {
+			if (dest_size - out < size) {
+				yeet(err, ERANGE, "Destination buffer too small");
+				break;
+			}
+			if (size == 4 && unit == 2) {
+				nchar v = c - 0x10000;
+				store_unit(&dest[out], 0xd800 | (v >> 10), 2, order);
+				store_unit(&dest[out + 2], 0xdc00 | (v & 0x3ff), 2, order);
+			} else {
+				store_unit(&dest[out], c, unit, order);
+			}
+		}
+
+		in += len;
+		out += size;
+	}
+
+	if (errpos != nil)
+		*errpos = in;
+	if (in == src_size)
+		neat(err);
+	return out;
+}
+
+static usize to_utf8(char *dest, usize dest_size, const u8 *src, usize src_size,
+		     unsigned int unit, enum utf_byteorder order, usize *errpos, error *err)
+{
+	usize in = 0;
+	usize out = 0;
+
+	if (src == nil) {
+		yeet(err, EFAULT, "Source is nil");
+		if (errpos != nil)
+			*errpos = 0;
+		return 0;
+	}
+
+	usize whole = src_size - src_size % unit;
+	while (in < whole) {
+		usize n = (whole - in) / unit;
+		if (dest != nil && n > dest_size - out)
+			n = dest_size - out;
+		usize ascii = ascii_narrow(dest == nil ? nil : &dest[out], &src[in], n, unit, order);
+		in += ascii * unit;
+		out += ascii;
+		if (in == whole)
+			break;
+
+		usize len = unit;
+		nchar c = load_unit(&src[in], unit, order);
+		if (unit == 2 && (c & 0xf800) == 0xd800) {
+			nchar low = in + 4 <= whole ? load_unit(&src[in + 2], 2, order) : 0;
+			if (c >= 0xdc00 || (low & 0xfc00) != 0xdc00) {
+				yeet(err, EINVAL, "Unpaired UTF-16 surrogate: 0x%04x", (unsigned int)c);
+				break;
+			}
+			c = 0x10000 + ((c & 0x3ff) << 10) + (low & 0x3ff);
+			len = 4;
+		} else if (unit == 4 && (c > 0x10ffff || (c & 0xfffff800) == 0xd800)) {
+			yeet(err, EINVAL, "Illegal Unicode code point in UTF-32 data: 0x%08x",
+			     (unsigned int)c);
+			break;
+		}
+
+		usize size = 1 + (c > 0x7f) + (c > 0x7ff) + (c > 0xffff);
+		if (dest != nil) {
+			if (dest_size - out < size) {
+				yeet(err, ERANGE, "Destination buffer too small");
+				break;
+			}
+			encode_utf8(&dest[out], c);
+		}
+
+		in += len;
+		out += size;
+	}
+
+	if (errpos != nil)
+		*errpos = in;
+	if (in == whole) {
+		if (whole != src_size) {
+			yeet(err, EINVAL, "UTF-%u data size is not a multiple of %u",
+			     unit * 8, unit);
+		} else {
+			neat(err);
+		}
+	}
+	return out;
+}
+
+usize utf8_to_utf16(void *restrict dest, usize dest_size,
+		    const char *restrict src, usize src_size,
+		    enum utf_byteorder order, usize *errpos, error *err)
+{
+	return from_utf8(dest, dest_size, src, src_size, 2, order, errpos, err);
+}
+
+usize utf16_to_utf8(char *restrict dest, usize dest_size,
+		    const void *restrict src, usize src_size,
+		    enum utf_byteorder order, usize *errpos, error *err)
+{
+	return to_utf8(dest, dest_size, src, src_size, 2, order, errpos, err);
+}
+
+usize utf8_to_utf32(void *restrict dest, usize dest_size,
+		    const char *restrict src, usize src_size,
+		    enum utf_byteorder order, usize *errpos, error *err)
+{
+	return from_utf8(dest, dest_size, src, src_size, 4, order, errpos, err);
+}
+
+usize utf32_to_utf8(char *restrict dest, usize dest_size,
+		    const void *restrict src, usize src_size,
+		    enum utf_byteorder order, usize *errpos, error *err)
+{
+	return to_utf8(dest, dest_size, src, src_size, 4, order, errpos, err);
+}
+
+static nbuf_t *nstr_to_units(const nstr_t *s, unsigned int unit, enum utf_byteorder order,
+			     error *err)
+{
+	if (s == nil) {
+		yeet(err, EFAULT, "String is nil");
+		return nil;
+	}
+
+	/* strings are always valid, so this can't fail */
+	usize size;
+	if (unit == 4)
+		size = nlen(s) * 4;
+	else
+		size = from_utf8(nil, 0, s->_data, _neo_nstr_size(s), unit, order, nil, nil);
+
+	nbuf_t *buf = nbuf_create(size, err);
+	catch(err) {
+		return nil;
+	}
+
+	from_utf8((u8 *)buf->_data, size, s->_data, _neo_nstr_size(s), unit, order, nil, err);
+	return buf;
+}
+
+nbuf_t *nstr_to_utf16(const nstr_t *s, enum utf_byteorder order, error *err)
+{
+	return nstr_to_units(s, 2, order, err);
+}
+
+nbuf_t *nstr_to_utf32(const nstr_t *s, enum utf_byteorder order, error *err)
+{
+	return nstr_to_units(s, 4, order, err);
+}
+
+static nstr_t *units_to_nstr(const u8 *src, usize src_size, unsigned int unit,
+			     enum utf_byteorder order, usize *errpos, error *err)
+{
+	usize size = to_utf8(nil, 0, src, src_size, unit, order, errpos, err);
+	catch(err) {
+		return nil;
+	}
+
+	/* NUL is a single code unit in every encoding */
+	for (usize pos = 0; pos < src_size; pos += unit) {
+		if (load_unit(&src[pos], unit, order) == 0) {
+			if (errpos != nil)
+				*errpos = pos;
+			yeet(err, EINVAL, "String contains NUL characters");
+			return nil;
+		}
+	}
+
+	nstr_t *s = _neo_nstr_alloc(size, 0, err);
+	catch(err) {
+		return nil;
+	}
+
+	to_utf8((char *)s->_data, size, src, src_size, unit, order, nil, err);
+	s->_len = _neo_utf8_count(s->_data, size);
+	return s;
+}
+
+nstr_t *utf16_to_nstr(const void *src, usize src_size, enum utf_byteorder order,
+		      usize *errpos, error *err)
+{
+	return units_to_nstr(src, src_size, 2, order, errpos, err);
+}
+
+nstr_t *utf32_to_nstr(const void *src, usize src_size, enum utf_byteorder order,
+		      usize *errpos, error *err)
+{
+	return units_to_nstr(src, src_size, 4, order, errpos, err);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -5,8 +5,9 @@
 #include "neo/_error.h"
 #include "neo/_nstr.h"
 #include "neo/_types.h"
+#include "neo/_x2nstr.h"
 
-static char *unsigned_convert(char *end, u64 n, int radix, error *err)
+char *_neo_unsigned_convert(char *end, u64 n, int radix, error *err)
 {
 	static const char digits[] = {
 		'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b',
@@ -34,7 +35,7 @@ static char *unsigned_convert(char *end, u64 n, int radix, error *err)
 nstr_t *u2nstr(u64 n, int radix, error *err)
 {
 	char buf[65];
-	char *s = unsigned_convert(&buf[64], n, radix, err);
+	char *s = _neo_unsigned_convert(&buf[64], n, radix, err);
 	catch (err) {
 		return nil;
 	}
@@ -45,7 +46,9 @@ nstr_t *i2nstr(i64 n, int radix, error *err)
 {
 	char buf[66];
 
-	char *s = unsigned_convert(&buf[65], nabs(n), radix, err);
+	/* nabs() would overflow for INT64_MIN */
+	u64 magnitude = n < 0 ? -(u64)n : (u64)n;
+	char *s = _neo_unsigned_convert(&buf[65], magnitude, radix, err);
 	catch(err) {
 		return nil;
 	}
@@ -0,0 +1,201 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <errno.h>
+
+#include <neo.h>
+#include <neo/chashtab.h>
+
+#define CHASHTAB_TEST_MAGIC 0x6e656f21
+
+extern "C" struct chashtab_test {
+	unsigned int magic;
+	unsigned int number;
+	std::atomic<int> *destroyed;
+	NREF_FIELD;
+};
+
+static void chashtab_test_destroy(struct chashtab_test *ptr)
+{
+	ptr->magic = 0;
+	(*ptr->destroyed)++;
+	delete ptr;
+}
+
+static struct chashtab_test *chashtab_test_create(unsigned int number,
+						  std::atomic<int> *destroyed)
+{
+	struct chashtab_test *val = new chashtab_test();
+	val->magic = CHASHTAB_TEST_MAGIC;
+	val->number = number;
+	val->destroyed = destroyed;
+	nref_init(val, chashtab_test_destroy);
+	return val;
+}
+
+static nbuf_t *chashtab_test_key(unsigned int number)
+{
+	nstr_t *s = u2nstr(number, 10, nil);
+	nbuf_t *key = nbuf_from_nstr(s, nil);
+	nput(s);
+	return key;
+}
+
+SCENARIO( "chashtab: items can be inserted and removed", "[src/chashtab.c]" )
+{
+	GIVEN( "an empty concurrent hash table" )
+	{
+		error err;
+		std::atomic<int> destroyed(0);
+		chashtab_t *table = chashtab_create(16, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( table != nil );
+
+		nbuf_t *key = chashtab_test_key(1);
+		struct chashtab_test *val = chashtab_test_create(1, &destroyed);
+
+		WHEN( "an item is inserted" )
+		{
+			chashtab_put(table, key, val, &err);
+			REQUIRE( errnum(&err) == 0 );
+			REQUIRE( nlen(table) == 1 );
+
+			THEN( "it can be retrieved and holds a new reference" )
+			{
+				struct chashtab_test *got =
+					(struct chashtab_test *)chashtab_get(table, key, &err);
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( got == val );
+				REQUIRE( nref_count(val) == 3 );
+				nput(got);
+			}
+
+			THEN( "inserting the same key again fails" )
+			{
+				chashtab_put(table, key, val, &err);
+				REQUIRE( errnum(&err) == EEXIST );
+				errput(&err);
+			}
+
+			THEN( "it can be deleted" )
+			{
+				struct chashtab_test *removed =
+					(struct chashtab_test *)chashtab_del(table, key, &err);
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( removed == val );
+				REQUIRE( nlen(table) == 0 );
+				REQUIRE( chashtab_get(table, key, &err) == nil );
+				REQUIRE( chashtab_del(table, key, &err) == nil );
+				nput(removed);
+			}
+
+			THEN( "deleted values can be released right away" )
+			{
+				struct chashtab_test *removed =
+					(struct chashtab_test *)chashtab_del(table, key, &err);
+				REQUIRE( errnum(&err) == 0 );
+				nput(removed);
+				/* the table still holds its reference in the retire list */
+				REQUIRE( nref_count(val) == 2 );
+				chashtab_reclaim(table);
+				REQUIRE( nref_count(val) == 1 );
+			}
+		}
+
+		nput(val);
+		nput(key);
+		nput(table);
+		REQUIRE( destroyed == 1 );
+	}
+}
+
+SCENARIO( "chashtab: values are not released while readers hold them",
+	  "[src/chashtab.c]" )
+{
+	GIVEN( "a table shared between threads" )
+	{
+		const unsigned int count = 256;
+		const unsigned int readers = 4;
+		const unsigned int rounds = 200;
+		std::atomic<int> destroyed(0);
+		std::atomic<int> created(0);
+		std::atomic<bool> broken(false);
+		std::atomic<bool> done(false);
+
+		chashtab_t *table = chashtab_create(count, nil);
+		std::vector<nbuf_t *> keys(count);
+		for (unsigned int i = 0; i < count; i++)
+			keys[i] = chashtab_test_key(i);
+
+		WHEN( "readers look up items while writers replace them" )
+		{
+			std::vector<std::thread> threads;
+			for (unsigned int r = 0; r < readers; r++) {
+				threads.emplace_back([&, r]() {
+					unsigned int i = r;
+					while (!done) {
+						i = (i + 7) % count;
+						auto val = (struct chashtab_test *)
+							chashtab_get(table, keys[i], nil);
+						if (val == nil)
+							continue;
+						if (val->magic != CHASHTAB_TEST_MAGIC || val->number != i)
+							broken = true;
+						nput(val);
+					}
+				});
+			}
+
+			for (unsigned int round = 0; round < rounds; round++) {
+				for (unsigned int i = 0; i < count; i++) {
+					auto val = chashtab_test_create(i, &destroyed);
+					created++;
+					chashtab_put(table, keys[i], val, nil);
+					nput(val);
+				}
+				for (unsigned int i = 0; i < count; i++) {
+					auto val = (struct chashtab_test *)
+						chashtab_del(table, keys[i], nil);
+					nput(val);
+				}
+			}
+
+			done = true;
+			for (auto &thread : threads)
+				thread.join();
+
+			THEN( "no reader ever saw a released value" )
+			{
+				REQUIRE( !broken );
+			}
+
+			THEN( "all values are released when the table is" )
+			{
+				REQUIRE( nlen(table) == 0 );
+				nput(table);
+				REQUIRE( destroyed == created );
+			}
+		}
+
+		if (table != nil)
+			nput(table);
+		for (unsigned int i = 0; i < count; i++)
+			nput(keys[i]);
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
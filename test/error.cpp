@@ -0,0 +1,207 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include <neo.h>
+
+static int allocs;
+
+static void *counting_alloc(usize size, void *ctx)
+{
+	(void)ctx;
+	allocs++;
+	return malloc(size);
+}
+
+static void counting_free(void *ptr, void *ctx)
+{
+	(void)ctx;
+	free(ptr);
+}
+
+static bool message_is(error *err, const char *expected)
+{
+	nstr_t *msg = errmsg(err);
+	return msg != nil && strcmp(nstr_raw(msg), expected) == 0;
+}
+
+TEST_CASE( "yeet: Raising and catching doesn't allocate", "[src/error.c]" )
+{
+	struct nalloc_backend backend;
+	backend.alloc = counting_alloc;
+	backend.zalloc = nil;
+	backend.realloc = nil;
+	backend.free = counting_free;
+	backend.ctx = nil;
+	allocs = 0;
+
+	error err;
+	const struct nalloc_backend *prev = nalloc_scope_enter(&backend);
+	yeet(&err, EINVAL, "Byte %d is invalid: 0x%02x", 2, 0xff);
+	ncatch(&err) {
+		errput(&err);
+	}
+	nalloc_scope_exit(prev);
+
+	REQUIRE( allocs == 0 );
+}
+
+TEST_CASE( "yeet: Format message lazily", "[src/error.c]" )
+{
+	error err;
+	int i = -42;
+	long l = 1234567890L;
+	long long ll = -1234567890123LL;
+	usize z = 1337;
+	void *p = (void *)0x1000;
+	char expected[256];
+
+	yeet(&err, EINVAL, "%d %5i %-4u| %lx %lld %zu %c %.2f %p %% %08X",
+	     i, i, 7u, l, ll, z, 'x', 3.14159, p, 0xbeefu);
+	snprintf(expected, sizeof(expected), "%d %5i %-4u| %lx %lld %zu %c %.2f %p %% %08X",
+		 i, i, 7u, l, ll, z, 'x', 3.14159, p, 0xbeefu);
+
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( message_is(&err, expected) );
+	/* the second call returns the cached message */
+	REQUIRE( errmsg(&err) == errmsg(&err) );
+	errput(&err);
+}
+
+TEST_CASE( "yeet: Format strings and long messages", "[src/error.c]" )
+{
+	error err;
+	char name[] = "owo";
+
+	yeet(&err, ENOENT, "Key not found: %s", name);
+	/* strings are formatted right away, so this must not matter */
+	name[0] = 'u';
+	REQUIRE( message_is(&err, "Key not found: owo") );
+	errput(&err);
+
+	char expected[301];
+	memset(expected, '0', 300);
+	expected[300] = '\0';
+	yeet(&err, ERANGE, "%0300d", 0);
+	REQUIRE( message_is(&err, expected) );
+	errput(&err);
+
+	yeet(&err, EFAULT, nil);
+	REQUIRE( errmsg(&err) == nil );
+	errput(&err);
+}
+
+TEST_CASE( "yeet: Overlong conversion specifications", "[src/error.c]" )
+{
+	error err;
+	/* built at runtime so the compiler doesn't complain about the flags */
+	char fmt[80];
+	char expected[80];
+
+	/* "%000...000%" */
+	fmt[0] = '%';
+	memset(&fmt[1], '0', 70);
+	fmt[71] = '%';
+	fmt[72] = '\0';
+	yeet(&err, EINVAL, fmt, 0);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( errmsg(&err) != nil );
+	errput(&err);
+
+	/* "%000...0005d" */
+	memset(&fmt[1], '0', 40);
+	strcpy(&fmt[41], "5d");
+	snprintf(expected, sizeof(expected), fmt, 42);
+	yeet(&err, EINVAL, fmt, 42);
+	REQUIRE( message_is(&err, expected) );
+	errput(&err);
+}
+
+NSTR_STATIC(not_found, "Key not found");
+
+TEST_CASE( "yeet_nstr: Raise error with static message", "[src/error.c]" )
+{
+	error err;
+
+	yeet_nstr(&err, ENOENT, not_found);
+	REQUIRE( errnum(&err) == ENOENT );
+	REQUIRE( errmsg(&err) == not_found );
+	errput(&err);
+
+	nstr_t *dynamic = nstr("owo", nil);
+	yeet_nstr(&err, ENOENT, dynamic);
+	REQUIRE( nref_count(dynamic) == 2 );
+	errput(&err);
+	REQUIRE( nref_count(dynamic) == 1 );
+	nput(dynamic);
+}
+
+TEST_CASE( "error_trace: Recent errors are recorded per thread", "[src/error.c]" )
+{
+	error err;
+	u64 before = error_count(EDOM, &err);
+	if (errnum(&err) == ENOSYS) {
+		/* libneo was built without ERROR_TRACE */
+		errput(&err);
+		return;
+	}
+	REQUIRE( errnum(&err) == 0 );
+
+	int line = __LINE__ + 1;
+	yeet(&err, EDOM, "first");
+	errput(&err);
+	yeet_nstr(&err, ERANGE, not_found);
+	errput(&err);
+
+	struct error_trace_entry entries[ERROR_TRACE_SIZE];
+	usize count = error_trace(entries, ERROR_TRACE_SIZE, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( count >= 2 );
+	REQUIRE( entries[0].number == ERANGE );
+	REQUIRE( entries[0].line == line + 2 );
+	REQUIRE( entries[1].number == EDOM );
+	REQUIRE( entries[1].line == line );
+	REQUIRE( strcmp(entries[1].file, __FILE__) == 0 );
+	REQUIRE( entries[0].time >= entries[1].time );
+
+	REQUIRE( error_count(EDOM, &err) == before + 1 );
+
+	/* only the newest ERROR_TRACE_SIZE errors are kept */
+	for (int i = 0; i < ERROR_TRACE_SIZE + 5; i++) {
+		yeet(&err, EDOM, "again");
+		errput(&err);
+	}
+	count = error_trace(entries, ERROR_TRACE_SIZE, &err);
+	REQUIRE( count == ERROR_TRACE_SIZE );
+	REQUIRE( entries[ERROR_TRACE_SIZE - 1].number == EDOM );
+	REQUIRE( error_count(EDOM, &err) == before + ERROR_TRACE_SIZE + 6 );
+
+	count = error_trace(entries, 1, &err);
+	REQUIRE( count == 1 );
+
+	/* other threads have their own trace */
+	usize other_count = 1;
+	std::thread other([&other_count] {
+		struct error_trace_entry e;
+		other_count = error_trace(&e, 1, nil);
+	});
+	other.join();
+	REQUIRE( other_count == 0 );
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
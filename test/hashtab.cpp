@@ -84,6 +84,165 @@ SCENARIO( "hashtab: items can be inserted and removed", "[src/hashtab.c]" )
 	}
 }
 
+static int count_entries(hashtab_t *table, nbuf_t *key, void *val, void *extra)
+{
+	(*(unsigned int *)extra)++;
+	return 0;
+}
+
+SCENARIO( "hashtab: flat tables grow and support deletion", "[src/hashtab_flat.c]" )
+{
+	GIVEN( "an empty flat hash table" )
+	{
+		error err;
+		hashtab_t *table = hashtab_create_flags(16, HASHTAB_FLAT, nil, &err);
+
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( table != nil );
+		REQUIRE( nlen(table) == 0 );
+
+		WHEN( "many more items than the initial capacity are inserted" )
+		{
+			const unsigned int count = 1000;
+			auto keys = std::vector<nbuf_t *>(count);
+			auto vals = std::vector<struct test_item>(count);
+			for (unsigned int i = 0; i < count; i++) {
+				auto s = u2nstr(i, 10, nil);
+				keys[i] = nbuf_from_nstr(s, nil);
+				nput(s);
+				vals[i].number = i;
+				hashtab_put(table, keys[i], &vals[i], &err);
+				REQUIRE( errnum(&err) == 0 );
+			}
+			REQUIRE( nlen(table) == count );
+
+			THEN( "all items can be retrieved" )
+			{
+				for (unsigned int i = 0; i < count; i++) {
+					auto val = (struct test_item *)hashtab_get(
+						table,
+						keys[i],
+						&err
+					);
+					REQUIRE( val == &vals[i] );
+					REQUIRE( errnum(&err) == 0 );
+				}
+
+				unsigned int iterations = 0;
+				hashtab_foreach(table, count_entries, &iterations, &err);
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( iterations == count );
+			}
+
+			THEN( "inserting an existing key fails" )
+			{
+				hashtab_put(table, keys[0], &vals[1], &err);
+				REQUIRE( errnum(&err) == EEXIST );
+				errput(&err);
+				REQUIRE( hashtab_get(table, keys[0], nil) == &vals[0] );
+			}
+
+			THEN( "deleted items are gone and the rest is still there" )
+			{
+				for (unsigned int i = 0; i < count; i += 2) {
+					void *val = hashtab_del(table, keys[i], &err);
+					REQUIRE( val == &vals[i] );
+					REQUIRE( errnum(&err) == 0 );
+				}
+				REQUIRE( nlen(table) == count / 2 );
+
+				for (unsigned int i = 0; i < count; i++) {
+					void *val = hashtab_get(table, keys[i], &err);
+					REQUIRE( errnum(&err) == 0 );
+					if (i % 2 == 0)
+						REQUIRE( val == nil );
+					else
+						REQUIRE( val == &vals[i] );
+				}
+			}
+
+			for (unsigned int i = 0; i < count; i++)
+				nput(keys[i]);
+		}
+
+		nput(table);
+	}
+}
+
+SCENARIO( "hashtab: tables resize incrementally", "[src/hashtab.c]" )
+{
+	auto flags = GENERATE( HASHTAB_CHAINED | HASHTAB_SHRINK,
+			       HASHTAB_FLAT | HASHTAB_SHRINK );
+
+	GIVEN( "a small shrinkable hash table" )
+	{
+		error err;
+		hashtab_t *table = hashtab_create_flags(4, flags, nil, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( hashtab_rehash_progress(table) == 1 );
+
+		const unsigned int count = 2000;
+		auto keys = std::vector<nbuf_t *>(count);
+		auto vals = std::vector<struct test_item>(count);
+		for (unsigned int i = 0; i < count; i++) {
+			auto s = u2nstr(i, 16, nil);
+			keys[i] = nbuf_from_nstr(s, nil);
+			nput(s);
+			vals[i].number = i;
+		}
+
+		WHEN( "many items are inserted" )
+		{
+			bool saw_rehash = false;
+			for (unsigned int i = 0; i < count; i++) {
+				hashtab_put(table, keys[i], &vals[i], &err);
+				REQUIRE( errnum(&err) == 0 );
+
+				f32 progress = hashtab_rehash_progress(table);
+				REQUIRE( progress >= 0 );
+				REQUIRE( progress <= 1 );
+				if (progress < 1)
+					saw_rehash = true;
+
+				/* every item must be reachable while rehashing */
+				unsigned int j = i / 2;
+				REQUIRE( hashtab_get(table, keys[j], &err) == &vals[j] );
+			}
+
+			THEN( "the table grew and all items are still there" )
+			{
+				REQUIRE( saw_rehash );
+				REQUIRE( nlen(table) == count );
+				REQUIRE( hashtab_load_factor(table) <= 1.0f );
+				for (unsigned int i = 0; i < count; i++)
+					REQUIRE( hashtab_get(table, keys[i], &err) == &vals[i] );
+			}
+
+			WHEN( "almost all items are deleted again" )
+			{
+				f32 size_before = count / hashtab_load_factor(table);
+				for (unsigned int i = 1; i < count; i++)
+					REQUIRE( hashtab_del(table, keys[i], &err) == &vals[i] );
+				/* complete the last shrinking pass */
+				for (unsigned int i = 0; i < count; i++)
+					hashtab_get(table, keys[0], nil);
+
+				THEN( "the table shrunk" )
+				{
+					REQUIRE( nlen(table) == 1 );
+					f32 size_after = 1 / hashtab_load_factor(table);
+					REQUIRE( size_after < size_before );
+					REQUIRE( hashtab_get(table, keys[0], &err) == &vals[0] );
+				}
+			}
+		}
+
+		for (unsigned int i = 0; i < count; i++)
+			nput(keys[i]);
+		nput(table);
+	}
+}
+
 /*
  * This file is part of libneo.
  * Copyright (c) 2021 Fefie <owo@fef.moe>.
@@ -0,0 +1,192 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+#include <neo.h>
+
+struct counting_backend {
+	struct nalloc_backend backend;
+	int allocs;
+	int frees;
+};
+
+static void *counting_alloc(usize size, void *ctx)
+{
+	((struct counting_backend *)ctx)->allocs++;
+	return malloc(size);
+}
+
+static void counting_free(void *ptr, void *ctx)
+{
+	((struct counting_backend *)ctx)->frees++;
+	free(ptr);
+}
+
+static void counting_init(struct counting_backend *cb)
+{
+	cb->backend.alloc = counting_alloc;
+	cb->backend.zalloc = nil;
+	cb->backend.realloc = nil;
+	cb->backend.free = counting_free;
+	cb->backend.ctx = cb;
+	cb->allocs = 0;
+	cb->frees = 0;
+}
+
+SCENARIO( "nalloc: memory is allocated through the backend", "[src/nalloc.c]" )
+{
+	GIVEN( "a custom process-wide backend" )
+	{
+		struct counting_backend cb;
+		counting_init(&cb);
+		const struct nalloc_backend *prev = nalloc_backend_set(&cb.backend);
+		REQUIRE( nalloc_backend_get() == &cb.backend );
+
+		WHEN( "memory is allocated and resized" )
+		{
+			error err;
+			u8 *ptr = (u8 *)nzalloc(32, &err);
+			REQUIRE( errnum(&err) == 0 );
+			for (unsigned int i = 0; i < 32; i++)
+				REQUIRE( ptr[i] == 0 );
+			memset(ptr, 0x55, 32);
+			ptr = (u8 *)nrealloc(ptr, 4096, &err);
+			REQUIRE( errnum(&err) == 0 );
+
+			THEN( "the contents are kept and the backend is used" )
+			{
+				for (unsigned int i = 0; i < 32; i++)
+					REQUIRE( ptr[i] == 0x55 );
+				nfree(ptr);
+				REQUIRE( cb.allocs == 2 );
+				REQUIRE( cb.frees == 2 );
+			}
+		}
+
+		WHEN( "the backend is replaced before memory is released" )
+		{
+			void *ptr = nalloc(16, nil);
+			nalloc_backend_set(prev);
+			nfree(ptr);
+
+			THEN( "the memory is released through its own backend" )
+			{
+				REQUIRE( cb.allocs == 1 );
+				REQUIRE( cb.frees == 1 );
+			}
+		}
+
+		nalloc_backend_set(prev);
+		REQUIRE( nalloc_backend_get() == prev );
+	}
+
+	GIVEN( "a thread scope with a custom backend" )
+	{
+		struct counting_backend cb;
+		counting_init(&cb);
+
+		WHEN( "an error is yeeted within the scope" )
+		{
+			error err;
+			const struct nalloc_backend *prev = nalloc_scope_enter(&cb.backend);
+			yeet(&err, EINVAL, "owo %d", 420);
+			nalloc_scope_exit(prev);
+
+			THEN( "nothing is allocated until its message is formatted" )
+			{
+				REQUIRE( cb.allocs == 0 );
+				prev = nalloc_scope_enter(&cb.backend);
+				REQUIRE( errmsg(&err) != nil );
+				nalloc_scope_exit(prev);
+				REQUIRE( cb.allocs > 0 );
+				errput(&err);
+				REQUIRE( cb.allocs == cb.frees );
+			}
+		}
+
+		WHEN( "another thread allocates memory" )
+		{
+			const struct nalloc_backend *prev = nalloc_scope_enter(&cb.backend);
+			const struct nalloc_backend *other = nil;
+			std::thread thread([&]() {
+				other = nalloc_backend_get();
+			});
+			thread.join();
+			nalloc_scope_exit(prev);
+
+			THEN( "it is not affected by the scope" )
+			{
+				REQUIRE( other != &cb.backend );
+				REQUIRE( nalloc_backend_get() != &cb.backend );
+			}
+		}
+	}
+}
+
+SCENARIO( "nalloc: allocations are tracked per call site", "[src/nalloc.c]" )
+{
+	GIVEN( "a snapshot of the current statistics" )
+	{
+		error err;
+		struct nalloc_stats before;
+		nalloc_stats(&before, &err);
+		if (errnum(&err) == ENOSYS) {
+			/* libneo was built without NALLOC_STATS */
+			errput(&err);
+			return;
+		}
+		REQUIRE( errnum(&err) == 0 );
+
+		WHEN( "memory is allocated" )
+		{
+			int line = __LINE__ + 1;
+			void *ptr = nalloc(100, nil);
+			struct nalloc_stats after;
+			nalloc_stats(&after, nil);
+
+			THEN( "it shows up in the global statistics" )
+			{
+				REQUIRE( after.allocs >= before.allocs + 1 );
+				REQUIRE( after.peak_bytes >= 100 );
+				REQUIRE( after.class_allocs[3] >= before.class_allocs[3] + 1 );
+			}
+
+			THEN( "it is accounted to its call site until it is released" )
+			{
+				struct nalloc_site_stats sites[1024];
+				usize count = nalloc_site_stats(sites, 1024, &err);
+				REQUIRE( errnum(&err) == 0 );
+
+				bool found = false;
+				for (usize i = 0; i < nmin(count, (usize)1024); i++) {
+					if (sites[i].line == line
+					    && strcmp(sites[i].file, __FILE__) == 0) {
+						REQUIRE( sites[i].live_count == 1 );
+						REQUIRE( sites[i].live_bytes == 100 );
+						found = true;
+					}
+				}
+				REQUIRE( found );
+			}
+
+			nfree(ptr);
+		}
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
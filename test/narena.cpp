@@ -0,0 +1,175 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <string.h>
+
+#include <neo.h>
+#include <neo/narena.h>
+
+SCENARIO( "narena: memory can be allocated from arenas", "[src/narena.c]" )
+{
+	GIVEN( "an arena with small chunks" )
+	{
+		error err;
+		u32 flags = GENERATE(0u, NARENA_MMAP);
+		narena_t *arena = narena_create(256, flags, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( arena != nil );
+
+		WHEN( "many objects are allocated" )
+		{
+			u8 *objs[64];
+			for (unsigned int i = 0; i < 64; i++) {
+				objs[i] = (u8 *)narena_alloc(arena, i + 1, &err);
+				REQUIRE( errnum(&err) == 0 );
+				memset(objs[i], (int)i, i + 1);
+			}
+
+			THEN( "they are aligned and don't overlap" )
+			{
+				for (unsigned int i = 0; i < 64; i++) {
+					REQUIRE( ((uintptr_t)objs[i] & 15) == 0 );
+					for (unsigned int j = 0; j <= i; j++)
+						REQUIRE( objs[i][j] == (u8)i );
+				}
+			}
+
+			THEN( "resetting the arena makes its memory reusable" )
+			{
+				narena_reset(arena);
+				REQUIRE( (usize)(arena->_end - arena->_pos) >= 200 );
+				u8 *start = arena->_pos;
+				void *ptr = narena_alloc(arena, 16, &err);
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( ptr == start );
+			}
+		}
+
+		WHEN( "an object larger than a chunk is allocated" )
+		{
+			u8 *ptr = (u8 *)narena_alloc(arena, 4096, &err);
+			REQUIRE( errnum(&err) == 0 );
+
+			THEN( "it gets a dedicated chunk" )
+			{
+				memset(ptr, 0x55, 4096);
+				REQUIRE( ptr[4095] == 0x55 );
+			}
+		}
+
+		WHEN( "zero bytes are requested" )
+		{
+			void *ptr = narena_alloc(arena, 0, &err);
+
+			THEN( "an error is yeeted" )
+			{
+				REQUIRE( ptr == nil );
+				REQUIRE( errnum(&err) == EINVAL );
+				errput(&err);
+			}
+		}
+
+		WHEN( "a size that would overflow is requested" )
+		{
+			usize size = GENERATE((usize)-1, (usize)-1 - 15, (usize)-1 - 20);
+			void *ptr = narena_alloc(arena, size, &err);
+
+			THEN( "an error is yeeted" )
+			{
+				REQUIRE( ptr == nil );
+				REQUIRE( errnum(&err) == ERANGE );
+				errput(&err);
+			}
+		}
+
+		nput(arena);
+	}
+
+	GIVEN( "invalid flags" )
+	{
+		error err;
+		narena_t *arena = narena_create(0, 0x80000000u, &err);
+
+		THEN( "no arena is created" )
+		{
+			REQUIRE( arena == nil );
+			REQUIRE( errnum(&err) == EINVAL );
+			errput(&err);
+		}
+	}
+}
+
+SCENARIO( "narena: strings and buffers can live in arenas", "[src/narena.c]" )
+{
+	GIVEN( "an arena" )
+	{
+		error err;
+		narena_t *arena = narena_create(0, 0, &err);
+		REQUIRE( errnum(&err) == 0 );
+
+		WHEN( "a string is created in it" )
+		{
+			nstr_t *s = nstr_in(arena, "i'm gay", &err);
+			REQUIRE( errnum(&err) == 0 );
+
+			THEN( "it behaves like a regular string" )
+			{
+				nstr_t *t = nstr("i'm gay", nil);
+				REQUIRE( nlen(s) == 7 );
+				REQUIRE( nstreq(s, t, nil) );
+				nput(t);
+			}
+
+			THEN( "releasing it doesn't free its memory" )
+			{
+				nput(s);
+				REQUIRE( s == nil );
+			}
+		}
+
+		WHEN( "a buffer is created in it" )
+		{
+			nbuf_t *buf = nbuf_from_in(arena, "owo", 3, &err);
+			REQUIRE( errnum(&err) == 0 );
+
+			THEN( "it behaves like a regular buffer" )
+			{
+				nbuf_t *other = nbuf_from("owo", 3, nil);
+				REQUIRE( nlen(buf) == 3 );
+				REQUIRE( nbuf_eq(buf, other, nil) );
+				REQUIRE( nbuf_hash(buf, nil) == nbuf_hash(other, nil) );
+				nput(other);
+			}
+
+			nput(buf);
+		}
+
+		WHEN( "the arena is nil" )
+		{
+			nstr_t *s = nstr_in(nil, "owo", &err);
+
+			THEN( "an error is yeeted" )
+			{
+				REQUIRE( s == nil );
+				REQUIRE( errnum(&err) == EFAULT );
+				errput(&err);
+			}
+		}
+
+		nput(arena);
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
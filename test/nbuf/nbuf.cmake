@@ -7,6 +7,8 @@ target_sources(neo_test PRIVATE
     nbuf/nbuf_from.cpp
     nbuf/nbuf_from_nstr.cpp
     nbuf/nbuf_from_str.cpp
+    nbuf/nbuf_hash.cpp
+    nbuf/nbuf_slice.cpp
 )
 
 # This file is part of libneo.
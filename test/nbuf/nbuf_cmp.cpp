@@ -60,6 +60,22 @@ TEST_CASE( "nbuf_cmp: Return negative if buffer 1 < buffer 2", "[src/nbuf.c]" )
 	nput(buf2);
 }
 
+TEST_CASE( "nbuf_cmp: Trailing NUL bytes are significant", "[src/nbuf.c]" )
+{
+	error err;
+	const char data[] = "aaaa\0";
+
+	nbuf_t *buf1 = nbuf_from(data, sizeof(data), nil);
+	nbuf_t *buf2 = nbuf_from(data, sizeof(data) - 1, nil);
+
+	REQUIRE( nbuf_cmp(buf1, buf2, &err) > 0 );
+	REQUIRE( nbuf_cmp(buf2, buf1, &err) < 0 );
+	REQUIRE( errnum(&err) == 0 );
+
+	nput(buf1);
+	nput(buf2);
+}
+
 TEST_CASE( "nbuf_cmp: Error if first buffer is nil", "[src/nbuf.c]" )
 {
 	error err;
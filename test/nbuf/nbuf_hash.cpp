@@ -0,0 +1,75 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <string.h>
+
+#include <neo.h>
+
+TEST_CASE( "nbuf_hash: Equal buffers have equal hashes", "[src/nbuf.c]" )
+{
+	error err;
+	const char *data = "aaaaa";
+	usize size = strlen(data);
+
+	nbuf_t *buf1 = nbuf_from(data, size, nil);
+	nbuf_t *buf2 = nbuf_from(data, size, nil);
+	nbuf_t *buf3 = nbuf_from(data, size - 1, nil);
+
+	u64 hash1 = nbuf_hash(buf1, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( hash1 == nbuf_hash(buf2, &err) );
+	REQUIRE( hash1 != nbuf_hash(buf3, &err) );
+
+	nput(buf1);
+	nput(buf2);
+	nput(buf3);
+}
+
+TEST_CASE( "nbuf_hash: Hash is memoized and inherited by clones", "[src/nbuf.c]" )
+{
+	error err;
+	const char *data = "aaaaa";
+	usize size = strlen(data);
+
+	nbuf_t *original = nbuf_from(data, size, nil);
+	REQUIRE( original->_hash == 0 );
+
+	u64 hash = nbuf_hash(original, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( original->_hash == hash );
+
+	nbuf_t *clone = nbuf_clone(original, nil);
+	REQUIRE( clone->_hash == hash );
+	REQUIRE( nbuf_hash(clone, &err) == hash );
+
+	nput(original);
+	nput(clone);
+}
+
+TEST_CASE( "nbuf_hash: Error if buffer is nil", "[src/nbuf.c]" )
+{
+	error err;
+	nbuf_hash(nil, &err);
+
+	nstr_t *expected_msg = nstr("Buffer is nil", nil);
+
+	REQUIRE( errnum(&err) == EFAULT );
+	REQUIRE( nstreq(expected_msg, errmsg(&err), nil) );
+
+	nput(expected_msg);
+	errput(&err);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
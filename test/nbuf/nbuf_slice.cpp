@@ -0,0 +1,63 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <string.h>
+
+#include <neo.h>
+
+TEST_CASE( "nbuf_slice: Zero-copy slice", "[src/nbuf.c]" )
+{
+	error err;
+	nbuf_t *buf = nbuf_from("i'm gay,,,", 10, nil);
+	nbuf_t *slice = nbuf_slice(buf, 4, 3, &err);
+
+	REQUIRE( slice != nil );
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( nlen(slice) == 3 );
+	REQUIRE( slice->_data == buf->_data + 4 );
+	REQUIRE( buf->__neo_nref._count == 2 );
+
+	nbuf_t *inner = nbuf_slice(slice, 1, 2, nil);
+	REQUIRE( inner->_data == buf->_data + 5 );
+	REQUIRE( inner->_borrow == &buf->__neo_nref );
+
+	nput(buf);
+	nput(slice);
+	REQUIRE( memcmp(inner->_data, "ay", 2) == 0 );
+	nput(inner);
+}
+
+TEST_CASE( "nbuf_slice: Error if out of bounds", "[src/nbuf.c]" )
+{
+	error err;
+	nbuf_t *buf = nbuf_from("owo", 3, nil);
+
+	REQUIRE( nbuf_slice(buf, 1, 3, &err) == nil );
+	REQUIRE( errnum(&err) == ERANGE );
+	errput(&err);
+
+	REQUIRE( nbuf_slice(buf, 3, 0, &err) == nil );
+	REQUIRE( errnum(&err) == ERANGE );
+	errput(&err);
+
+	REQUIRE( nbuf_slice(nil, 0, 1, &err) == nil );
+	REQUIRE( errnum(&err) == EFAULT );
+	errput(&err);
+
+	REQUIRE( buf->__neo_nref._count == 1 );
+	nput(buf);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,140 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <set>
+#include <catch2/catch.hpp>
+#include <errno.h>
+
+#include <neo.h>
+#include <neo/hashtab.h>
+#include <neo/nhash.h>
+
+static const struct nhash_key reference_key = {
+	.k0 = 0x0706050403020100ull,
+	.k1 = 0x0f0e0d0c0b0a0908ull,
+};
+
+TEST_CASE( "nsiphash: matches the reference vectors", "[src/nhash.c]" )
+{
+	u8 data[64];
+	for (unsigned int i = 0; i < sizeof(data); i++)
+		data[i] = (u8)i;
+
+	/* from the appendix of the SipHash paper and its reference code */
+	REQUIRE( nsiphash(data, 0, &reference_key) == 0x726fdb47dd0e0e31ull );
+	REQUIRE( nsiphash(data, 15, &reference_key) == 0xa129ca6149be45e5ull );
+	REQUIRE( nsiphash(data, 63, &reference_key) == 0x958a324ceb064572ull );
+}
+
+TEST_CASE( "nhash: hashes are deterministic and seeded", "[src/nhash.c]" )
+{
+	const char data[] = "the quick brown fox jumps over the lazy dog, twice even";
+
+	REQUIRE( nhash(data, sizeof(data), 1) == nhash(data, sizeof(data), 1) );
+	REQUIRE( nhash(data, sizeof(data), 1) != nhash(data, sizeof(data), 2) );
+	REQUIRE( nhash(nil, 0, 1) != nhash(nil, 0, 2) );
+}
+
+TEST_CASE( "nhash: every byte and length affects the hash", "[src/nhash.c]" )
+{
+	u8 data[128] = { 0 };
+	std::set<u64> hashes;
+	unsigned int count = 0;
+
+	/* all prefixes of an all-zero buffer, covering every code path */
+	for (usize size = 0; size <= sizeof(data); size++) {
+		hashes.insert(nhash(data, size, 0));
+		count++;
+	}
+
+	/* single bit flips in every position */
+	for (usize i = 0; i < sizeof(data); i++) {
+		for (unsigned int bit = 0; bit < 8; bit++) {
+			data[i] ^= (u8)(1 << bit);
+			hashes.insert(nhash(data, sizeof(data), 0));
+			data[i] ^= (u8)(1 << bit);
+			count++;
+		}
+	}
+
+	REQUIRE( hashes.size() == count );
+}
+
+TEST_CASE( "nhash: random seeds differ", "[src/nhash.c]" )
+{
+	u64 seed1 = nhash_random_seed();
+	u64 seed2 = nhash_random_seed();
+	REQUIRE( seed1 != seed2 );
+
+	struct nhash_key key = nhash_random_key();
+	REQUIRE( key.k0 != key.k1 );
+	struct nhash_key key2 = nhash_random_key();
+	REQUIRE( key.k0 != key2.k0 );
+	REQUIRE( key.k1 != key2.k1 );
+}
+
+static u32 dummy_hashfn(const nbuf_t *key, u32 limit)
+{
+	return nlen(key) % limit;
+}
+
+SCENARIO( "hashtab: tables can use SipHash", "[src/hashtab.c]" )
+{
+	error err;
+
+	GIVEN( "a hash table created with HASHTAB_SIPHASH" )
+	{
+		u32 flags = GENERATE(HASHTAB_SIPHASH, HASHTAB_SIPHASH | HASHTAB_FLAT);
+		hashtab_t *table = hashtab_create_flags(4, flags, nil, &err);
+		REQUIRE( errnum(&err) == 0 );
+
+		WHEN( "items are inserted" )
+		{
+			const unsigned int count = 100;
+			nbuf_t *keys[count];
+			for (unsigned int i = 0; i < count; i++) {
+				nstr_t *s = u2nstr(i, 16, nil);
+				keys[i] = nbuf_from_nstr(s, nil);
+				nput(s);
+				hashtab_put(table, keys[i], &keys[i], &err);
+				REQUIRE( errnum(&err) == 0 );
+			}
+
+			THEN( "they can be retrieved again" )
+			{
+				for (unsigned int i = 0; i < count; i++)
+					REQUIRE( hashtab_get(table, keys[i], &err) == &keys[i] );
+				REQUIRE( nlen(table) == count );
+			}
+
+			for (unsigned int i = 0; i < count; i++)
+				nput(keys[i]);
+		}
+
+		nput(table);
+	}
+
+	GIVEN( "a custom hash function" )
+	{
+		THEN( "it cannot be combined with HASHTAB_SIPHASH" )
+		{
+			hashtab_t *table = hashtab_create_flags(4, HASHTAB_SIPHASH,
+								dummy_hashfn, &err);
+			REQUIRE( table == nil );
+			REQUIRE( errnum(&err) == EINVAL );
+			errput(&err);
+		}
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -0,0 +1,132 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <set>
+#include <thread>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include <neo.h>
+
+TEST_CASE( "npool: objects of all sizes can be allocated", "[src/npool.c]" )
+{
+	error err;
+	std::vector<std::pair<u8 *, usize>> objs;
+
+	for (usize size = 1; size <= 300; size++) {
+		u8 *ptr = (u8 *)npool_alloc(size, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( ptr != nil );
+		/* objects must be usable for any structure */
+		REQUIRE( ((usize)ptr & (sizeof(void *) - 1)) == 0 );
+		memset(ptr, (int)size, size);
+		objs.push_back(std::make_pair(ptr, size));
+	}
+
+	/* make sure nothing overlaps */
+	for (auto &obj : objs) {
+		for (usize i = 0; i < obj.second; i++)
+			REQUIRE( obj.first[i] == (u8)obj.second );
+		npool_free(obj.first, obj.second);
+	}
+}
+
+TEST_CASE( "npool: zero size allocations fail", "[src/npool.c]" )
+{
+	error err;
+	void *ptr = npool_alloc(0, &err);
+	REQUIRE( ptr == nil );
+	REQUIRE( errnum(&err) == EINVAL );
+	errput(&err);
+}
+
+TEST_CASE( "npool: objects can be released by other threads", "[src/npool.c]" )
+{
+	const unsigned int count = 1000;
+	std::vector<void *> objs(count);
+
+	std::thread producer([&]() {
+		for (unsigned int i = 0; i < count; i++) {
+			objs[i] = npool_alloc(64, nil);
+			memset(objs[i], 0x55, 64);
+		}
+	});
+	producer.join();
+
+	std::set<void *> unique(objs.begin(), objs.end());
+	REQUIRE( unique.size() == count );
+
+	std::thread consumer([&]() {
+		for (unsigned int i = 0; i < count; i++)
+			npool_free(objs[i], 64);
+	});
+	consumer.join();
+
+	/* what the consumer released must be available to us now */
+	for (unsigned int i = 0; i < count; i++) {
+		objs[i] = npool_alloc(64, nil);
+		memset(objs[i], 0xaa, 64);
+	}
+	for (unsigned int i = 0; i < count; i++)
+		npool_free(objs[i], 64);
+}
+
+/* pooled memory isn't reused under AddressSanitizer, see src/npool.c */
+#if defined(__SANITIZE_ADDRESS__)
+#	define NPOOL_TEST_PASSTHROUGH
+#elif defined(__has_feature)
+#	if __has_feature(address_sanitizer)
+#		define NPOOL_TEST_PASSTHROUGH
+#	endif
+#endif
+
+static void npool_test_late_free(void *ptr)
+{
+	npool_free(ptr, 176);
+}
+
+TEST_CASE( "npool: objects released by late TLS destructors are not lost",
+	   "[src/npool.c]" )
+{
+	/* created after the pool's key, so its destructor runs later */
+	pthread_key_t key;
+	REQUIRE( pthread_key_create(&key, npool_test_late_free) == 0 );
+
+	void *late = nil;
+	std::thread thread([&]() {
+		late = npool_alloc(176, nil);
+		pthread_setspecific(key, late);
+	});
+	thread.join();
+	pthread_key_delete(key);
+
+#ifndef NPOOL_TEST_PASSTHROUGH
+	/* the object must have made it back to the depot */
+	const unsigned int count = 1000;
+	std::vector<void *> objs(count);
+	bool found = false;
+	for (unsigned int i = 0; i < count; i++) {
+		objs[i] = npool_alloc(176, nil);
+		if (objs[i] == late)
+			found = true;
+	}
+	for (unsigned int i = 0; i < count; i++)
+		npool_free(objs[i], 176);
+	REQUIRE( found );
+#endif
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -2,6 +2,8 @@
 
 #include <catch2/catch.hpp>
 #include <errno.h>
+#include <thread>
+#include <vector>
 
 #include <neo.h>
 
@@ -71,6 +73,387 @@ SCENARIO( "nref: call destroy callback when count reaches 0", "[src/nref.c]" )
 	}
 }
 
+SCENARIO( "nref: immortal structures are never destroyed", "[src/nref.c]" )
+{
+	GIVEN( "structure is immortal" )
+	{
+		bool called = false;
+		struct nref_test *instance = new nref_test();
+		instance->called = &called;
+		nref_init(instance, test_destroy);
+		nref_make_immortal(instance);
+		struct nref_test *orig = instance;
+		int count = nref_count(instance);
+
+		REQUIRE( nref_is_immortal(instance) );
+
+		WHEN( "nput is called" )
+		{
+			nput(instance);
+			nput(instance);
+
+			THEN( "destroy is not called and count is unchanged" )
+			{
+				REQUIRE( !called );
+				REQUIRE( instance == orig );
+				REQUIRE( nref_count(instance) == count );
+			}
+		}
+
+		WHEN( "nget is called" )
+		{
+			nget(instance);
+
+			THEN( "count is unchanged" )
+			{
+				REQUIRE( nref_count(instance) == count );
+			}
+		}
+
+		WHEN( "structure is borrowed and unborrowed" )
+		{
+			nref_t *ref = borrow(instance);
+			unborrow(ref);
+			unborrow(ref);
+
+			THEN( "destroy is not called and count is unchanged" )
+			{
+				REQUIRE( !called );
+				REQUIRE( nref_count(instance) == count );
+			}
+		}
+
+		delete orig;
+	}
+
+	GIVEN( "structure is not immortal" )
+	{
+		bool called = false;
+		struct nref_test *instance = new nref_test();
+		instance->called = &called;
+		nref_init(instance, test_destroy);
+
+		REQUIRE( !nref_is_immortal(instance) );
+		nput(instance);
+		REQUIRE( called );
+	}
+}
+
+SCENARIO( "nref: biased reference counts", "[src/nref.c]" )
+{
+	GIVEN( "structure is initialized with a biased count" )
+	{
+		bool called = false;
+		struct nref_test *instance = new nref_test();
+		instance->called = &called;
+		nref_init_biased(instance, test_destroy);
+
+		REQUIRE( nref_count(instance) == 1 );
+
+		WHEN( "nget and nput are called by the owner" )
+		{
+			nget(instance);
+			nget(instance);
+			REQUIRE( nref_count(instance) == 3 );
+			nput(instance);
+			nput(instance);
+			REQUIRE( !called );
+			nput(instance);
+
+			THEN( "destroy is called" )
+			{
+				REQUIRE( called );
+				REQUIRE( instance == nil );
+			}
+		}
+
+		WHEN( "other threads take and drop their own references" )
+		{
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++) {
+				threads.emplace_back([instance]() {
+					for (int i = 0; i < 10000; i++) {
+						nref_t *ref = borrow(instance);
+						unborrow(ref);
+					}
+				});
+			}
+			for (int i = 0; i < 10000; i++) {
+				nget(instance);
+				nput(instance);
+			}
+			for (auto &thread : threads)
+				thread.join();
+
+			THEN( "destroy is called when the owner drops the last reference" )
+			{
+				REQUIRE( nref_count(instance) == 1 );
+				REQUIRE( !called );
+				nput(instance);
+				REQUIRE( called );
+			}
+		}
+
+		WHEN( "another thread holds a reference after the owner dropped its own" )
+		{
+			nref_t *ref = nil;
+			std::thread borrower([instance, &ref]() {
+				ref = borrow(instance);
+			});
+			borrower.join();
+			nput(instance);
+			REQUIRE( !called );
+			std::thread unborrower([ref]() {
+				unborrow(ref);
+			});
+			unborrower.join();
+
+			THEN( "destroy is called by the other thread" )
+			{
+				REQUIRE( called );
+			}
+		}
+
+		WHEN( "the owner hands a reference to another thread" )
+		{
+			nget(instance);
+			std::thread thread([instance]() {
+				struct nref_test *copy = instance;
+				nput(copy);
+			});
+			thread.join();
+			REQUIRE( !called );
+			nput(instance);
+
+			THEN( "destroy is called when the owner drops its last reference" )
+			{
+				REQUIRE( called );
+			}
+		}
+
+		WHEN( "the owner hands its last reference to another thread" )
+		{
+			nref_unbias(instance);
+			std::thread thread([instance]() {
+				struct nref_test *copy = instance;
+				nput(copy);
+			});
+			thread.join();
+
+			THEN( "destroy is called by the other thread" )
+			{
+				REQUIRE( called );
+			}
+		}
+	}
+}
+
+SCENARIO( "nref: weak references", "[src/nref.c]" )
+{
+	GIVEN( "a weak reference to a structure" )
+	{
+		bool called = false;
+		struct nref_test *instance = new nref_test();
+		instance->called = &called;
+		nref_init(instance, test_destroy);
+		error err;
+		nweak_t *weak = nweak(instance, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( nref_count(instance) == 1 );
+
+		WHEN( "the structure is still alive" )
+		{
+			struct nref_test *upgraded = (struct nref_test *)nweak_upgrade(weak);
+
+			THEN( "upgrading returns a new reference" )
+			{
+				REQUIRE( upgraded == instance );
+				REQUIRE( nref_count(instance) == 2 );
+				nput(upgraded);
+				nput(instance);
+				REQUIRE( called );
+			}
+		}
+
+		WHEN( "another weak reference is requested" )
+		{
+			nweak_t *weak2 = nweak(instance, &err);
+
+			THEN( "the same one is returned" )
+			{
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( weak2 == weak );
+				nput(weak2);
+				nput(instance);
+			}
+		}
+
+		WHEN( "the structure has been destroyed" )
+		{
+			nput(instance);
+			REQUIRE( called );
+
+			THEN( "upgrading returns nil" )
+			{
+				REQUIRE( nweak_upgrade(weak) == nil );
+			}
+		}
+
+		nput(weak);
+	}
+
+	GIVEN( "a weak reference to an immortal string" )
+	{
+		nstr_t *s = nstr("owo", nil);
+		nref_make_immortal(s);
+		error err;
+		nweak_t *weak = nweak(s, &err);
+		REQUIRE( errnum(&err) == 0 );
+
+		THEN( "upgrading always works" )
+		{
+			REQUIRE( nweak_upgrade(weak) == s );
+			REQUIRE( nref_is_immortal(s) );
+		}
+
+		THEN( "every call returns a separate weak reference" )
+		{
+			nweak_t *weak2 = nweak(s, &err);
+			REQUIRE( errnum(&err) == 0 );
+			REQUIRE( weak2 != weak );
+			REQUIRE( nweak_upgrade(weak2) == s );
+			nput(weak2);
+		}
+
+		nput(weak);
+		nfree(s);
+	}
+
+	GIVEN( "threads upgrading while the last reference is dropped" )
+	{
+		for (int round = 0; round < 100; round++) {
+			bool called = false;
+			struct nref_test *instance = new nref_test();
+			instance->called = &called;
+			nref_init(instance, test_destroy);
+			nweak_t *weak = nweak(instance, nil);
+
+			std::vector<std::thread> threads;
+			for (int t = 0; t < 4; t++) {
+				threads.emplace_back([weak]() {
+					for (int i = 0; i < 1000; i++) {
+						auto *obj = (struct nref_test *)nweak_upgrade(weak);
+						if (obj == nil)
+							break;
+						nput(obj);
+					}
+				});
+			}
+			nput(instance);
+			for (auto &thread : threads)
+				thread.join();
+
+			REQUIRE( called );
+			REQUIRE( nweak_upgrade(weak) == nil );
+			nput(weak);
+		}
+	}
+}
+
+extern "C" struct nref_parent {
+	bool *called;
+	struct nref_test *child;
+	NREF_FIELD;
+};
+
+void parent_destroy(struct nref_parent *ptr)
+{
+	*ptr->called = true;
+	nput(ptr->child);
+	delete ptr;
+}
+
+SCENARIO( "nref: deferred release", "[src/nref.c]" )
+{
+	GIVEN( "deferred release is enabled" )
+	{
+		bool called[3] = { false, false, false };
+		struct nref_test *instances[3];
+		for (int i = 0; i < 3; i++) {
+			instances[i] = new nref_test();
+			instances[i]->called = &called[i];
+			nref_init(instances[i], test_destroy);
+		}
+		nref_defer_release(true);
+
+		WHEN( "the last reference is dropped" )
+		{
+			nweak_t *weak = nweak(instances[0], nil);
+			for (int i = 0; i < 3; i++)
+				nput(instances[i]);
+
+			THEN( "structures are only destroyed by nref_reclaim" )
+			{
+				REQUIRE( !called[0] );
+				REQUIRE( nweak_upgrade(weak) == nil );
+				REQUIRE( nref_reclaim(2) == 2 );
+				REQUIRE( called[0] );
+				REQUIRE( called[1] );
+				REQUIRE( !called[2] );
+				REQUIRE( nref_reclaim(0) == 1 );
+				REQUIRE( called[2] );
+				REQUIRE( nref_reclaim(0) == 0 );
+			}
+
+			/* the weak reference is deferred as well */
+			nput(weak);
+			REQUIRE( nref_reclaim(0) == 1 );
+		}
+
+		WHEN( "a destroy callback releases other structures" )
+		{
+			bool parent_called = false;
+			struct nref_parent *parent = new nref_parent();
+			parent->called = &parent_called;
+			parent->child = instances[0];
+			nref_init(parent, parent_destroy);
+			nput(parent);
+			nput(instances[1]);
+			nput(instances[2]);
+
+			THEN( "they are destroyed by the same nref_reclaim" )
+			{
+				REQUIRE( !parent_called );
+				REQUIRE( nref_reclaim(0) == 4 );
+				REQUIRE( parent_called );
+				REQUIRE( called[0] );
+			}
+		}
+
+		WHEN( "the queue is handed off to another thread" )
+		{
+			for (int i = 0; i < 3; i++)
+				nput(instances[i]);
+			nref_reclaim_handoff();
+			REQUIRE( nref_reclaim(0) == 0 );
+
+			THEN( "that thread can destroy them" )
+			{
+				usize count = 0;
+				std::thread background([&count]() {
+					count = nref_reclaim_shared();
+				});
+				background.join();
+				REQUIRE( count == 3 );
+				for (int i = 0; i < 3; i++)
+					REQUIRE( called[i] );
+			}
+		}
+
+		nref_defer_release(false);
+	}
+}
+
 /*
  * This file is part of libneo.
  * Copyright (c) 2021 Fefie <owo@fef.moe>.
@@ -0,0 +1,89 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <string.h>
+#include <utility>
+
+#include <neo.h>
+#include <neo/ref.hpp>
+
+static neo::ref<nstr_t> make_string()
+{
+	neo::ref<nstr_t> s = neo::adopt(nstr("owo", nil));
+	/* moved out, so this doesn't touch the count */
+	return s;
+}
+
+TEST_CASE( "neo::ref: Adopt and release references", "[neo/ref.hpp]" )
+{
+	neo::ref<nstr_t> s = make_string();
+	REQUIRE( s );
+	REQUIRE( nref_count(s.get()) == 1 );
+	REQUIRE( nlen(s) == 3 );
+
+	nstr_t *raw = s.release();
+	REQUIRE( s == nullptr );
+	REQUIRE( nref_count(raw) == 1 );
+	nput(raw);
+}
+
+TEST_CASE( "neo::ref: Copying acquires, moving transfers", "[neo/ref.hpp]" )
+{
+	neo::ref<nstr_t> a = neo::adopt(nstr("owo", nil));
+	{
+		neo::ref<nstr_t> b = a;
+		REQUIRE( b == a );
+		REQUIRE( nref_count(a.get()) == 2 );
+
+		neo::ref<nstr_t> c = std::move(b);
+		REQUIRE( b == nullptr );
+		REQUIRE( c == a );
+		REQUIRE( nref_count(a.get()) == 2 );
+
+		c = c;
+		REQUIRE( nref_count(a.get()) == 2 );
+	}
+	REQUIRE( nref_count(a.get()) == 1 );
+
+	neo::ref<nstr_t> d = neo::retain(a.get());
+	REQUIRE( nref_count(a.get()) == 2 );
+	d = nullptr;
+	REQUIRE( nref_count(a.get()) == 1 );
+}
+
+TEST_CASE( "neo::ref: Assignment releases the old reference", "[neo/ref.hpp]" )
+{
+	nstr_t *raw = nstr("owo", nil);
+	neo::ref<nstr_t> keep = neo::retain(raw);
+	neo::ref<nstr_t> a = neo::adopt(raw);
+	neo::ref<nstr_t> b = neo::adopt(nstr("uwu", nil));
+
+	a = std::move(b);
+	REQUIRE( nref_count(raw) == 1 );
+	REQUIRE( strcmp(nstr_raw(a), "uwu") == 0 );
+
+	a.reset();
+	REQUIRE( !a );
+}
+
+TEST_CASE( "neo::ref: References to const structures", "[neo/ref.hpp]" )
+{
+	neo::ref<nstr_t> s = neo::adopt(nstr("owo", nil));
+	neo::ref<const nstr_t> c = neo::retain<const nstr_t>(s.get());
+	REQUIRE( nref_count(s.get()) == 2 );
+	c.reset();
+	REQUIRE( nref_count(s.get()) == 1 );
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
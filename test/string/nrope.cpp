@@ -0,0 +1,160 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <string>
+
+#include <neo.h>
+#include <neo/nrope.h>
+#include <neo/utf.h>
+
+static nrope_t *rope_from(const char *s)
+{
+	nstr_t *str = nstr(s, nil);
+	nrope_t *rope = nrope_from_nstr(str, nil);
+	nput(str);
+	return rope;
+}
+
+static bool rope_equals(nrope_t *rope, const std::string &expected)
+{
+	nstr_t *flat = nrope_flatten(rope, nil);
+	bool eq = expected == nstr_raw(flat);
+	nput(flat);
+	return eq;
+}
+
+SCENARIO( "nrope: ropes can be concatenated and sliced", "[string/nrope.c]" )
+{
+	GIVEN( "two ropes" )
+	{
+		error err;
+		nrope_t *r1 = rope_from("i'm ");
+		nrope_t *r2 = rope_from("gay\xf0\x9f\xa5\xba,,,");
+
+		WHEN( "they are concatenated" )
+		{
+			nrope_t *cat = nrope_cat(r1, r2, &err);
+			REQUIRE( errnum(&err) == 0 );
+
+			THEN( "the result contains both" )
+			{
+				REQUIRE( nlen(cat) == 11 );
+				REQUIRE( nrope_size(cat) == 14 );
+				REQUIRE( rope_equals(cat, "i'm gay\xf0\x9f\xa5\xba,,,") );
+				REQUIRE( nrope_chrat(cat, 7, &err) == 0x01f97a );
+				REQUIRE( nrope_chrat(cat, 8, &err) == ',' );
+				REQUIRE( nrope_byteat(cat, 7, &err) == 0xf0 );
+			}
+
+			THEN( "it can be sliced" )
+			{
+				nrope_t *slice = nrope_slice(cat, 4, 4, &err);
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( nlen(slice) == 4 );
+				REQUIRE( rope_equals(slice, "gay\xf0\x9f\xa5\xba") );
+				nput(slice);
+			}
+
+			THEN( "out of bounds slices fail" )
+			{
+				nrope_t *slice = nrope_slice(cat, 8, 4, &err);
+				REQUIRE( slice == nil );
+				REQUIRE( errnum(&err) == ERANGE );
+				errput(&err);
+			}
+
+			THEN( "it can be iterated over" )
+			{
+				nstr_t *flat = nrope_flatten(cat, nil);
+				nchar expected[11];
+				usize i = 0;
+				const char *pos = nstr_raw(flat);
+				while (*pos != '\0')
+					pos += utf8_to_nchr(&expected[i++], pos, nil);
+
+				nchar c;
+				i = 0;
+				nrope_foreach(&c, cat, &err) {
+					REQUIRE( i < 11 );
+					REQUIRE( c == expected[i] );
+					i++;
+				}
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( i == 11 );
+				nput(flat);
+			}
+
+			nput(cat);
+		}
+
+		WHEN( "one is inserted into the other" )
+		{
+			nrope_t *inserted = nrope_insert(r2, 3, r1, &err);
+			REQUIRE( errnum(&err) == 0 );
+
+			THEN( "the result contains both" )
+			{
+				REQUIRE( rope_equals(inserted, "gayi'm \xf0\x9f\xa5\xba,,,") );
+			}
+
+			nput(inserted);
+		}
+
+		nput(r1);
+		nput(r2);
+	}
+
+	GIVEN( "a rope built from a huge string" )
+	{
+		std::string text;
+		for (unsigned int i = 0; i < 10000; i++)
+			text += std::to_string(i) + "\xc3\xa4 ";
+		nrope_t *rope = rope_from(text.c_str());
+		REQUIRE( rope->_height > 4 );
+
+		WHEN( "lots of pieces are inserted" )
+		{
+			std::string expected = text;
+			nrope_t *piece = rope_from("\xe2\x9c\xa8");
+			for (unsigned int i = 0; i < 1000; i++) {
+				usize index = (i * 7919) % nlen(rope);
+				nrope_t *next = nrope_insert(rope, index, piece, nil);
+				nput(rope);
+				rope = next;
+
+				/* index is in characters, std::string works with bytes */
+				usize offset = 0;
+				for (usize chars = index; chars != 0;) {
+					offset++;
+					if ((expected[offset] & 0xc0) != 0x80)
+						chars--;
+				}
+				expected.insert(offset, "\xe2\x9c\xa8");
+			}
+			nput(piece);
+
+			THEN( "the contents are correct and the rope stays balanced" )
+			{
+				REQUIRE( rope_equals(rope, expected) );
+				REQUIRE( rope->_height < 32 );
+				REQUIRE( nrope_chrat(rope, nlen(rope) - 1, nil) == ' ' );
+			}
+		}
+
+		nput(rope);
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -4,6 +4,7 @@
 #include <errno.h>
 
 #include <neo.h>
+#include <neo/utf.h>
 
 TEST_CASE( "nstr: Create a string", "[string/nstr.c]" )
 {
@@ -80,6 +81,154 @@ TEST_CASE( "_neo_nstr_init_array: Statically initialize UTF-8 string", "[string/
 	REQUIRE( nlen(static_test_string_2) == 11 );
 }
 
+TEST_CASE( "_neo_nstr_init_array: Statically initialized strings are immortal", "[string/nstr.c]" )
+{
+	nstr_t *s = static_test_string_1;
+
+	REQUIRE( nref_is_immortal(s) );
+	nput(s);
+	REQUIRE( s == static_test_string_1 );
+	REQUIRE( nlen(static_test_string_1) == 10 );
+}
+
+NSTR_STATIC(static_test_string_3, "i'm gay,,,");
+NSTR_STATIC(static_test_string_4, "i'm gay\xf0\x9f\xa5\xba,,,");
+NSTR_STATIC(static_test_string_5,
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+	"\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4\xc3\xa4"
+);
+
+TEST_CASE( "NSTR_STATIC: Define ASCII string at compile time", "[string/nstr.c]" )
+{
+	nstr_t *expected_s3 = nstr("i'm gay,,,", nil);
+
+	REQUIRE( nstreq(expected_s3, static_test_string_3, nil) );
+	REQUIRE( nlen(static_test_string_3) == 10 );
+	REQUIRE( nstr_is_terminated(static_test_string_3) );
+	nput(expected_s3);
+}
+
+TEST_CASE( "NSTR_STATIC: Define UTF-8 string at compile time", "[string/nstr.c]" )
+{
+	nstr_t *expected_s4 = nstr("i'm gay\xf0\x9f\xa5\xba,,,", nil);
+
+	REQUIRE( nstreq(expected_s4, static_test_string_4, nil) );
+	REQUIRE( nlen(static_test_string_4) == 11 );
+	REQUIRE( nchrat(static_test_string_4, 7, nil) == 0x1f97a );
+	nput(expected_s4);
+}
+
+TEST_CASE( "NSTR_STATIC: Define string of maximum size", "[string/nstr.c]" )
+{
+	REQUIRE( nlen(static_test_string_5) == NSTR_STATIC_MAX / 2 );
+	REQUIRE( utf8_check(nstr_raw(static_test_string_5), nil) == NSTR_STATIC_MAX / 2 );
+	REQUIRE( nchrat(static_test_string_5, 127, nil) == 0xe4 );
+}
+
+TEST_CASE( "NSTR_STATIC: Reference count is never modified", "[string/nstr.c]" )
+{
+	nstr_t *s = static_test_string_4;
+	int count = nref_count(s);
+	REQUIRE( nref_is_immortal(s) );
+
+	nget(s);
+	nput(s);
+	nput(s);
+	REQUIRE( s == static_test_string_4 );
+	REQUIRE( nref_count(s) == count );
+
+	nstr_t *slice = nstr_slice(s, 1, 4, nil);
+	nstr_t *dup = nstrdup(s, nil);
+	REQUIRE( nstreq(dup, s, nil) );
+	nput(slice);
+	nput(dup);
+	REQUIRE( nref_count(s) == count );
+}
+
+TEST_CASE( "nchrat: Get characters from an ASCII string", "[string/nstr.c]" )
+{
+	error err;
+	nstr_t *s = nstr("owo uwu", nil);
+
+	REQUIRE( nchrat(s, 0, &err) == 'o' );
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( nchrat(s, 1, &err) == 'w' );
+	REQUIRE( nchrat(s, 6, &err) == 'u' );
+	REQUIRE( errnum(&err) == 0 );
+
+	nput(s);
+}
+
+TEST_CASE( "nchrat: Get characters from a UTF-8 string", "[string/nstr.c]" )
+{
+	error err;
+	nstr_t *s = nstr("a\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\xbaz", nil);
+
+	REQUIRE( nchrat(s, 0, &err) == 'a' );
+	REQUIRE( nchrat(s, 1, &err) == 0xe4 );
+	REQUIRE( nchrat(s, 2, &err) == 0x20ac );
+	REQUIRE( nchrat(s, 3, &err) == 0x1f63a );
+	REQUIRE( nchrat(s, 4, &err) == 'z' );
+	REQUIRE( errnum(&err) == 0 );
+
+	nput(s);
+}
+
+TEST_CASE( "nchrat: Get characters from a long UTF-8 string", "[string/nstr.c]" )
+{
+	error err;
+	nstr_t *piece = nstr("\xe6\x97\xa5\xe6\x9c\xac owo ", nil);
+	nstr_t *s = nstrmul(piece, 200, nil);
+	REQUIRE( nlen(s) == 1400 );
+
+	/* twice to check both building and using the index */
+	for (int round = 0; round < 2; round++) {
+		for (usize i = 0; i < nlen(s); i++)
+			REQUIRE( nchrat(s, i, &err) == nchrat(piece, i % 7, nil) );
+	}
+	REQUIRE( errnum(&err) == 0 );
+
+	/* slices have their own index, relative to their own data */
+	nstr_t *slice = nstr_slice(s, 3, 700, nil);
+	for (usize i = 0; i < nlen(slice); i++)
+		REQUIRE( nchrat(slice, i, &err) == nchrat(piece, (i + 3) % 7, nil) );
+	REQUIRE( errnum(&err) == 0 );
+
+	nput(slice);
+	nput(s);
+	nput(piece);
+}
+
+TEST_CASE( "nchrat: Error if index is out of bounds", "[string/nstr.c]" )
+{
+	error err;
+	nstr_t *s = nstr("\xc3\xa4", nil);
+
+	REQUIRE( nchrat(s, 1, &err) == '\0' );
+	REQUIRE( errnum(&err) == ERANGE );
+	errput(&err);
+
+	REQUIRE( nchrat(nil, 0, &err) == '\0' );
+	REQUIRE( errnum(&err) == EFAULT );
+	errput(&err);
+
+	nput(s);
+}
+
 /*
  * This file is part of libneo.
  * Copyright (c) 2021 Fefie <owo@fef.moe>.
@@ -0,0 +1,120 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <string.h>
+
+#include <neo.h>
+#include <neo/nstrbuf.h>
+
+SCENARIO( "nstrbuf: strings can be built piece by piece", "[string/nstrbuf.c]" )
+{
+	GIVEN( "an empty string builder" )
+	{
+		error err;
+		nstrbuf_t buf = {};
+		nstrbuf_init(&buf, 4, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( nlen(&buf) == 0 );
+
+		WHEN( "pieces of all kinds are appended" )
+		{
+			nstr_t *s = nstr("i'm ", nil);
+			nstrbuf_append(&buf, s, &err);
+			REQUIRE( errnum(&err) == 0 );
+			nstrbuf_append_cstr(&buf, "gay\xf0\x9f\xa5\xba ", &err);
+			REQUIRE( errnum(&err) == 0 );
+			nstrbuf_append_i(&buf, -420, 10, &err);
+			REQUIRE( errnum(&err) == 0 );
+			nstrbuf_append_chr(&buf, ' ', &err);
+			REQUIRE( errnum(&err) == 0 );
+			nstrbuf_append_u(&buf, 0xff, 16, &err);
+			REQUIRE( errnum(&err) == 0 );
+			nstrbuf_append_chr(&buf, 0x01f97a, &err);
+			REQUIRE( errnum(&err) == 0 );
+			nput(s);
+
+			THEN( "the finished string contains all of them" )
+			{
+				nstr_t *expected = nstr("i'm gay\xf0\x9f\xa5\xba -420 ff\xf0\x9f\xa5\xba", nil);
+				nstr_t *actual = nstrbuf_finish(&buf, &err);
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( nlen(actual) == nlen(expected) );
+				REQUIRE( nstreq(expected, actual, nil) );
+				REQUIRE( nlen(&buf) == 0 );
+				nput(expected);
+				nput(actual);
+			}
+		}
+
+		WHEN( "many pieces are appended" )
+		{
+			for (unsigned int i = 0; i < 1000; i++)
+				nstrbuf_append_cstr(&buf, "owo ", nil);
+
+			THEN( "the builder grows as needed" )
+			{
+				nstr_t *piece = nstr("owo ", nil);
+				nstr_t *expected = nstrmul_put(piece, 1000, nil);
+				nstr_t *actual = nstrbuf_finish(&buf, nil);
+				REQUIRE( nlen(actual) == 4000 );
+				REQUIRE( nstreq(expected, actual, nil) );
+				nput(expected);
+				nput(actual);
+			}
+		}
+
+		WHEN( "nothing is appended" )
+		{
+			nstr_t *actual = nstrbuf_finish(&buf, &err);
+
+			THEN( "the result is an empty string" )
+			{
+				REQUIRE( errnum(&err) == 0 );
+				REQUIRE( nlen(actual) == 0 );
+				REQUIRE( strcmp(nstr_raw(actual), "") == 0 );
+				nput(actual);
+			}
+		}
+
+		WHEN( "invalid UTF-8 is appended" )
+		{
+			nstrbuf_append_cstr(&buf, "owo", nil);
+			nstrbuf_append_cstr(&buf, "\xf0\x9fuwu", &err);
+
+			THEN( "an error is yeeted and the builder is unmodified" )
+			{
+				REQUIRE( errnum(&err) != 0 );
+				errput(&err);
+				REQUIRE( nlen(&buf) == 3 );
+			}
+		}
+
+		WHEN( "an invalid radix is used" )
+		{
+			nstrbuf_append_u(&buf, 420, 37, &err);
+
+			THEN( "an error is yeeted" )
+			{
+				REQUIRE( errnum(&err) == EINVAL );
+				errput(&err);
+				REQUIRE( nlen(&buf) == 0 );
+			}
+		}
+
+		nstrbuf_destroy(&buf);
+	}
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -5,7 +5,7 @@
 
 #include <neo.h>
 
-TEST_CASE( "nstrmul: Repeat a string", "[string/nstrcat.c]" )
+TEST_CASE( "nstrmul: Repeat a string", "[string/nstrmul.c]" )
 {
 	error err;
 	nstr_t *s = nstr("aaaaa", nil);
@@ -23,14 +23,14 @@ TEST_CASE( "nstrmul: Repeat a string", "[string/nstrcat.c]" )
 	nput(actual);
 }
 
-TEST_CASE( "nstrmul: Duplicate a string if count is 1", "[string/nstrcat.c]" )
+TEST_CASE( "nstrmul: Duplicate a string if count is 1", "[string/nstrmul.c]" )
 {
 	error err;
 	nstr_t *s = nstr("aaaaa", nil);
 
 	nstr_t *mul = nstrmul(s, 1, &err);
 
-	REQUIRE( nul != nil );
+	REQUIRE( mul != nil );
 	REQUIRE( nlen(mul) == 5 );
 	REQUIRE( nstreq(s, mul, nil) );
 	REQUIRE( errnum(&err) == 0 );
@@ -39,7 +39,7 @@ TEST_CASE( "nstrmul: Duplicate a string if count is 1", "[string/nstrcat.c]" )
 	nput(mul);
 }
 
-TEST_CASE( "nstrmul: Error if string is nil", "[string/nstrcat.c]" )
+TEST_CASE( "nstrmul: Error if string is nil", "[string/nstrmul.c]" )
 {
 	error err;
 	nstr_t *mul = nstrmul(nil, 1, &err);
@@ -53,22 +53,54 @@ TEST_CASE( "nstrmul: Error if string is nil", "[string/nstrcat.c]" )
 	errput(&err);
 }
 
-TEST_CASE( "nstrmul: Return empty string if count is 0", "[string/nstrcat.c]" )
+TEST_CASE( "nstrmul: Return empty string if count is 0", "[string/nstrmul.c]" )
 {
 	error err;
 	nstr_t *s = nstr("aaaaa", nil);
 	nstr_t *mul = nstrmul(s, 0, &err);
 
-	nstr_t *expected_msg = nstr("String is nil", nil);
+	REQUIRE( mul != nil );
+	REQUIRE( nlen(mul) == 0 );
+	REQUIRE( errnum(&err) == 0 );
 
-	REQUIRE( mul == nil );
-	REQUIRE( errnum(&err) == EFAULT );
-	REQUIRE( nstreq(expected_msg, errmsg(&err), nil) );
+	nput(s);
+	nput(mul);
+}
 
-	errput(&err);
+TEST_CASE( "nstrmul: Repeat a UTF-8 string", "[string/nstrmul.c]" )
+{
+	error err;
+	nstr_t *s = nstr("\xf0\x9f\xa5\xba,", nil);
+
+	nstr_t *expected = nstr("\xf0\x9f\xa5\xba,\xf0\x9f\xa5\xba,\xf0\x9f\xa5\xba,", nil);
+	nstr_t *actual = nstrmul(s, 3, &err);
+
+	REQUIRE( actual != nil );
+	REQUIRE( nlen(actual) == 2 * 3 );
+	REQUIRE( nstreq(expected, actual, nil) );
+	REQUIRE( errnum(&err) == 0 );
+
+	nput(s);
+	nput(expected);
+	nput(actual);
+}
+
+TEST_CASE( "nchrmul: Repeat a UTF-8 character", "[string/nstrmul.c]" )
+{
+	error err;
+	nstr_t *expected = nstr("\xf0\x9f\xa5\xba\xf0\x9f\xa5\xba", nil);
+	nstr_t *actual = nchrmul(0x01f97a, 2, &err);
+
+	REQUIRE( actual != nil );
+	REQUIRE( nlen(actual) == 2 );
+	REQUIRE( nstreq(expected, actual, nil) );
+	REQUIRE( errnum(&err) == 0 );
+
+	nput(expected);
+	nput(actual);
 }
 
-TEST_CASE( "nstrmul: Error if string is nil", "[string/nstrcat.c]" )
+TEST_CASE( "nstrmul: Error if string is nil and count is not 1", "[string/nstrmul.c]" )
 {
 	error err;
 	nstr_t *mul = nstrmul(nil, 3, &err);
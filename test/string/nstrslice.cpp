@@ -0,0 +1,187 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <string>
+#include <vector>
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <string.h>
+
+#include <neo.h>
+#include <neo/utf.h>
+
+TEST_CASE( "nstr_slice: Zero-copy substring", "[string/nstrslice.c]" )
+{
+	error err;
+	nstr_t *s = nstr("a\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\xbaz", nil);
+	nstr_t *slice = nstr_slice(s, 1, 3, &err);
+
+	REQUIRE( slice != nil );
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( nlen(slice) == 3 );
+	REQUIRE( nstr_raw(slice) == nstr_raw(s) + 1 );
+	REQUIRE( !nstr_is_terminated(slice) );
+	REQUIRE( s->__neo_nref._count == 2 );
+
+	nstr_t *expected = nstr("\xc3\xa4\xe2\x82\xac\xf0\x9f\x98\xba", nil);
+	REQUIRE( nstreq(slice, expected, nil) );
+	REQUIRE( nstrcmp(slice, s, nil) > 0 );
+
+	nchar c;
+	nchar chars[3];
+	usize count = 0;
+	nstr_foreach(&c, slice, nil) {
+		REQUIRE( count < 3 );
+		chars[count++] = c;
+	}
+	REQUIRE( count == 3 );
+	REQUIRE( chars[0] == 0xe4 );
+	REQUIRE( chars[1] == 0x20ac );
+	REQUIRE( chars[2] == 0x1f63a );
+
+	nput(s);
+	REQUIRE( slice->__neo_nref._count == 1 );
+	REQUIRE( nstreq(slice, expected, nil) );
+
+	nput(slice);
+	nput(expected);
+}
+
+TEST_CASE( "nstr_slice: Slices of slices borrow from the original", "[string/nstrslice.c]" )
+{
+	nstr_t *s = nstr("owo uwu", nil);
+	nstr_t *slice = nstr_slice(s, 2, 4, nil);
+	nstr_t *inner = nstr_slice(slice, 1, 3, nil);
+
+	REQUIRE( nstr_raw(inner) == nstr_raw(s) + 3 );
+	REQUIRE( inner->_borrow == &s->__neo_nref );
+	REQUIRE( s->__neo_nref._count == 3 );
+	REQUIRE( slice->__neo_nref._count == 1 );
+
+	nstr_t *expected = nstr(" uw", nil);
+	REQUIRE( nstreq(inner, expected, nil) );
+
+	nput(slice);
+	nput(s);
+	REQUIRE( nstreq(inner, expected, nil) );
+	nput(inner);
+	nput(expected);
+}
+
+TEST_CASE( "nstr_slice: Slices at the end are terminated", "[string/nstrslice.c]" )
+{
+	nstr_t *s = nstr("uwu", nil);
+	nstr_t *tail = nstr_slice(s, 1, 2, nil);
+	nstr_t *empty = nstr_slice(s, 3, 0, nil);
+
+	REQUIRE( nstr_is_terminated(tail) );
+	REQUIRE( strcmp(nstr_raw(tail), "wu") == 0 );
+	REQUIRE( nstr_is_terminated(empty) );
+	REQUIRE( nlen(empty) == 0 );
+
+	nput(s);
+	nput(tail);
+	nput(empty);
+}
+
+TEST_CASE( "nstr_slice: Slices of long non-ASCII strings", "[string/nstrslice.c]" )
+{
+	/* long enough to get an index, see src/string/nstr.c */
+	const usize len = 640;
+	std::string raw;
+	std::vector<usize> offsets;
+	for (usize i = 0; i < len; i++) {
+		offsets.push_back(raw.size());
+		raw += i % 3 == 0 ? "a" : "\xc3\xa4";
+	}
+	offsets.push_back(raw.size());
+	nstr_t *s = nstr(raw.c_str(), nil);
+	REQUIRE( nlen(s) == len );
+
+	const usize starts[] = { 0, 1, 63, 64, 65, 300, 575, 576, 639, 640 };
+	for (usize start : starts) {
+		for (usize slice_len : { (usize)0, (usize)1, (usize)64, len - start }) {
+			if (slice_len > len - start)
+				continue;
+			nstr_t *slice = nstr_slice(s, start, slice_len, nil);
+			REQUIRE( nlen(slice) == slice_len );
+			REQUIRE( nstr_raw(slice) == nstr_raw(s) + offsets[start] );
+			REQUIRE( _neo_nstr_size(slice)
+				 == offsets[start + slice_len] - offsets[start] );
+			nput(slice);
+		}
+	}
+
+	nput(s);
+}
+
+TEST_CASE( "nstr_slice: Error if out of bounds", "[string/nstrslice.c]" )
+{
+	error err;
+	nstr_t *s = nstr("uwu", nil);
+
+	REQUIRE( nstr_slice(s, 4, 0, &err) == nil );
+	REQUIRE( errnum(&err) == ERANGE );
+	errput(&err);
+
+	REQUIRE( nstr_slice(s, 1, 3, &err) == nil );
+	REQUIRE( errnum(&err) == ERANGE );
+	errput(&err);
+
+	REQUIRE( nstr_slice(nil, 0, 0, &err) == nil );
+	REQUIRE( errnum(&err) == EFAULT );
+	errput(&err);
+
+	REQUIRE( s->__neo_nref._count == 1 );
+	nput(s);
+}
+
+TEST_CASE( "nstr_terminate: Copy only if neccessary", "[string/nstrslice.c]" )
+{
+	error err;
+	nstr_t *s = nstr("uwu owo", nil);
+	nstr_t *head = nstr_slice(s, 0, 3, nil);
+
+	nstr_t *same = nstr_terminate(s, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( same == s );
+	REQUIRE( s->__neo_nref._count == 3 );
+	nput(same);
+
+	nstr_t *copy = nstr_terminate(head, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( copy != head );
+	REQUIRE( nstr_is_terminated(copy) );
+	REQUIRE( strcmp(nstr_raw(copy), "uwu") == 0 );
+	REQUIRE( nlen(copy) == 3 );
+
+	nput(copy);
+	nput(head);
+	nput(s);
+}
+
+TEST_CASE( "nstr_slice: Convert to buffer", "[string/nstrslice.c]" )
+{
+	nstr_t *s = nstr("uwu owo", nil);
+	nstr_t *head = nstr_slice(s, 0, 3, nil);
+	nbuf_t *buf = nbuf_from_nstr(head, nil);
+
+	REQUIRE( nlen(buf) == 3 + 4 );
+	REQUIRE( memcmp(buf->_data, "uwu\0\0\0\0", 7) == 0 );
+
+	nput(buf);
+	nput(head);
+	nput(s);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
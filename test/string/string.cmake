@@ -6,9 +6,13 @@ target_sources(neo_test PRIVATE
     string/i2nstr.cpp
     string/leftpad.cpp
     string/nstr.cpp
+    string/nrope.cpp
+    string/nstrbuf.cpp
     string/nstrcat.cpp
     string/nstrcmp.cpp
     string/nstrdup.cpp
+    string/nstrmul.cpp
+    string/nstrslice.cpp
     string/u2nstr.cpp
 )
 
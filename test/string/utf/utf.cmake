@@ -5,8 +5,10 @@ target_sources(neo_test PRIVATE
     string/utf/utf8_chrsize.cpp
     string/utf/utf8_from_nchr.cpp
     string/utf/utf8_ncheck.cpp
+    string/utf/utf8_stream.cpp
     string/utf/utf8_strlen.cpp
     string/utf/utf8_to_nchr.cpp
+    string/utf/utf_transcode.cpp
 )
 
 # This file is part of libneo.
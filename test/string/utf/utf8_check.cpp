@@ -2,6 +2,7 @@
 
 #include <catch2/catch.hpp>
 #include <errno.h>
+#include <string.h>
 
 #include <neo.h>
 #include <neo/utf.h>
@@ -113,6 +114,45 @@ TEST_CASE( "utf8_check: Error on non canonical encoding", "[string/utf.c]" )
 	errput(&err);
 }
 
+TEST_CASE( "utf8_check: Long mixed string", "[string/utf.c]" )
+{
+	/* long enough to go through the vectorized code paths */
+	char s[1024];
+	usize size = 0;
+	usize chars = 0;
+	while (size < sizeof(s) - 16) {
+		const char *piece = (chars % 3 == 0)
+			? "owo uwu \xc3\xa4\xe2\x82\xac\xf0\x9f\xa5\xba" : "i'm gay,,,";
+		strcpy(&s[size], piece);
+		size += strlen(piece);
+		chars += (chars % 3 == 0) ? 11 : 10;
+	}
+
+	error err;
+	REQUIRE( utf8_check(s, &err) == chars );
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( utf8_strlen(s) == chars );
+
+	/* an error far into the string still has the same message */
+	usize pos = size - 1;
+	while ((s[pos] & 0x80) != 0)
+		pos--;
+	s[pos] = '\xff';
+	utf8_check(s, &err);
+	nstr_t *expected = nstr("Illegal UTF-8 sequence start byte: 0xff", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	errput(&err);
+	nput(expected);
+}
+
+TEST_CASE( "utf8_check: Empty string", "[string/utf.c]" )
+{
+	error err;
+	REQUIRE( utf8_check("", &err) == 0 );
+	REQUIRE( errnum(&err) == 0 );
+}
+
 /*
  * This file is part of libneo.
  * Copyright (c) 2021 Fefie <owo@fef.moe>.
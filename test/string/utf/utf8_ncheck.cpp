@@ -124,6 +124,20 @@ TEST_CASE( "utf8_ncheck: Error on non canonical encoding", "[string/utf.c]" )
 	errput(&err);
 }
 
+TEST_CASE( "utf8_ncheck: Error on sequence cut off by maxsize", "[string/utf.c]" )
+{
+	error err;
+	utf8_ncheck("i'm gay\xf0\x9f\xa5\xba,,,", 9, &err);
+
+	nstr_t *expected = nstr("Byte 3 in UTF-8 sequence invalid: 0x00", nil);
+	nstr_t *actual = errmsg(&err);
+
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, actual, nil) );
+	errput(&err);
+	nput(expected);
+}
+
 /*
  * This file is part of libneo.
  * Copyright (c) 2021 Fefie <owo@fef.moe>.
@@ -0,0 +1,135 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <string.h>
+
+#include <neo.h>
+#include <neo/utf.h>
+
+/* "aä€🥺" followed by some ASCII */
+static const char text[] = "a\xc3\xa4\xe2\x82\xac\xf0\x9f\xa5\xba owo";
+static const nchar chars[] = { 'a', 0xe4, 0x20ac, 0x1f97a, ' ', 'o', 'w', 'o' };
+
+TEST_CASE( "utf8_stream_feed: Validate chunks split at every position", "[string/utf8_stream.c]" )
+{
+	usize size = strlen(text);
+
+	for (usize split = 0; split <= size; split++) {
+		utf8_stream_t stream;
+		error err;
+		utf8_stream_init(&stream);
+
+		usize first = utf8_stream_feed(&stream, text, split, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( first <= split );
+		REQUIRE( split - first < 4 );
+		REQUIRE( utf8_stream_offset(&stream) == first );
+
+		usize second = utf8_stream_feed(&stream, &text[split], size - split, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( second == size - split );
+		REQUIRE( utf8_stream_offset(&stream) == size );
+
+		utf8_stream_finish(&stream, &err);
+		REQUIRE( errnum(&err) == 0 );
+	}
+}
+
+TEST_CASE( "utf8_stream_next: Decode one byte at a time", "[string/utf8_stream.c]" )
+{
+	utf8_stream_t stream;
+	error err;
+	utf8_stream_init(&stream);
+
+	usize count = 0;
+	for (usize i = 0; i < strlen(text); i++) {
+		usize pos = 0;
+		nchar c;
+		while (utf8_stream_next(&stream, &text[i], 1, &pos, &c, &err)) {
+			REQUIRE( count < sizeof(chars) / sizeof(chars[0]) );
+			REQUIRE( c == chars[count++] );
+		}
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( pos == 1 );
+	}
+
+	REQUIRE( count == sizeof(chars) / sizeof(chars[0]) );
+	REQUIRE( utf8_stream_offset(&stream) == strlen(text) );
+	utf8_stream_finish(&stream, &err);
+	REQUIRE( errnum(&err) == 0 );
+}
+
+TEST_CASE( "utf8_stream_feed: Error offset in later chunks", "[string/utf8_stream.c]" )
+{
+	utf8_stream_t stream;
+	error err;
+	utf8_stream_init(&stream);
+
+	utf8_stream_feed(&stream, "owo \xe2\x82", 6, &err);
+	REQUIRE( errnum(&err) == 0 );
+	utf8_stream_feed(&stream, "\xac uwu \xff", 7, &err);
+
+	nstr_t *expected = nstr("Illegal UTF-8 sequence start byte: 0xff", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	REQUIRE( utf8_stream_offset(&stream) == 12 );
+	errput(&err);
+	nput(expected);
+}
+
+TEST_CASE( "utf8_stream_feed: Error in a split sequence", "[string/utf8_stream.c]" )
+{
+	utf8_stream_t stream;
+	error err;
+	utf8_stream_init(&stream);
+
+	utf8_stream_feed(&stream, "owo \xe2", 5, &err);
+	REQUIRE( errnum(&err) == 0 );
+	utf8_stream_feed(&stream, "\x82uwu", 4, &err);
+
+	nstr_t *expected = nstr("Byte 3 in UTF-8 sequence invalid: 0x75", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	REQUIRE( utf8_stream_offset(&stream) == 4 );
+	errput(&err);
+	nput(expected);
+}
+
+TEST_CASE( "utf8_stream_finish: Error if the stream ends mid-sequence", "[string/utf8_stream.c]" )
+{
+	utf8_stream_t stream;
+	error err;
+	utf8_stream_init(&stream);
+
+	REQUIRE( utf8_stream_feed(&stream, "owo \xf0\x9f", 6, &err) == 4 );
+	REQUIRE( errnum(&err) == 0 );
+	utf8_stream_finish(&stream, &err);
+
+	nstr_t *expected = nstr("Byte 3 in UTF-8 sequence invalid: 0x00", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	errput(&err);
+	nput(expected);
+}
+
+TEST_CASE( "utf8_stream_feed: Error if stream is nil", "[string/utf8_stream.c]" )
+{
+	error err;
+	utf8_stream_feed(nil, "owo", 3, &err);
+	REQUIRE( errnum(&err) == EFAULT );
+	errput(&err);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */
@@ -132,6 +132,42 @@ TEST_CASE( "utf8_to_nchr: Error on non canonical encoding", "[string/utf.c]" )
 	errput(&err);
 }
 
+TEST_CASE( "utf8_to_nchr: Error on ASCII second byte", "[string/utf.c]" )
+{
+	error err;
+	nchar c;
+	utf8_to_nchr(&c, "\xc3/", &err);
+
+	nstr_t *expected = nstr("Byte 2 in UTF-8 sequence invalid: 0x2f", nil);
+	nstr_t *actual = errmsg(&err);
+
+	REQUIRE( c == '\0' );
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, actual, nil) );
+	errput(&err);
+	nput(expected);
+}
+
+TEST_CASE( "utf8_to_nchr: Error on surrogates and out of range characters", "[string/utf.c]" )
+{
+	error err;
+	nchar c;
+
+	utf8_to_nchr(&c, "\xed\xa0\x80", &err);
+	nstr_t *expected = nstr("Illegal Unicode code point in UTF-8 sequence: U+D800", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	errput(&err);
+	nput(expected);
+
+	utf8_to_nchr(&c, "\xf4\x90\x80\x80", &err);
+	expected = nstr("Illegal Unicode code point in UTF-8 sequence: U+110000", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	errput(&err);
+	nput(expected);
+}
+
 /*
  * This file is part of libneo.
  * Copyright (c) 2021 Fefie <owo@fef.moe>.
@@ -0,0 +1,267 @@
+/** See the end of this file for copyright and license terms. */
+
+#include <catch2/catch.hpp>
+#include <errno.h>
+#include <string.h>
+
+#include <neo.h>
+#include <neo/utf.h>
+
+/* "ä€🥺a" */
+static const char utf8_text[] = "\xc3\xa4\xe2\x82\xac\xf0\x9f\xa5\xba" "a";
+static const u8 utf16le_text[] = { 0xe4, 0x00, 0xac, 0x20, 0x3e, 0xd8, 0x7a, 0xdd, 0x61, 0x00 };
+static const u8 utf16be_text[] = { 0x00, 0xe4, 0x20, 0xac, 0xd8, 0x3e, 0xdd, 0x7a, 0x00, 0x61 };
+static const u8 utf32be_text[] = {
+	0x00, 0x00, 0x00, 0xe4, 0x00, 0x00, 0x20, 0xac,
+	0x00, 0x01, 0xf9, 0x7a, 0x00, 0x00, 0x00, 0x61,
+};
+
+TEST_CASE( "utf8_to_utf16: Convert to both byte orders", "[string/utf_transcode.c]" )
+{
+	error err;
+	usize errpos;
+	u8 buf[32];
+	usize src_size = strlen(utf8_text);
+
+	usize size = utf8_to_utf16(nil, 0, utf8_text, src_size, UTF_LE, &errpos, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( size == sizeof(utf16le_text) );
+	REQUIRE( errpos == src_size );
+
+	size = utf8_to_utf16(buf, sizeof(buf), utf8_text, src_size, UTF_LE, &errpos, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( size == sizeof(utf16le_text) );
+	REQUIRE( memcmp(buf, utf16le_text, size) == 0 );
+
+	size = utf8_to_utf16(buf, sizeof(buf), utf8_text, src_size, UTF_BE, nil, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( size == sizeof(utf16be_text) );
+	REQUIRE( memcmp(buf, utf16be_text, size) == 0 );
+}
+
+TEST_CASE( "utf16_to_utf8: Convert from both byte orders", "[string/utf_transcode.c]" )
+{
+	error err;
+	usize errpos;
+	char buf[32];
+
+	usize size = utf16_to_utf8(buf, sizeof(buf), utf16le_text, sizeof(utf16le_text),
+				   UTF_LE, &errpos, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( errpos == sizeof(utf16le_text) );
+	REQUIRE( size == strlen(utf8_text) );
+	REQUIRE( memcmp(buf, utf8_text, size) == 0 );
+
+	size = utf16_to_utf8(buf, sizeof(buf), utf16be_text, sizeof(utf16be_text),
+			     UTF_BE, nil, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( memcmp(buf, utf8_text, size) == 0 );
+}
+
+TEST_CASE( "utf8_to_utf32: Round trip", "[string/utf_transcode.c]" )
+{
+	error err;
+	u8 buf[32];
+	char back[32];
+	usize src_size = strlen(utf8_text);
+
+	usize size = utf8_to_utf32(buf, sizeof(buf), utf8_text, src_size, UTF_BE, nil, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( size == sizeof(utf32be_text) );
+	REQUIRE( memcmp(buf, utf32be_text, size) == 0 );
+
+	size = utf32_to_utf8(back, sizeof(back), buf, size, UTF_BE, nil, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( size == src_size );
+	REQUIRE( memcmp(back, utf8_text, size) == 0 );
+}
+
+TEST_CASE( "utf8_to_utf16: Long strings", "[string/utf_transcode.c]" )
+{
+	/* long ASCII runs go through the vectorized code paths */
+	char text[4096];
+	usize text_size = 0;
+	for (int i = 0; text_size < sizeof(text) - 64; i++) {
+		const char *piece = (i % 5 == 0) ? utf8_text : "the quick brown fox jumps over the lazy dog";
+		strcpy(&text[text_size], piece);
+		text_size += strlen(piece);
+	}
+
+	enum utf_byteorder orders[] = { UTF_LE, UTF_BE };
+	for (enum utf_byteorder order : orders) {
+		static u8 units[4 * sizeof(text)];
+		static char back[sizeof(text)];
+		error err;
+
+		usize size = utf8_to_utf16(units, sizeof(units), text, text_size, order, nil, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( utf16_to_utf8(nil, 0, units, size, order, nil, &err) == text_size );
+		REQUIRE( utf16_to_utf8(back, sizeof(back), units, size, order, nil, &err) == text_size );
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( memcmp(back, text, text_size) == 0 );
+
+		size = utf8_to_utf32(units, sizeof(units), text, text_size, order, nil, &err);
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( size == 4 * utf8_strlen(text) );
+		const char *pos = text;
+		for (usize i = 0; i < size / 4; i++) {
+			nchar expected;
+			pos += utf8_to_nchr(&expected, pos, nil);
+			const u8 *unit = &units[4 * i];
+			nchar actual = order == UTF_LE
+				? unit[0] | unit[1] << 8 | unit[2] << 16 | unit[3] << 24
+				: unit[3] | unit[2] << 8 | unit[1] << 16 | unit[0] << 24;
+			REQUIRE( actual == expected );
+		}
+		REQUIRE( utf32_to_utf8(back, sizeof(back), units, size, order, nil, &err) == text_size );
+		REQUIRE( errnum(&err) == 0 );
+		REQUIRE( memcmp(back, text, text_size) == 0 );
+	}
+}
+
+TEST_CASE( "utf8_to_utf16: Error if destination is too small", "[string/utf_transcode.c]" )
+{
+	error err;
+	usize errpos;
+	u8 buf[5];
+
+	usize size = utf8_to_utf16(buf, sizeof(buf), utf8_text, strlen(utf8_text),
+				   UTF_LE, &errpos, &err);
+	REQUIRE( errnum(&err) == ERANGE );
+	/* "ä€" fit, but the surrogate pair for the emoji doesn't */
+	REQUIRE( size == 4 );
+	REQUIRE( errpos == 5 );
+	REQUIRE( memcmp(buf, utf16le_text, 4) == 0 );
+	errput(&err);
+}
+
+TEST_CASE( "utf8_to_utf16: Error on malformed UTF-8", "[string/utf_transcode.c]" )
+{
+	error err;
+	usize errpos;
+	u8 buf[32];
+
+	usize size = utf8_to_utf16(buf, sizeof(buf), "ab\xc3", 3, UTF_LE, &errpos, &err);
+
+	nstr_t *expected = nstr("Byte 2 in UTF-8 sequence invalid: 0x00", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	REQUIRE( size == 4 );
+	REQUIRE( errpos == 2 );
+	errput(&err);
+	nput(expected);
+}
+
+TEST_CASE( "utf16_to_utf8: Error on unpaired surrogates", "[string/utf_transcode.c]" )
+{
+	error err;
+	usize errpos;
+	char buf[32];
+
+	/* "a", high surrogate, "b" */
+	const u8 high[] = { 0x61, 0x00, 0x3e, 0xd8, 0x62, 0x00 };
+	usize size = utf16_to_utf8(buf, sizeof(buf), high, sizeof(high), UTF_LE, &errpos, &err);
+	nstr_t *expected = nstr("Unpaired UTF-16 surrogate: 0xd83e", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	REQUIRE( size == 1 );
+	REQUIRE( errpos == 2 );
+	errput(&err);
+	nput(expected);
+
+	/* high surrogate at the very end */
+	utf16_to_utf8(buf, sizeof(buf), high, 4, UTF_LE, &errpos, &err);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( errpos == 2 );
+	errput(&err);
+
+	/* lone low surrogate */
+	const u8 low[] = { 0xdc, 0x00 };
+	utf16_to_utf8(buf, sizeof(buf), low, sizeof(low), UTF_BE, &errpos, &err);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( errpos == 0 );
+	errput(&err);
+
+	/* odd size */
+	utf16_to_utf8(buf, sizeof(buf), utf16le_text, 3, UTF_LE, &errpos, &err);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( errpos == 2 );
+	errput(&err);
+}
+
+TEST_CASE( "utf32_to_utf8: Error on invalid code points", "[string/utf_transcode.c]" )
+{
+	error err;
+	usize errpos;
+	char buf[32];
+
+	const u8 data[] = { 0x61, 0, 0, 0, 0x00, 0x00, 0x11, 0x00 };
+	usize size = utf32_to_utf8(buf, sizeof(buf), data, sizeof(data), UTF_LE, &errpos, &err);
+	nstr_t *expected = nstr("Illegal Unicode code point in UTF-32 data: 0x00110000", nil);
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( nstreq(expected, errmsg(&err), nil) );
+	REQUIRE( size == 1 );
+	REQUIRE( errpos == 4 );
+	errput(&err);
+	nput(expected);
+}
+
+TEST_CASE( "nstr_to_utf16: Convert strings to buffers and back", "[string/utf_transcode.c]" )
+{
+	error err;
+	nstr_t *s = nstr(utf8_text, nil);
+
+	nbuf_t *buf = nstr_to_utf16(s, UTF_BE, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( nlen(buf) == sizeof(utf16be_text) );
+	REQUIRE( memcmp(buf->_data, utf16be_text, sizeof(utf16be_text)) == 0 );
+
+	nstr_t *back = utf16_to_nstr(buf->_data, nlen(buf), UTF_BE, nil, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( nlen(back) == 4 );
+	REQUIRE( nstreq(s, back, nil) );
+	nput(buf);
+	nput(back);
+
+	buf = nstr_to_utf32(s, UTF_LE, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( nlen(buf) == 16 );
+	back = utf32_to_nstr(buf->_data, nlen(buf), UTF_LE, nil, &err);
+	REQUIRE( errnum(&err) == 0 );
+	REQUIRE( nstreq(s, back, nil) );
+	nput(buf);
+	nput(back);
+
+	nput(s);
+}
+
+TEST_CASE( "utf16_to_nstr: Error on NUL characters", "[string/utf_transcode.c]" )
+{
+	error err;
+	usize errpos;
+	const u8 data[] = { 0x61, 0x00, 0x00, 0x00 };
+
+	nstr_t *s = utf16_to_nstr(data, sizeof(data), UTF_LE, &errpos, &err);
+	REQUIRE( s == nil );
+	REQUIRE( errnum(&err) == EINVAL );
+	REQUIRE( errpos == 2 );
+	errput(&err);
+
+	s = utf16_to_nstr(nil, 2, UTF_LE, &errpos, &err);
+	REQUIRE( s == nil );
+	REQUIRE( errnum(&err) == EFAULT );
+	errput(&err);
+}
+
+/*
+ * This file is part of libneo.
+ * Copyright (c) 2021 Fefie <owo@fef.moe>.
+ *
+ * libneo is non-violent software: you may only use, redistribute,
+ * and/or modify it under the terms of the CNPLv6+ as found in
+ * the LICENSE file in the source code root directory or at
+ * <https://git.pixie.town/thufie/CNPL>.
+ *
+ * libneo comes with ABSOLUTELY NO WARRANTY, to the extent
+ * permitted by applicable law.  See the CNPLv6+ for details.
+ */